@@ -111,33 +111,322 @@
 #define MQTT_OFFLINE_MSSG "\tOFFLINE\n"
 
 #define MAX_STRING_LEN 64
+#define MESSAGE_RESERVE_LEN 48 // Delimiters, control type and a value or two, on top of a message's String fields
 #define MAX_DEVICE_NAME_LEN 32
 #define MAX_DEVICE_TYPE_LEN 32
 
 // Server types
 #define SERVER_CLK = "srv_clk"
 
+// Orders the incoming buffer writes against the pointer that publishes them, as the buffer is written from the
+// BLE host task or MQTT callback and read from loop()
+#ifdef ARDUINO_ARCH_AVR
+    #define MEMORY_BARRIER() asm volatile("" ::: "memory")
+#else
+    #define MEMORY_BARRIER() __sync_synchronize()
+#endif
+
 char DASH_SERVER[] = "dash.dashio.io";
 
-String formatFloat(float value) {
-    if (value == INVALID_FLOAT_VALUE) {
-        return "nan";
-    } else if (abs(value) < SMALLEST_FLOAT_VALUE) {
-        return "0";
+// Control type lookup
+// Each control type ID hashes to a unique slot of controlTypeSlots, which holds the index of the ID in
+// controlTypeIDs. The slot table was generated offline for the hash below and is checked at compile
+// time, so adding an ID requires regenerating controlTypeSlots. Both tables are in PROGMEM, so the IDs
+// are held in the table rather than pointed to, and are read with pgm_read_byte/strcmp_P.
+#define CONTROL_TYPE_ID_SIZE 8
+
+struct ControlTypeID {
+    char idStr[CONTROL_TYPE_ID_SIZE];
+    uint8_t controlType;
+};
+
+#define CONTROL_TYPE_HASH_SEED 156
+#define CONTROL_TYPE_HASH_MULT 146
+#define CONTROL_TYPE_NUM_SLOTS 64
+#define CONTROL_TYPE_NO_SLOT   0xFF
+
+static constexpr ControlTypeID controlTypeIDs[] PROGMEM = {
+    {CONNECT_ID, connect},           //  0
+    {WHO_ID, who},                   //  1
+    {CTRL_ID, ctrl},                 //  2
+    {STATUS_ID, status},             //  3
+    {CLOCK_ID, dashClock},           //  4
+    {CONFIG_ID, config},             //  5
+    {STORE_AND_FORWARD_ID, storeAndForward}, // 6
+    {DEVICE_ID, device},             //  7
+    {DEVICE_VIEW_ID, deviceView},    //  8
+    {LABEL_ID, label},               //  9
+    {BUTTON_ID, button},             // 10
+    {MENU_ID, menu},                 // 11
+    {BUTTON_GROUP_ID, buttonGroup},  // 12
+    {EVENT_LOG_ID, eventLog},        // 13
+    {SLIDER_ID, slider},             // 14
+    {KNOB_ID, knob},                 // 15
+    {DIAL_ID, dial},                 // 16
+    {DIRECTION_ID, direction},       // 17
+    {TEXT_BOX_ID, textBox},          // 18
+    {SELECTOR_ID, selector},         // 19
+    {CHART_ID, chart},               // 20
+    {TIME_GRAPH_ID, timeGraph},      // 21
+    {MAP_ID, mapper},                // 22
+    {COLOR_ID, colorPicker},         // 23
+    {AV_ID, audioVisual},            // 24
+    {DEVICE_NAME_ID, deviceName},    // 25
+    {WIFI_SETUP_ID, wifiSetup},      // 26
+    {TCP_SETUP_ID, tcpSetup},        // 27 (same ID as TCP_CONNECTION_ID)
+    {DASHIO_SETUP_ID, dashioSetup},  // 28
+    {MQTT_SETUP_ID, mqttSetup},      // 29 (same ID as MQTT_CONNECTION_ID)
+    {RESET_DEVICE_ID, resetDevice},  // 30
+    {BLE_CONNECTION_ID, bleConn},    // 31
+    {ALARM_ID, alarmNotify},         // 32
+    {INIT_MODULE_ID, initModule}     // 33
+};
+
+#define X CONTROL_TYPE_NO_SLOT
+static constexpr uint8_t controlTypeSlots[CONTROL_TYPE_NUM_SLOTS] PROGMEM = {
+    X, 20, X, X, X, X, X, 30,
+    16, 24, X, 33, X, X, 4, 12,
+    26, 15, X, X, 28, 2, X, 23,
+    13, X, X, 3, 22, X, X, 8,
+    9, X, 29, 17, 18, X, 1, X,
+    X, 10, X, 7, 5, 11, 32, 21,
+    X, 31, 19, X, X, 14, X, X,
+    X, X, X, 0, 27, 6, X, 25
+};
+#undef X
+
+static constexpr uint16_t controlTypeHashStep(const char *str, uint16_t hash) {
+    return (*str == '\0') ? hash : controlTypeHashStep(str + 1, (uint16_t)(hash * CONTROL_TYPE_HASH_MULT + (uint8_t)*str));
+}
+
+static constexpr uint8_t controlTypeHashFold(uint16_t hash) {
+    return (hash ^ (hash >> 6)) & (CONTROL_TYPE_NUM_SLOTS - 1);
+}
+
+static constexpr uint8_t controlTypeHash(const char *str) {
+    return controlTypeHashFold(controlTypeHashStep(str, CONTROL_TYPE_HASH_SEED));
+}
+
+static constexpr bool controlTypeSlotsValid(unsigned int index) {
+    return (index >= sizeof(controlTypeIDs) / sizeof(controlTypeIDs[0])) ||
+           ((controlTypeSlots[controlTypeHash(controlTypeIDs[index].idStr)] == index) && controlTypeSlotsValid(index + 1));
+}
+
+static_assert(controlTypeSlotsValid(0), "controlTypeSlots doesn't match controlTypeIDs - regenerate the slot table");
+
+#define NUM_CONTROL_TYPE_IDS (sizeof(controlTypeIDs) / sizeof(controlTypeIDs[0]))
+
+// Index into controlTypeIDs, or CONTROL_TYPE_NO_SLOT if the ID isn't known
+static uint8_t controlTypeIndex(const char *idStr) {
+    uint8_t index = pgm_read_byte(&controlTypeSlots[controlTypeHash(idStr)]);
+    if ((index != CONTROL_TYPE_NO_SLOT) && (strcmp_P(idStr, controlTypeIDs[index].idStr) == 0)) {
+        return index;
+    }
+    return CONTROL_TYPE_NO_SLOT;
+}
+
+static ControlType controlTypeFromID(const char *idStr) {
+    uint8_t index = controlTypeIndex(idStr);
+    if (index != CONTROL_TYPE_NO_SLOT) {
+        return (ControlType)pgm_read_byte(&controlTypeIDs[index].controlType);
+    }
+    return unknown;
+}
+
+static void printControlTypeID(Print& out, uint8_t index) {
+    out.print((const __FlashStringHelper *)controlTypeIDs[index].idStr);
+}
+
+// Same IDs as getControlTypeStr, written from the table rather than through a String
+static void printControlTypeStr(Print& out, ControlType controlType) {
+    for (uint8_t i = 0; i < NUM_CONTROL_TYPE_IDS; i++) {
+        if (pgm_read_byte(&controlTypeIDs[i].controlType) == controlType) {
+            printControlTypeID(out, i);
+            return;
+        }
+    }
+    if (controlType == mqttConn) { // The connection types share their IDs with the setup controls in the table
+        out.print(MQTT_CONNECTION_ID);
+    } else if (controlType == tcpConn) {
+        out.print(TCP_CONNECTION_ID);
+    }
+}
+
+#ifndef ARDUINO_ARCH_AVR
+static const double powersOfTen[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                     1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+static double powerOfTen(int exponent) {
+    if (exponent > 22) {
+        return powersOfTen[22] * powersOfTen[exponent - 22];
+    }
+    return powersOfTen[exponent];
+}
+
+static char *writeDigits(char *buffer, unsigned long value, int minDigits) {
+    char digits[12];
+    int numDigits = 0;
+    do {
+        digits[numDigits++] = '0' + (value % 10);
+        value /= 10;
+    } while ((value > 0) || (numDigits < minDigits));
+    while (numDigits > 0) {
+        *buffer++ = digits[--numDigits];
     }
-    
-    char buffer[16];
-#ifdef ARDUINO_ARCH_AVR
-    dtostrf(value, 5, 2, buffer);
     return buffer;
-#else
-    if ((abs(value) < 1.0) || (abs(value) >= 100000)){
+}
+
+// Same text as sprintf "%5.2f", for 1 <= |value| < 100000.
+// value * 100 is exact in a double, so rounding (half to even, as printf does) is exact too.
+static void formatFixed2(char *buffer, float value) {
+    double scaled = (double)value * 100.0;
+    bool negative = scaled < 0;
+    if (negative) {
+        scaled = -scaled;
+    }
+    unsigned long hundredths = (unsigned long)scaled;
+    double remainder = scaled - hundredths;
+    if ((remainder > 0.5) || ((remainder == 0.5) && (hundredths & 1))) {
+        hundredths++;
+    }
+
+    char *ptr = buffer;
+    if (!negative && (hundredths < 1000)) {
+        *ptr++ = ' '; // Pad to the width of 5
+    }
+    if (negative) {
+        *ptr++ = '-';
+    }
+    ptr = writeDigits(ptr, hundredths / 100, 1);
+    *ptr++ = '.';
+    ptr = writeDigits(ptr, hundredths % 100, 2);
+    *ptr = '\0';
+}
+
+// Same text as sprintf "%5.2e", for finite non zero values.
+// The three significant digits are found with double arithmetic. If the result lies too close to a
+// rounding boundary for that to be trusted, sprintf decides instead, which almost never happens.
+static void formatExponent2(char *buffer, float value) {
+    double absValue = value < 0 ? -(double)value : (double)value;
+    int binaryExponent;
+    frexp(absValue, &binaryExponent);
+    int exponent = (int)floor((binaryExponent - 1) * 0.30103); // log10(2), corrected below if off by one
+    double scaled = 0;
+    for (int i = 0; i < 2; i++) {
+        if (exponent <= 2) {
+            scaled = absValue * powerOfTen(2 - exponent);
+        } else {
+            scaled = absValue / powerOfTen(exponent - 2);
+        }
+        if (scaled < 100.0) {
+            exponent--;
+        } else if (scaled >= 1000.0) {
+            exponent++;
+        } else {
+            break;
+        }
+    }
+
+    unsigned long digits = (unsigned long)scaled;
+    double remainder = scaled - digits;
+    if ((scaled < 100.0) || (scaled >= 1000.0) || (fabs(remainder - 0.5) < 1e-9)) {
         sprintf(buffer, "%5.2e", value);
+        return;
+    }
+    if (remainder > 0.5) {
+        digits++;
+        if (digits == 1000) {
+            digits = 100;
+            exponent++;
+        }
+    }
+
+    char *ptr = buffer;
+    if (value < 0) {
+        *ptr++ = '-';
+    }
+    *ptr++ = '0' + (digits / 100);
+    *ptr++ = '.';
+    ptr = writeDigits(ptr, digits % 100, 2);
+    *ptr++ = 'e';
+    if (exponent < 0) {
+        *ptr++ = '-';
+        exponent = -exponent;
     } else {
-        sprintf(buffer, "%5.2f", value);
+        *ptr++ = '+';
     }
-    return buffer;
+    ptr = writeDigits(ptr, exponent, 2);
+    *ptr = '\0';
+}
+#endif
+
+static char *formatFloat(char *buffer, float value) {
+    // buffer must be at least 16 chars
+    if (value == INVALID_FLOAT_VALUE) {
+        strcpy(buffer, "nan");
+    } else if (abs(value) < SMALLEST_FLOAT_VALUE) {
+        strcpy(buffer, "0");
+    } else {
+#ifdef ARDUINO_ARCH_AVR
+        dtostrf(value, 5, 2, buffer);
+#else
+        if (!isfinite(value)) {
+            sprintf(buffer, "%5.2f", value);
+        } else if ((abs(value) < 1.0) || (abs(value) >= 100000)){
+            formatExponent2(buffer, value);
+        } else {
+            formatFixed2(buffer, value);
+        }
 #endif
+    }
+    return buffer;
+}
+
+// Writes a fixed point value, e.g. 1e-7 degrees with 7 decimals, without going through a float. Returns the length
+static size_t formatFixed(char *buffer, int32_t value, uint8_t decimals) {
+    char digits[12];
+    uint32_t magnitude = (value < 0) ? -(uint32_t)value : value;
+    int numDigits = 0;
+    do {
+        digits[numDigits++] = '0' + (magnitude % 10);
+        magnitude /= 10;
+    } while ((magnitude > 0) || (numDigits <= decimals)); // At least one digit before the point
+
+    char *ptr = buffer;
+    if (value < 0) {
+        *ptr++ = '-';
+    }
+    while (numDigits > 0) {
+        if (numDigits == decimals) {
+            *ptr++ = '.';
+        }
+        *ptr++ = digits[--numDigits];
+    }
+    *ptr = '\0';
+    return ptr - buffer;
+}
+
+static uint32_t fnv1aHash(const char *data, size_t length) {
+    uint32_t hash = 2166136261UL;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= (uint8_t)data[i];
+        hash *= 16777619UL;
+    }
+    return hash;
+}
+
+// Counts what would be printed, for working out message lengths before writing them
+class DashLengthPrint : public Print {
+public:
+    size_t length = 0;
+    size_t write(uint8_t) {length++; return 1;}
+    size_t write(const uint8_t *, size_t size) {length += size; return size;}
+    using Print::write;
+};
+
+String formatFloat(float value) {
+    char buffer[16];
+    return formatFloat(buffer, value);
 }
 
 String formatInt(int value) {
@@ -155,91 +444,127 @@ MessageData::MessageData(ConnectionType connType, int _bufferLength) {
     deviceID.reserve(MAX_STRING_LEN);
     idStr.reserve(MAX_STRING_LEN);
     payloadStr.reserve(MAX_STRING_LEN);
+    payloadStr2.reserve(MAX_STRING_LEN);
     
     connectionType = connType;
 };
 
-void MessageData::loadBuffer(const String& message, uint16_t _connectionHandle) {
-    // Connection Handle is stored as the first bytes (of PREFIX_LEN) in the buffer message
-    uint prefixLen = sizeof(uint16_t);
-    char connectionHandleChrs[prefixLen];
-    memcpy(connectionHandleChrs, &_connectionHandle, prefixLen);
-
-    int messageLength = message.length() + prefixLen;
-    int avail = 0;
-    if (bufferLength > 0) {
-        if (bufferWritePtr >= bufferReadPtr) {
-            avail = bufferLength - (bufferWritePtr - bufferReadPtr);
-        } else {
-            avail = bufferReadPtr - bufferWritePtr;
-        }
+void MessageData::loadBuffer(const char *message, size_t length, uint16_t _connectionHandle) {
+    // Each block is stored with a prefix of the Connection Handle and the block length, so that messages split
+    // across several blocks, or several messages in one block, are reassembled correctly.
+    // Only called from one task (the producer) while checkBuffer is called from another (the consumer), so the
+    // write pointer is only moved by this function and the read pointer only by checkBuffer
+    uint16_t blockLength = length;
+    char prefixChrs[BUFFER_PREFIX_LEN];
+    memcpy(prefixChrs, &_connectionHandle, sizeof(uint16_t));
+    memcpy(prefixChrs + sizeof(uint16_t), &blockLength, sizeof(uint16_t));
+
+    int messageLength = blockLength + BUFFER_PREFIX_LEN;
+    int writePtr = bufferWritePtr;
+    int readPtr = bufferReadPtr;
+    int used = writePtr - readPtr;
+    if (used < 0) {
+        used += bufferLength;
     }
     
-    if (avail < messageLength) {
+    if ((length > UINT16_MAX) || (used + messageLength >= bufferLength)) { // Never fill completely, as read == write means empty
+        overflowCount++;
 #ifdef ESP32
-        ESP_LOGI(DTAG, "%s Buffer overflow - can't process message: : %s", getConnectionTypeStr(), message);
+        ESP_LOGI(DTAG, "%s Buffer overflow - can't process message: : %.*s", getConnectionTypeStr().c_str(), (int)length, message);
 #else
         Serial.print(getConnectionTypeStr() + " ");
         Serial.print(F("Buffer overflow - can't process message: "));
-        Serial.println(message);
+        Serial.write(message, length);
+        Serial.println();
 #endif
     } else {
-        for (int i = 0; i < messageLength; i++) {
-            if (i < prefixLen) {
-                buffer[bufferWritePtr] = connectionHandleChrs[i];
-            } else {
-                buffer[bufferWritePtr] = message[i - prefixLen];
-            }
-            bufferWritePtr++;
-            if (bufferWritePtr >= bufferLength) {
-                bufferWritePtr = 0;
-            }
+        writePtr = copyToBuffer(writePtr, prefixChrs, BUFFER_PREFIX_LEN);
+        writePtr = copyToBuffer(writePtr, message, blockLength);
+        if (used + messageLength > highWater) {
+            highWater = used + messageLength;
         }
+        MEMORY_BARRIER(); // The block must be in the buffer before the consumer can see it
+        bufferWritePtr = writePtr; // Only publish whole blocks
+    }
+}
+
+int MessageData::copyToBuffer(int writePtr, const char *data, int length) {
+    int firstPart = bufferLength - writePtr;
+    if (length < firstPart) {
+        firstPart = length;
     }
+    memcpy(buffer + writePtr, data, firstPart);
+    memcpy(buffer, data + firstPart, length - firstPart); // Wrapped around
+    writePtr += length;
+    if (writePtr >= bufferLength) {
+        writePtr -= bufferLength;
+    }
+    return writePtr;
 }
 
 void MessageData::checkBuffer() {
     if (!messageReceived) { // wait until last message processed
-        if (bufferWritePtr != bufferReadPtr) {
-            uint prefixLen = sizeof(uint16_t);
-            char prefixChrs[prefixLen];
-            bool unloadedMessage = false;
-            int count = 0;
-            while (bufferReadPtr != bufferWritePtr) { // read pointer has caught up to write pointer, therefore, must be the end
-                if (count++ > bufferLength) { // can't find valid message, so quit
-                    unloadedMessage = false;
-                    break;
-                }
-
-                char chr = buffer[bufferReadPtr];
-
-                bufferReadPtr++;
-                if (bufferReadPtr >= bufferLength) {
-                    bufferReadPtr = 0;
-                }
+        int readPtr = bufferReadPtr;
+        int writePtr = bufferWritePtr;
+        MEMORY_BARRIER(); // Don't read the block before the write pointer that published it
+        while (readPtr != writePtr) { // read pointer has caught up to write pointer, therefore, must be the end
+            char chr = buffer[readPtr];
+            readPtr++;
+            if (readPtr >= bufferLength) {
+                readPtr = 0;
+            }
 
-                if (count <= prefixLen) {
-                    prefixChrs[count - 1] = chr; // Retrieve Connection Handle bytes
-                } else {
-                    if (processChar(chr)) {
-                        memcpy(&connectionHandle, prefixChrs, prefixLen);
-                        unloadedMessage = true;
-                        break;
+            if (blockPrefixCount < BUFFER_PREFIX_LEN) {
+                blockPrefix[blockPrefixCount++] = chr; // Retrieve Connection Handle and block length bytes
+                if (blockPrefixCount == BUFFER_PREFIX_LEN) {
+                    memcpy(&blockConnectionHandle, blockPrefix, sizeof(uint16_t));
+                    memcpy(&blockRemaining, blockPrefix + sizeof(uint16_t), sizeof(uint16_t));
+                    if (blockRemaining == 0) {
+                        blockPrefixCount = 0;
                     }
                 }
+            } else {
+                blockRemaining--;
+                if (blockRemaining == 0) {
+                    blockPrefixCount = 0; // Next byte starts a new block
+                }
+                if (processChar(chr)) {
+                    connectionHandle = blockConnectionHandle;
+                    messageReceived = true;
+                    break;
+                }
             }
-
-            messageReceived = unloadedMessage;
         }
+        MEMORY_BARRIER(); // Finished with the bytes before the producer can reuse them
+        bufferReadPtr = readPtr;
+    }
+}
+
+// Makes the next waiting message current, so run() can handle every message that has arrived with
+// while (data.nextMessage()) {...}. Returns false when there are no more
+bool MessageData::nextMessage() {
+    if (!messageReceived) {
+        checkBuffer();
     }
+    if (messageReceived) {
+        messageReceived = false;
+        return true;
+    }
+    return false;
 }
 
 void MessageData::processMessage(const String& message, uint16_t _connectionHandle) {
-    if (message.length() > 0) {
+    processMessage(message.c_str(), message.length(), _connectionHandle);
+}
+
+// For payloads straight from a client's receive buffer. They don't need to be NUL terminated, and are copied
+// into the incoming buffer in one go, or parsed in place if there's no buffer
+void MessageData::processMessage(const char *message, size_t length, uint16_t _connectionHandle) {
+    if (length > 0) {
         if (bufferLength > 0) { // Storing to buffer allows for concatenated dash messages
-            loadBuffer(message, _connectionHandle);
+            loadBuffer(message, length, _connectionHandle);
         } else {
-            for (unsigned int i = 0; i < message.length(); i++) {
+            for (size_t i = 0; i < length; i++) {
                 char chr = message[i];
                 if (processChar(chr)) {
                     connectionHandle = _connectionHandle;
@@ -253,23 +578,25 @@ void MessageData::processMessage(const String& message, uint16_t _connectionHand
 bool MessageData::processChar(char chr) {
     bool messageEnd = false;
     if ((chr == DELIM) || (chr == END_DELIM)) {
-        if ((readStr.length() > 0) || (segmentCount == 1)) { // segmentCount == 1 allows for empty second field ??? maybe should be 2 for empty third field now that we've added deviceID at the front
+        readBuffer[readLength] = '\0';
+        truncating = false;
+        if ((readLength > 0) || (segmentCount == 1)) { // segmentCount == 1 allows for empty second field ??? maybe should be 2 for empty third field now that we've added deviceID at the front
             switch (segmentCount) {
             case 0:
-                if (checkPrefix && readStr == BLE_CONNECTION_ID) {
+                if (checkPrefix && (strcmp(readBuffer, BLE_CONNECTION_ID) == 0)) {
                     connectionType = BLE_CONN;
                     segmentCount = -1;
-                } else if (checkPrefix && readStr == TCP_CONNECTION_ID) {
+                } else if (checkPrefix && (strcmp(readBuffer, TCP_CONNECTION_ID) == 0)) {
                     connectionType = TCP_CONN;
                     segmentCount = -1;
-                } else if (checkPrefix && readStr == MQTT_CONNECTION_ID) {
+                } else if (checkPrefix && (strcmp(readBuffer, MQTT_CONNECTION_ID) == 0)) {
                     connectionType = MQTT_CONN;
                     segmentCount = -1;
-                } else if (readStr == WHO_ID) {
+                } else if (strcmp(readBuffer, WHO_ID) == 0) {
                     deviceID = "---";
                     control = who;
                 } else {
-                    deviceID = readStr;
+                    deviceID = readBuffer;
                     control = unknown;
                 }
                       
@@ -278,63 +605,19 @@ bool MessageData::processChar(char chr) {
                 payloadStr2 = "";
                 break;
             case 1:
-                if (readStr == WHO_ID) {
-                    control = who;
-                } else if (readStr == CTRL_ID) {
-                    control = ctrl;
-                } else if (readStr == CONNECT_ID) {
-                    control = connect;
-                } else if (readStr == CLOCK_ID) {
-                    control = dashClock;
-                } else if (readStr == STATUS_ID) {
-                    control = status;
-                } else if (readStr == CONFIG_ID) {
-                    control = config;
-                } else if (readStr == BUTTON_ID) {
-                    control = button;
-                } else if (readStr == SLIDER_ID) {
-                    control = slider;
-                } else if (readStr == KNOB_ID) {
-                    control = knob;
-                } else if (readStr == TEXT_BOX_ID) {
-                    control = textBox;
-                } else if (readStr == TIME_GRAPH_ID) {
-                    control = timeGraph;
-                } else if (readStr == MENU_ID) {
-                    control = menu;
-                } else if (readStr == BUTTON_GROUP_ID) {
-                    control = buttonGroup;
-                } else if (readStr == EVENT_LOG_ID) {
-                    control = eventLog;
-                } else if (readStr == SELECTOR_ID) {
-                    control = selector;
-                } else if (readStr == COLOR_ID) {
-                    control = colorPicker;
-                } else if (readStr == DEVICE_NAME_ID) {
-                    control = deviceName;
-                } else if (readStr == WIFI_SETUP_ID) {
-                    control = wifiSetup;
-                } else if (readStr == TCP_SETUP_ID) {
-                    control = tcpSetup;
-                } else if (readStr == DASHIO_SETUP_ID) {
-                    control = dashioSetup;
-                } else if (readStr == MQTT_SETUP_ID) {
-                    control = mqttSetup;
-                } else if (readStr == RESET_DEVICE_ID) {
-                    control = resetDevice;
-                } else {
-                    control = unknown;
+                control = controlTypeFromID(readBuffer);
+                if (control == unknown) {
                     segmentCount = -1;
                 }
                 break;
             case 2:
-                idStr = readStr;
+                idStr = readBuffer;
                 break;
             case 3:
-                payloadStr = readStr;
+                payloadStr = readBuffer;
                 break;
             case 4:
-                payloadStr2 = readStr;
+                payloadStr2 = readBuffer;
                 break;
             default:
                     segmentCount = 0;
@@ -350,9 +633,12 @@ bool MessageData::processChar(char chr) {
         } else {
             segmentCount = 0; // Must have no data before DELIM or a DELIM + DELIM, so must be start of message
         }
-        readStr = "";
-    } else {
-        readStr += chr;
+        readLength = 0;
+    } else if (readLength < MAX_MESSAGE_FIELD_LEN) {
+        readBuffer[readLength++] = chr;
+    } else if (!truncating) { // Field is too long for the read buffer, so keep what fits and still deliver the message
+        truncating = true;
+        truncatedCount++;
     }
     return messageEnd;
 }
@@ -506,6 +792,207 @@ void DashioDevice::onStatusCallback(StatusCode statusCode) {
     }
 }
 
+void DashioDevice::enableDeltaCache(unsigned int maxControls, unsigned long refreshMs) {
+    deltaCache.begin(maxControls, refreshMs);
+}
+
+String DashioDevice::getChangedMessages(const String& messages) {
+    if (!deltaCache.enabled()) {
+        return messages;
+    }
+
+    String changed((char *)0);
+    changed.reserve(messages.length());
+    DashStringPrint out(changed);
+    const char *start = messages.c_str();
+    const char *end = start + messages.length();
+    while (start < end) {
+        const char *lineEnd = (const char *)memchr(start, END_DELIM, end - start);
+        size_t length = (lineEnd == nullptr) ? (size_t)(end - start) : (size_t)(lineEnd - start + 1);
+        if (deltaCache.isChanged(start, length)) {
+            out.write((const uint8_t *)start, length);
+        }
+        start += length;
+    }
+    return changed;
+}
+
+void DashioDevice::resyncDeltaCache() {
+    deltaCache.clear();
+}
+
+void DashioDevice::registerControl(ControlType controlType, const String& controlID, void (*handler)(MessageData *messageData), bool *state) {
+    addControl(controlType, controlID, handler, state, state == nullptr ? noState : boolState);
+}
+
+void DashioDevice::registerControl(ControlType controlType, const String& controlID, void (*handler)(MessageData *messageData), int *state) {
+    addControl(controlType, controlID, handler, state, intState);
+}
+
+void DashioDevice::registerControl(ControlType controlType, const String& controlID, void (*handler)(MessageData *messageData), float *state) {
+    addControl(controlType, controlID, handler, state, floatState);
+}
+
+void DashioDevice::registerControl(ControlType controlType, const String& controlID, void (*handler)(MessageData *messageData), String *state) {
+    addControl(controlType, controlID, handler, state, stringState);
+}
+
+static bool controlBefore(ControlType controlType, uint32_t idHash, const DashControl& control) {
+    return (controlType < control.controlType) || ((controlType == control.controlType) && (idHash < control.idHash));
+}
+
+// Registration happens at setup, so the table is simply reallocated and kept sorted for a binary search per message
+void DashioDevice::addControl(ControlType controlType, const String& controlID, void (*handler)(MessageData *messageData), void *state, DashStateType stateType) {
+    DashControl *existing = findControl(controlType, controlID);
+    if (existing != nullptr) {
+        existing->handler = handler;
+        existing->state = state;
+        existing->stateType = (state == nullptr) ? noState : stateType;
+        return;
+    }
+
+    uint32_t idHash = fnv1aHash(controlID.c_str(), controlID.length());
+    DashControl *newControls = new DashControl[numControls + 1];
+    int j = 0;
+    bool added = false;
+    for (int i = 0; i < numControls; i++) {
+        if (!added && controlBefore(controlType, idHash, controls[i])) {
+            newControls[j++] = {controlType, idHash, controlID, handler, state, (state == nullptr) ? noState : stateType};
+            added = true;
+        }
+        newControls[j++] = controls[i];
+    }
+    if (!added) {
+        newControls[j] = {controlType, idHash, controlID, handler, state, (state == nullptr) ? noState : stateType};
+    }
+    delete[] controls;
+    controls = newControls;
+    numControls++;
+}
+
+DashControl *DashioDevice::findControl(ControlType controlType, const String& controlID) {
+    uint32_t idHash = fnv1aHash(controlID.c_str(), controlID.length());
+    int low = 0;
+    int high = numControls - 1;
+    while (low <= high) {
+        int mid = (low + high) / 2;
+        if (controlBefore(controlType, idHash, controls[mid])) {
+            high = mid - 1;
+        } else if ((controls[mid].controlType == controlType) && (controls[mid].idHash == idHash)) {
+            // Hashes can collide, so check the neighbours with the same hash for the actual ID
+            while ((mid > 0) && (controls[mid - 1].controlType == controlType) && (controls[mid - 1].idHash == idHash)) {
+                mid--;
+            }
+            for (; (mid < numControls) && (controls[mid].controlType == controlType) && (controls[mid].idHash == idHash); mid++) {
+                if (controls[mid].controlID == controlID) {
+                    return &controls[mid];
+                }
+            }
+            return nullptr;
+        } else {
+            low = mid + 1;
+        }
+    }
+    return nullptr;
+}
+
+bool DashioDevice::dispatchMessage(MessageData *messageData) {
+    DashControl *control = findControl(messageData->control, messageData->idStr);
+    if (control == nullptr) {
+        return false;
+    }
+
+    switch (control->stateType) {
+        case intState:
+            *(int *)control->state = messageData->payloadStr.toInt();
+            break;
+        case floatState:
+            *(float *)control->state = messageData->payloadStr.toFloat();
+            break;
+        case stringState:
+            *(String *)control->state = messageData->payloadStr;
+            break;
+        default:
+            break;
+    }
+
+    if (control->handler != nullptr) {
+        control->handler(messageData);
+    }
+    return true;
+}
+
+bool DashioDevice::hasRegisteredState() {
+    for (int i = 0; i < numControls; i++) {
+        if (controls[i].stateType != noState) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// The state of every control registered with a state pointer, as a reply to STATUS. Empty if there are none
+String DashioDevice::getRegisteredStatusMessage() {
+    DashLengthPrint length; // Any number of controls, so measured first
+    writeRegisteredStatusMessage(length);
+    String message((char *)0);
+    message.reserve(length.length);
+    DashStringPrint out(message);
+    writeRegisteredStatusMessage(out);
+    return message;
+}
+
+void DashioDevice::writeRegisteredStatusMessage(Print& out) {
+    for (int i = 0; i < numControls; i++) {
+        if (controls[i].stateType != noState) {
+            writeControlState(out, controls[i]);
+        }
+    }
+}
+
+void DashioDevice::writeControlState(Print& out, const DashControl& control) {
+    switch (control.stateType) {
+        case boolState:
+            if (control.controlType == button) {
+                writeButtonMessage(out, control.controlID, *(bool *)control.state);
+            }
+            break;
+        case stringState:
+            if (control.controlType == textBox) {
+                writeTextBoxMessage(out, control.controlID, *(String *)control.state);
+            }
+            break;
+        case intState:
+        case floatState: {
+            bool isInt = (control.stateType == intState);
+            int intValue = isInt ? *(int *)control.state : 0;
+            float floatValue = isInt ? 0 : *(float *)control.state;
+            switch (control.controlType) {
+                case textBox:
+                    writeTextBoxMessage(out, control.controlID, isInt ? String(intValue) : String(floatValue));
+                    break;
+                case selector:
+                    writeSelectorMessage(out, control.controlID, isInt ? intValue : (int)floatValue);
+                    break;
+                case slider:
+                    isInt ? writeSliderMessage(out, control.controlID, intValue) : writeSliderMessage(out, control.controlID, floatValue);
+                    break;
+                case knob:
+                    isInt ? writeKnobMessage(out, control.controlID, intValue) : writeKnobMessage(out, control.controlID, floatValue);
+                    break;
+                case dial:
+                    isInt ? writeDialMessage(out, control.controlID, intValue) : writeDialMessage(out, control.controlID, floatValue);
+                    break;
+                default:
+                    break;
+            }
+            break;
+        }
+        default:
+            break;
+    }
+}
+
 void DashioDevice::appendDelimitedStr(String *str, const String& addStr) {
     String message = *str;
     *str += String(DELIM);
@@ -513,127 +1000,182 @@ void DashioDevice::appendDelimitedStr(String *str, const String& addStr) {
 }
 
 String DashioDevice::getOnlineMessage() {
-    String message = String(DELIM);
-    message += deviceID;
-    message += MQTT_ONLINE_MSSG;
+    String message((char *)0);
+    message.reserve(deviceID.length() + MESSAGE_RESERVE_LEN);
+    DashStringPrint out(message);
+    writeOnlineMessage(out);
     return message;
 }
 
+void DashioDevice::writeOnlineMessage(Print& out) {
+    out.print(DELIM);
+    out.print(deviceID);
+    out.print(MQTT_ONLINE_MSSG);
+}
+
 String DashioDevice::getOfflineMessage() {
-    String message = String(DELIM);
-    message += deviceID;
-    message += MQTT_OFFLINE_MSSG;
+    String message((char *)0);
+    message.reserve(deviceID.length() + MESSAGE_RESERVE_LEN);
+    DashStringPrint out(message);
+    writeOfflineMessage(out);
     return message;
 }
 
+void DashioDevice::writeOfflineMessage(Print& out) {
+    out.print(DELIM);
+    out.print(deviceID);
+    out.print(MQTT_OFFLINE_MSSG);
+}
+
 String DashioDevice::getDataStoreEnableMessage(DashStore dashStore) {
-    String message = getControlBaseMessage(STORE_ENABLE_ID, getControlTypeStr(dashStore.controlType));
-    message += dashStore.controlID;
-    message += String(END_DELIM);
+    String message((char *)0);
+    message.reserve(deviceID.length() + dashStore.controlID.length() + MESSAGE_RESERVE_LEN);
+    DashStringPrint out(message);
+    writeDataStoreEnableMessage(out, dashStore);
     return message;
 }
 
+void DashioDevice::writeDataStoreEnableMessage(Print& out, const DashStore& dashStore) {
+    out.print(DELIM);
+    out.print(deviceID);
+    out.print(DELIM);
+    out.print(STORE_ENABLE_ID);
+    out.print(DELIM);
+    printControlTypeStr(out, dashStore.controlType);
+    out.print(DELIM);
+    out.print(dashStore.controlID);
+    out.print(END_DELIM);
+}
+
 String DashioDevice::getWhoMessage() {
-    String message = String(DELIM);
-    message += deviceID;
-    message += String(DELIM);
-    message += WHO_ID;
-    message += String(DELIM);
-    message += type;
-    message += String(DELIM);
-    message += name;
-    message += String(DELIM);
-    message += String(cfgRevision);
-    message += String(END_DELIM);
+    String message((char *)0);
+    message.reserve(deviceID.length() + type.length() + name.length() + MESSAGE_RESERVE_LEN);
+    DashStringPrint out(message);
+    writeWhoMessage(out);
     return message;
 }
 
+void DashioDevice::writeWhoMessage(Print& out) {
+    out.print(DELIM);
+    out.print(deviceID);
+    out.print(DELIM);
+    out.print(WHO_ID);
+    out.print(DELIM);
+    out.print(type);
+    out.print(DELIM);
+    out.print(name);
+    out.print(DELIM);
+    out.print(cfgRevision);
+    out.print(END_DELIM);
+}
+
 String DashioDevice::getConnectMessage() {
-    String message = String(DELIM);
-    message += deviceID;
-    message += String(DELIM);
-    message += CONNECT_ID;
-    message += String(END_DELIM);
-    return  message;
+    String message((char *)0);
+    message.reserve(deviceID.length() + MESSAGE_RESERVE_LEN);
+    DashStringPrint out(message);
+    writeConnectMessage(out);
+    return message;
+}
+
+void DashioDevice::writeConnectMessage(Print& out) {
+    writeDeviceMessage(out, CONNECT_ID);
 }
 
 String DashioDevice::getClockMessage() {
-    String message = String(DELIM);
-    message += deviceID;
-    message += String(DELIM);
-    message += CLOCK_ID;
-    message += String(END_DELIM);
-    return  message;
+    String message((char *)0);
+    message.reserve(deviceID.length() + MESSAGE_RESERVE_LEN);
+    DashStringPrint out(message);
+    writeClockMessage(out);
+    return message;
+}
+
+void DashioDevice::writeClockMessage(Print& out) {
+    writeDeviceMessage(out, CLOCK_ID);
 }
 
 String DashioDevice::getDeviceNameMessage() {
-    String message = String(DELIM);
-    message += deviceID;
-    message += String(DELIM);
-    message += DEVICE_NAME_ID;
-    message += String(DELIM);
-    message += name;
-    message += String(END_DELIM);
+    String message((char *)0);
+    message.reserve(deviceID.length() + name.length() + MESSAGE_RESERVE_LEN);
+    DashStringPrint out(message);
+    writeDeviceNameMessage(out);
     return message;
 }
 
+void DashioDevice::writeDeviceNameMessage(Print& out) {
+    out.print(DELIM);
+    out.print(deviceID);
+    out.print(DELIM);
+    out.print(DEVICE_NAME_ID);
+    out.print(DELIM);
+    out.print(name);
+    out.print(END_DELIM);
+}
+
 String DashioDevice::getWifiUpdateAckMessage() {
-    String message = String(DELIM);
-    message += deviceID;
-    message += String(DELIM);
-    message += WIFI_SETUP_ID;
-    message += String(END_DELIM);
+    String message((char *)0);
+    message.reserve(deviceID.length() + MESSAGE_RESERVE_LEN);
+    DashStringPrint out(message);
+    writeWifiUpdateAckMessage(out);
     return message;
 }
 
+void DashioDevice::writeWifiUpdateAckMessage(Print& out) {
+    writeDeviceMessage(out, WIFI_SETUP_ID);
+}
+
 String DashioDevice::getTCPUpdateAckMessage() {
-    String message = String(DELIM);
-    message += deviceID;
-    message += String(DELIM);
-    message += TCP_SETUP_ID;
-    message += String(END_DELIM);
+    String message((char *)0);
+    message.reserve(deviceID.length() + MESSAGE_RESERVE_LEN);
+    DashStringPrint out(message);
+    writeTCPUpdateAckMessage(out);
     return message;
 }
 
+void DashioDevice::writeTCPUpdateAckMessage(Print& out) {
+    writeDeviceMessage(out, TCP_SETUP_ID);
+}
+
 String DashioDevice::getDashioUpdateAckMessage() {
-    String message = String(DELIM);
-    message += deviceID;
-    message += String(DELIM);
-    message += DASHIO_SETUP_ID;
-    message += String(END_DELIM);
+    String message((char *)0);
+    message.reserve(deviceID.length() + MESSAGE_RESERVE_LEN);
+    DashStringPrint out(message);
+    writeDashioUpdateAckMessage(out);
     return message;
 }
 
+void DashioDevice::writeDashioUpdateAckMessage(Print& out) {
+    writeDeviceMessage(out, DASHIO_SETUP_ID);
+}
+
 String DashioDevice::getMQTTUpdateAckMessage() {
-    String message = String(DELIM);
-    message += deviceID;
-    message += String(DELIM);
-    message += MQTT_SETUP_ID;
-    message += String(END_DELIM);
+    String message((char *)0);
+    message.reserve(deviceID.length() + MESSAGE_RESERVE_LEN);
+    DashStringPrint out(message);
+    writeMQTTUpdateAckMessage(out);
     return message;
 }
 
+void DashioDevice::writeMQTTUpdateAckMessage(Print& out) {
+    writeDeviceMessage(out, MQTT_SETUP_ID);
+}
+
 String DashioDevice::getResetDeviceMessage() {
-    String message = String(DELIM);
-    message += deviceID;
-    message += String(DELIM);
-    message += RESET_DEVICE_ID;
-    message += String(END_DELIM);
+    String message((char *)0);
+    message.reserve(deviceID.length() + MESSAGE_RESERVE_LEN);
+    DashStringPrint out(message);
+    writeResetDeviceMessage(out);
     return message;
 }
 
+void DashioDevice::writeResetDeviceMessage(Print& out) {
+    writeDeviceMessage(out, RESET_DEVICE_ID);
+}
+
 String DashioDevice::getAlarmMessage(const String& controlID, const String& title, const String& description) {
-    String message = String(DELIM);
-    message += deviceID;
-    message += String(DELIM);
-    message += ALARM_ID;
-    message += String(DELIM);
-    message += controlID;
-    message += String(DELIM);
-    message += title;
-    message += String(DELIM);
-    message += description;
-    message += String(END_DELIM);
+    String message((char *)0);
+    message.reserve(deviceID.length() + controlID.length() + title.length() + description.length() + MESSAGE_RESERVE_LEN);
+    DashStringPrint out(message);
+    writeAlarmMessage(out, controlID, title, description);
     return message;
 }
 
@@ -641,368 +1183,678 @@ String DashioDevice::getAlarmMessage(Notification alarm) {
     return getAlarmMessage(alarm.identifier, alarm.title, alarm.description);
 }
 
-String DashioDevice::getControlBaseMessage(const String& controlType, const String& controlID) {
-    String message = "";
-    addControlBaseMessage(message, controlType, controlID);
-    return message;
+void DashioDevice::writeAlarmMessage(Print& out, const String& controlID, const String& title, const String& description) {
+    out.print(DELIM);
+    out.print(deviceID);
+    out.print(DELIM);
+    out.print(ALARM_ID);
+    out.print(DELIM);
+    out.print(controlID);
+    out.print(DELIM);
+    out.print(title);
+    out.print(DELIM);
+    out.print(description);
+    out.print(END_DELIM);
 }
 
-void DashioDevice::addControlBaseMessage(String& message, const String& controlType, const String& controlID) {
-    message += String(DELIM);
-    message += deviceID;
-    message += String(DELIM);
-    message += controlType;
-    message += String(DELIM);
-    message += controlID;
-    message += String(DELIM);
+void DashioDevice::writeAlarmMessage(Print& out, const Notification& alarm) {
+    writeAlarmMessage(out, alarm.identifier, alarm.title, alarm.description);
 }
 
-String DashioDevice::getButtonMessage(const String& controlID) {
-    String message = getControlBaseMessage(BUTTON_ID, controlID);
-    message += NOT_AVAILABLE;
-    message += String(END_DELIM);
-    return message;
+void DashioDevice::writeDeviceMessage(Print& out, const char *messageType) {
+    out.print(DELIM);
+    out.print(deviceID);
+    out.print(DELIM);
+    out.print(messageType);
+    out.print(END_DELIM);
 }
 
-String DashioDevice::getButtonMessage(const String& controlID, bool on, const String& iconName, const String& text) {
-    String message = getControlBaseMessage(BUTTON_ID, controlID);
-    if (on) {
-        message += BUTTON_ON;
+void DashioDevice::writeControlBaseMessage(Print& out, const char *controlType, const String& controlID) {
+    out.print(DELIM);
+    out.print(deviceID);
+    out.print(DELIM);
+    out.print(controlType);
+    out.print(DELIM);
+    out.print(controlID);
+    out.print(DELIM);
+}
+
+void DashioDevice::writeNotAvailableMessage(Print& out, const char *controlType, const String& controlID) {
+    writeControlBaseMessage(out, controlType, controlID);
+    out.print(NOT_AVAILABLE);
+    out.print(END_DELIM);
+}
+
+void DashioDevice::writeIntMessage(Print& out, const char *controlType, const String& controlID, int value) {
+    writeControlBaseMessage(out, controlType, controlID);
+    writeInt(out, value);
+    out.print(END_DELIM);
+}
+
+void DashioDevice::writeFloatMessage(Print& out, const char *controlType, const String& controlID, float value) {
+    writeControlBaseMessage(out, controlType, controlID);
+    writeFloat(out, value);
+    out.print(END_DELIM);
+}
+
+String DashioDevice::getButtonMessage(const String& controlID) {
+    String message((char *)0);
+    message.reserve(deviceID.length() + controlID.length() + MESSAGE_RESERVE_LEN);
+    DashStringPrint out(message);
+    writeButtonMessage(out, controlID);
+    return message;
+}
+
+void DashioDevice::writeButtonMessage(Print& out, const String& controlID) {
+    writeNotAvailableMessage(out, BUTTON_ID, controlID);
+}
+
+String DashioDevice::getButtonMessage(const String& controlID, bool on, const String& iconName, const String& text) {
+    String message((char *)0);
+    message.reserve(deviceID.length() + controlID.length() + iconName.length() + text.length() + MESSAGE_RESERVE_LEN);
+    DashStringPrint out(message);
+    writeButtonMessage(out, controlID, on, iconName, text);
+    return message;
+}
+
+void DashioDevice::writeButtonMessage(Print& out, const String& controlID, bool on, const String& iconName, const String& text) {
+    writeControlBaseMessage(out, BUTTON_ID, controlID);
+    if (on) {
+        out.print(BUTTON_ON);
     } else {
-        message += BUTTON_OFF;
+        out.print(BUTTON_OFF);
     }
-    if (text != "") {
-        message += String(DELIM);
-        message += iconName;
-        message += String(DELIM);
-        message += text;
+    if (text.length() > 0) {
+        out.print(DELIM);
+        out.print(iconName);
+        out.print(DELIM);
+        out.print(text);
     } else {
-        if (iconName != "") {
-            message += String(DELIM);
-            message += iconName;
+        if (iconName.length() > 0) {
+            out.print(DELIM);
+            out.print(iconName);
         }
     }
-    message += String(END_DELIM);
-    return message;
+    out.print(END_DELIM);
 }
 
 String DashioDevice::getTextBoxMessage(const String& controlID, const String& text, const String& color) {
-    String message = getControlBaseMessage(TEXT_BOX_ID, controlID);
-    message += text;
-    if (color != "") {
-        message += String(DELIM);
-        message += color;
-    }
-    message += String(END_DELIM);
+    String message((char *)0);
+    message.reserve(deviceID.length() + controlID.length() + text.length() + color.length() + MESSAGE_RESERVE_LEN);
+    DashStringPrint out(message);
+    writeTextBoxMessage(out, controlID, text, color);
     return message;
 }
 
-String DashioDevice::getTextBoxCaptionMessage(const String& controlID, const String& text, const String& color) {
-    String message = getControlBaseMessage(TEXT_CAPTION_ID, controlID);
-    message += text;
-    if (color != "") {
-        message += String(DELIM);
-        message += color;
+void DashioDevice::writeTextBoxMessage(Print& out, const String& controlID, const String& text, const String& color) {
+    writeControlBaseMessage(out, TEXT_BOX_ID, controlID);
+    out.print(text);
+    if (color.length() > 0) {
+        out.print(DELIM);
+        out.print(color);
     }
-    message += String(END_DELIM);
+    out.print(END_DELIM);
+}
+
+String DashioDevice::getTextBoxCaptionMessage(const String& controlID, const String& text, const String& color) {
+    String message((char *)0);
+    message.reserve(deviceID.length() + controlID.length() + text.length() + color.length() + MESSAGE_RESERVE_LEN);
+    DashStringPrint out(message);
+    writeTextBoxCaptionMessage(out, controlID, text, color);
     return message;
 }
 
+void DashioDevice::writeTextBoxCaptionMessage(Print& out, const String& controlID, const String& text, const String& color) {
+    writeControlBaseMessage(out, TEXT_CAPTION_ID, controlID);
+    out.print(text);
+    if (color.length() > 0) {
+        out.print(DELIM);
+        out.print(color);
+    }
+    out.print(END_DELIM);
+}
+
 String DashioDevice::getSelectorMessage(const String& controlID) {
-    String message = getControlBaseMessage(SELECTOR_ID, controlID);
-    message += NOT_AVAILABLE;
-    message += String(END_DELIM);
+    String message((char *)0);
+    message.reserve(deviceID.length() + controlID.length() + MESSAGE_RESERVE_LEN);
+    DashStringPrint out(message);
+    writeSelectorMessage(out, controlID);
     return message;
 }
 
+void DashioDevice::writeSelectorMessage(Print& out, const String& controlID) {
+    writeNotAvailableMessage(out, SELECTOR_ID, controlID);
+}
+
 String DashioDevice::getSelectorMessage(const String& controlID, int index) {
-    String message = getControlBaseMessage(SELECTOR_ID, controlID);
-    message += String(index);
-    message += String(END_DELIM);
+    String message((char *)0);
+    message.reserve(deviceID.length() + controlID.length() + MESSAGE_RESERVE_LEN);
+    DashStringPrint out(message);
+    writeSelectorMessage(out, controlID, index);
     return message;
 }
 
+void DashioDevice::writeSelectorMessage(Print& out, const String& controlID, int index) {
+    writeControlBaseMessage(out, SELECTOR_ID, controlID);
+    out.print(index);
+    out.print(END_DELIM);
+}
+
 String DashioDevice::getSelectorMessage(const String& controlID, int index, String selectionItems[], int numItems) {
-    String message = getControlBaseMessage(SELECTOR_ID, controlID);
-    message += String(index);
+    String message((char *)0);
+    DashLengthPrint length; // Any number of items, so measured first
+    writeSelectorMessage(length, controlID, index, selectionItems, numItems);
+    message.reserve(length.length);
+    DashStringPrint out(message);
+    writeSelectorMessage(out, controlID, index, selectionItems, numItems);
+    return message;
+}
+
+void DashioDevice::writeSelectorMessage(Print& out, const String& controlID, int index, String selectionItems[], int numItems) {
+    writeControlBaseMessage(out, SELECTOR_ID, controlID);
+    out.print(index);
     for (int i = 0; i < numItems; i++) {
-        message += String(DELIM);
-        message += selectionItems[i];
+        out.print(DELIM);
+        out.print(selectionItems[i]);
     }
-    message += String(END_DELIM);
-    return message;
+    out.print(END_DELIM);
 }
 
 String DashioDevice::getSelectorMessage(const String& controlID, int index, const String& selectionStr) {
-    String message = getControlBaseMessage(SELECTOR_ID, controlID);
-    message += String(index);
-    message += selectionStr;
-    message += String(END_DELIM);
+    String message((char *)0);
+    message.reserve(deviceID.length() + controlID.length() + selectionStr.length() + MESSAGE_RESERVE_LEN);
+    DashStringPrint out(message);
+    writeSelectorMessage(out, controlID, index, selectionStr);
     return message;
 }
 
+void DashioDevice::writeSelectorMessage(Print& out, const String& controlID, int index, const String& selectionStr) {
+    writeControlBaseMessage(out, SELECTOR_ID, controlID);
+    out.print(index);
+    out.print(selectionStr);
+    out.print(END_DELIM);
+}
+
 String DashioDevice::getSliderMessage(const String& controlID, int value) {
-    String message = getControlBaseMessage(SLIDER_ID, controlID);
-    message += formatInt(value);
-    message += String(END_DELIM);
+    String message((char *)0);
+    message.reserve(deviceID.length() + controlID.length() + MESSAGE_RESERVE_LEN);
+    DashStringPrint out(message);
+    writeSliderMessage(out, controlID, value);
     return message;
 }
 
+void DashioDevice::writeSliderMessage(Print& out, const String& controlID, int value) {
+    writeIntMessage(out, SLIDER_ID, controlID, value);
+}
+
 String DashioDevice::getSliderMessage(const String& controlID, float value) {
-    String message = getControlBaseMessage(SLIDER_ID, controlID);
-    message += formatFloat(value);
-    message += String(END_DELIM);
+    String message((char *)0);
+    message.reserve(deviceID.length() + controlID.length() + MESSAGE_RESERVE_LEN);
+    DashStringPrint out(message);
+    writeSliderMessage(out, controlID, value);
     return message;
 }
 
+void DashioDevice::writeSliderMessage(Print& out, const String& controlID, float value) {
+    writeFloatMessage(out, SLIDER_ID, controlID, value);
+}
+
 String DashioDevice::getSliderMessage(const String& controlID) {
-    String message = getControlBaseMessage(SLIDER_ID, controlID);
-    message += NOT_AVAILABLE;
-    message += String(END_DELIM);
+    String message((char *)0);
+    message.reserve(deviceID.length() + controlID.length() + MESSAGE_RESERVE_LEN);
+    DashStringPrint out(message);
+    writeSliderMessage(out, controlID);
     return message;
 }
 
+void DashioDevice::writeSliderMessage(Print& out, const String& controlID) {
+    writeNotAvailableMessage(out, SLIDER_ID, controlID);
+}
+
 String DashioDevice::getSingleBarMessage(const String& controlID, int value) {
-    String message = getControlBaseMessage(BAR_ID, controlID);
-    message += formatInt(value);
-    message += String(END_DELIM);
+    String message((char *)0);
+    message.reserve(deviceID.length() + controlID.length() + MESSAGE_RESERVE_LEN);
+    DashStringPrint out(message);
+    writeSingleBarMessage(out, controlID, value);
     return message;
 }
 
+void DashioDevice::writeSingleBarMessage(Print& out, const String& controlID, int value) {
+    writeIntMessage(out, BAR_ID, controlID, value);
+}
+
 String DashioDevice::getSingleBarMessage(const String& controlID, float value) {
-    String message = getControlBaseMessage(BAR_ID, controlID);
-    message += formatFloat(value);
-    message += String(END_DELIM);
+    String message((char *)0);
+    message.reserve(deviceID.length() + controlID.length() + MESSAGE_RESERVE_LEN);
+    DashStringPrint out(message);
+    writeSingleBarMessage(out, controlID, value);
     return message;
 }
 
+void DashioDevice::writeSingleBarMessage(Print& out, const String& controlID, float value) {
+    writeFloatMessage(out, BAR_ID, controlID, value);
+}
+
 String DashioDevice::getSingleBarMessage(const String& controlID) {
-    String message = getControlBaseMessage(BAR_ID, controlID);
-    message += NOT_AVAILABLE;
-    message += String(END_DELIM);
+    String message((char *)0);
+    message.reserve(deviceID.length() + controlID.length() + MESSAGE_RESERVE_LEN);
+    DashStringPrint out(message);
+    writeSingleBarMessage(out, controlID);
     return message;
 }
 
+void DashioDevice::writeSingleBarMessage(Print& out, const String& controlID) {
+    writeNotAvailableMessage(out, BAR_ID, controlID);
+}
+
 String DashioDevice::getDoubleBarMessage(const String& controlID, int value1, int value2) {
-    String message = getControlBaseMessage(BAR_ID, controlID);
+    String message((char *)0);
+    message.reserve(deviceID.length() + controlID.length() + MESSAGE_RESERVE_LEN);
+    DashStringPrint out(message);
+    writeDoubleBarMessage(out, controlID, value1, value2);
+    return message;
+}
+
+void DashioDevice::writeDoubleBarMessage(Print& out, const String& controlID, int value1, int value2) {
+    writeControlBaseMessage(out, BAR_ID, controlID);
     int barValues[2];
     barValues[0] = value1;
     barValues[1] = value2;
-    addIntArray(message, barValues, 2);
-    return message;
+    writeIntArray(out, barValues, 2);
 }
 
 String DashioDevice::getDoubleBarMessage(const String& controlID, float value1, float value2) {
-    String message = getControlBaseMessage(BAR_ID, controlID);
+    String message((char *)0);
+    message.reserve(deviceID.length() + controlID.length() + MESSAGE_RESERVE_LEN);
+    DashStringPrint out(message);
+    writeDoubleBarMessage(out, controlID, value1, value2);
+    return message;
+}
+
+void DashioDevice::writeDoubleBarMessage(Print& out, const String& controlID, float value1, float value2) {
+    writeControlBaseMessage(out, BAR_ID, controlID);
     float barValues[2];
     barValues[0] = value1;
     barValues[1] = value2;
-    addFloatArray(message, barValues, 2);
-    return message;
+    writeFloatArray(out, barValues, 2);
 }
 
 String DashioDevice::getDoubleBarMessage(const String& controlID) {
-    String message = getControlBaseMessage(BAR_ID, controlID);
-    message += NOT_AVAILABLE;
-    message += String(DELIM);
-    message += NOT_AVAILABLE;
-    message += String(END_DELIM);
+    String message((char *)0);
+    message.reserve(deviceID.length() + controlID.length() + MESSAGE_RESERVE_LEN);
+    DashStringPrint out(message);
+    writeDoubleBarMessage(out, controlID);
     return message;
 }
 
+void DashioDevice::writeDoubleBarMessage(Print& out, const String& controlID) {
+    writeControlBaseMessage(out, BAR_ID, controlID);
+    out.print(NOT_AVAILABLE);
+    out.print(DELIM);
+    out.print(NOT_AVAILABLE);
+    out.print(END_DELIM);
+}
+
 String DashioDevice::getKnobMessage(const String& controlID, int value) {
-    String message = getControlBaseMessage(KNOB_ID, controlID);
-    message += formatInt(value);
-    message += String(END_DELIM);
+    String message((char *)0);
+    message.reserve(deviceID.length() + controlID.length() + MESSAGE_RESERVE_LEN);
+    DashStringPrint out(message);
+    writeKnobMessage(out, controlID, value);
     return message;
 }
 
+void DashioDevice::writeKnobMessage(Print& out, const String& controlID, int value) {
+    writeIntMessage(out, KNOB_ID, controlID, value);
+}
+
 String DashioDevice::getKnobMessage(const String& controlID, float value) {
-    String message = getControlBaseMessage(KNOB_ID, controlID);
-    message += formatFloat(value);
-    message += String(END_DELIM);
+    String message((char *)0);
+    message.reserve(deviceID.length() + controlID.length() + MESSAGE_RESERVE_LEN);
+    DashStringPrint out(message);
+    writeKnobMessage(out, controlID, value);
     return message;
 }
 
+void DashioDevice::writeKnobMessage(Print& out, const String& controlID, float value) {
+    writeFloatMessage(out, KNOB_ID, controlID, value);
+}
+
 String DashioDevice::getKnobMessage(const String& controlID) {
-    String message = getControlBaseMessage(KNOB_ID, controlID);
-    message += NOT_AVAILABLE;
-    message += String(END_DELIM);
+    String message((char *)0);
+    message.reserve(deviceID.length() + controlID.length() + MESSAGE_RESERVE_LEN);
+    DashStringPrint out(message);
+    writeKnobMessage(out, controlID);
     return message;
 }
 
+void DashioDevice::writeKnobMessage(Print& out, const String& controlID) {
+    writeNotAvailableMessage(out, KNOB_ID, controlID);
+}
+
 String DashioDevice::getKnobDialMessage(const String& controlID, int value) {
-    String message = getControlBaseMessage(KNOB_DIAL_ID, controlID);
-    message += formatInt(value);
-    message += String(END_DELIM);
+    String message((char *)0);
+    message.reserve(deviceID.length() + controlID.length() + MESSAGE_RESERVE_LEN);
+    DashStringPrint out(message);
+    writeKnobDialMessage(out, controlID, value);
     return message;
 }
 
+void DashioDevice::writeKnobDialMessage(Print& out, const String& controlID, int value) {
+    writeIntMessage(out, KNOB_DIAL_ID, controlID, value);
+}
+
 String DashioDevice::getKnobDialMessage(const String& controlID, float value) {
-    String message = getControlBaseMessage(KNOB_DIAL_ID, controlID);
-    message += formatFloat(value);
-    message += String(END_DELIM);
+    String message((char *)0);
+    message.reserve(deviceID.length() + controlID.length() + MESSAGE_RESERVE_LEN);
+    DashStringPrint out(message);
+    writeKnobDialMessage(out, controlID, value);
     return message;
 }
 
+void DashioDevice::writeKnobDialMessage(Print& out, const String& controlID, float value) {
+    writeFloatMessage(out, KNOB_DIAL_ID, controlID, value);
+}
+
 String DashioDevice::getKnobDialMessage(const String& controlID) {
-    String message = getControlBaseMessage(KNOB_DIAL_ID, controlID);
-    message += NOT_AVAILABLE;
-    message += String(END_DELIM);
+    String message((char *)0);
+    message.reserve(deviceID.length() + controlID.length() + MESSAGE_RESERVE_LEN);
+    DashStringPrint out(message);
+    writeKnobDialMessage(out, controlID);
     return message;
 }
 
+void DashioDevice::writeKnobDialMessage(Print& out, const String& controlID) {
+    writeNotAvailableMessage(out, KNOB_DIAL_ID, controlID);
+}
+
 String DashioDevice::getDialMessage(const String& controlID, int value) {
-    String message = getControlBaseMessage(DIAL_ID, controlID);
-    message += formatInt(value);
-    message += String(END_DELIM);
+    String message((char *)0);
+    message.reserve(deviceID.length() + controlID.length() + MESSAGE_RESERVE_LEN);
+    DashStringPrint out(message);
+    writeDialMessage(out, controlID, value);
     return message;
 }
 
+void DashioDevice::writeDialMessage(Print& out, const String& controlID, int value) {
+    writeIntMessage(out, DIAL_ID, controlID, value);
+}
+
 String DashioDevice::getDialMessage(const String& controlID, float value) {
-    String message = getControlBaseMessage(DIAL_ID, controlID);
-    message += formatFloat(value);
-    message += String(END_DELIM);
+    String message((char *)0);
+    message.reserve(deviceID.length() + controlID.length() + MESSAGE_RESERVE_LEN);
+    DashStringPrint out(message);
+    writeDialMessage(out, controlID, value);
     return message;
 }
 
+void DashioDevice::writeDialMessage(Print& out, const String& controlID, float value) {
+    writeFloatMessage(out, DIAL_ID, controlID, value);
+}
+
 String DashioDevice::getDialMessage(const String& controlID) {
-    String message = getControlBaseMessage(DIAL_ID, controlID);
-    message += NOT_AVAILABLE;
-    message += String(END_DELIM);
+    String message((char *)0);
+    message.reserve(deviceID.length() + controlID.length() + MESSAGE_RESERVE_LEN);
+    DashStringPrint out(message);
+    writeDialMessage(out, controlID);
     return message;
 }
 
+void DashioDevice::writeDialMessage(Print& out, const String& controlID) {
+    writeNotAvailableMessage(out, DIAL_ID, controlID);
+}
+
 String DashioDevice::getDirectionMessage(const String& controlID, int direction, float speed) {
-    String message = getControlBaseMessage(DIRECTION_ID, controlID);
-    message += formatInt(direction);
+    String message((char *)0);
+    message.reserve(deviceID.length() + controlID.length() + MESSAGE_RESERVE_LEN);
+    DashStringPrint out(message);
+    writeDirectionMessage(out, controlID, direction, speed);
+    return message;
+}
+
+void DashioDevice::writeDirectionMessage(Print& out, const String& controlID, int direction, float speed) {
+    writeControlBaseMessage(out, DIRECTION_ID, controlID);
+    writeInt(out, direction);
     if (speed >= 0) {
-        message += String(DELIM);
-        message += formatFloat(speed);
+        out.print(DELIM);
+        writeFloat(out, speed);
     }
-    message += String(END_DELIM);
-    return message;
+    out.print(END_DELIM);
 }
 
 String DashioDevice::getDirectionMessage(const String& controlID, float direction, float speed) {
-    String message = getControlBaseMessage(DIRECTION_ID, controlID);
-    message += formatFloat(direction);
+    String message((char *)0);
+    message.reserve(deviceID.length() + controlID.length() + MESSAGE_RESERVE_LEN);
+    DashStringPrint out(message);
+    writeDirectionMessage(out, controlID, direction, speed);
+    return message;
+}
+
+void DashioDevice::writeDirectionMessage(Print& out, const String& controlID, float direction, float speed) {
+    writeControlBaseMessage(out, DIRECTION_ID, controlID);
+    writeFloat(out, direction);
     if (speed >= 0) {
-        message += String(DELIM);
-        message += formatFloat(speed);
+        out.print(DELIM);
+        writeFloat(out, speed);
     }
-    message += String(END_DELIM);
-    return message;
+    out.print(END_DELIM);
 }
 
 String DashioDevice::getDirectionMessage(const String& controlID) {
-    String message = getControlBaseMessage(DIRECTION_ID, controlID);
-    message += NOT_AVAILABLE;
-    message += String(END_DELIM);
+    String message((char *)0);
+    message.reserve(deviceID.length() + controlID.length() + MESSAGE_RESERVE_LEN);
+    DashStringPrint out(message);
+    writeDirectionMessage(out, controlID);
     return message;
 }
 
+void DashioDevice::writeDirectionMessage(Print& out, const String& controlID) {
+    writeNotAvailableMessage(out, DIRECTION_ID, controlID);
+}
+
 String DashioDevice::getMapWaypointMessage(const String& controlID, const String& trackID, const String& latitude, const String& longitude) {
-    String message = getControlBaseMessage(MAP_ID, controlID);
-    message += trackID;
-    message += String(DELIM);
-    message += latitude;
-    message += ",";
-    message += longitude;
-    message += String(END_DELIM);
+    String message((char *)0);
+    message.reserve(deviceID.length() + controlID.length() + trackID.length() + latitude.length() + longitude.length() + MESSAGE_RESERVE_LEN);
+    DashStringPrint out(message);
+    writeMapWaypointMessage(out, controlID, trackID, latitude, longitude);
     return message;
 }
 
+void DashioDevice::writeMapWaypointMessage(Print& out, const String& controlID, const String& trackID, const String& latitude, const String& longitude) {
+    writeControlBaseMessage(out, MAP_ID, controlID);
+    out.print(trackID);
+    out.print(DELIM);
+    out.print(latitude);
+    out.print(',');
+    out.print(longitude);
+    out.print(END_DELIM);
+}
+
 String DashioDevice::getMapWaypointMessage(const String& controlID, const String& trackID, float latitude, float longitude) {
+    String message((char *)0);
+    message.reserve(deviceID.length() + controlID.length() + trackID.length() + MESSAGE_RESERVE_LEN);
+    DashStringPrint out(message);
+    writeMapWaypointMessage(out, controlID, trackID, latitude, longitude);
+    return message;
+}
+
+void DashioDevice::writeMapWaypointMessage(Print& out, const String& controlID, const String& trackID, float latitude, float longitude) {
     char latLonBuffer[16];
-    String message = getControlBaseMessage(MAP_ID, controlID);
-    message += trackID;
-    message += String(DELIM);
+    writeControlBaseMessage(out, MAP_ID, controlID);
+    out.print(trackID);
+    out.print(DELIM);
     sprintf(latLonBuffer, "%f", latitude);
-    message += latLonBuffer;
-    message += ",";
+    out.print(latLonBuffer);
+    out.print(',');
     sprintf(latLonBuffer, "%f", longitude);
-    message += latLonBuffer;
-    message += String(END_DELIM);
-    return message;
+    out.print(latLonBuffer);
+    out.print(END_DELIM);
 }
 
 String DashioDevice::getMapTrackMessage(const String& controlID, const String& trackID, const String& text, const String& colour, Waypoint waypoints[], int numWaypoints) {
-    String message = getControlBaseMessage(MAP_ID, controlID);
-    message += dashboardID;
-    message += String(DELIM);
-    message += trackID;
-    message += String(DELIM);
-    message += text;
-    message += String(DELIM);
-    message += colour;
-    
+    String message((char *)0);
+    DashLengthPrint length; // Any number of items, so measured first
+    writeMapTrackMessage(length, controlID, trackID, text, colour, waypoints, numWaypoints);
+    message.reserve(length.length);
+    DashStringPrint out(message);
+    writeMapTrackMessage(out, controlID, trackID, text, colour, waypoints, numWaypoints);
+    return message;
+}
+
+void DashioDevice::writeMapTrackMessage(Print& out, const String& controlID, const String& trackID, const String& text, const String& colour, Waypoint waypoints[], int numWaypoints) {
+    writeMapTrackBaseMessage(out, controlID, trackID, text, colour);
     for (int i = 0; i < numWaypoints; i++) {
-        message += String(DELIM);
-        addWaypointJSON(message, waypoints[i]);
+        out.print(DELIM);
+        writeWaypointJSON(out, waypoints[i]);
     }
-    
-    message += String(END_DELIM);
-    return message;
+
+    out.print(END_DELIM);
+}
+
+void DashioDevice::writeMapTrackBaseMessage(Print& out, const String& controlID, const String& trackID, const String& text, const String& colour) {
+    writeControlBaseMessage(out, MAP_ID, controlID);
+    out.print(dashboardID);
+    out.print(DELIM);
+    out.print(trackID);
+    out.print(DELIM);
+    out.print(text);
+    out.print(DELIM);
+    out.print(colour);
+}
+
+uint16_t DashioDevice::addMapTrackSeries(String& message, DashGPSTrack& track, uint16_t offset, unsigned int maxLength) {
+    DashStringPrint out(message);
+    return writeMapTrackSeries(out, track, offset, maxLength);
+}
+
+// Writes one map track message holding as many points, starting from offset (0 is the oldest), as fit in
+// maxLength bytes. Returns the number of points written, which is 0 once all points have been sent.
+uint16_t DashioDevice::writeMapTrackSeries(Print& out, DashGPSTrack& track, uint16_t offset, unsigned int maxLength) {
+    if (offset >= track.count()) {
+        return 0;
+    }
+
+    DashLengthPrint header;
+    writeMapTrackBaseMessage(header, track.controlID, track.trackID, track.text, track.color);
+    unsigned int length = header.length + 1; // + END_DELIM
+
+    writeMapTrackBaseMessage(out, track.controlID, track.trackID, track.text, track.color);
+    DashTimeStamp timeStamp;
+    char pointBuffer[128];
+    DashBufferPrint pointOut(pointBuffer, sizeof(pointBuffer));
+    uint16_t numPoints = 0;
+    while (offset + numPoints < track.count()) {
+        pointOut.clear();
+        writeTrackPointJSON(pointOut, track.getPoint(offset + numPoints), timeStamp);
+        unsigned int pointLength = pointOut.length() + 1; // + DELIM
+        if ((numPoints > 0) && (length + pointLength > maxLength)) { // Always send at least one point
+            break;
+        }
+        out.print(DELIM);
+        out.write((const uint8_t *)pointOut.c_str(), pointOut.length());
+        length += pointLength;
+        numPoints++;
+    }
+    out.print(END_DELIM);
+    return numPoints;
 }
 
 String DashioDevice::getColorMessage(const String& controlID, const String& color) {
-    String message = getControlBaseMessage(COLOR_ID, controlID);
-    message += color;
-    message += String(END_DELIM);
+    String message((char *)0);
+    message.reserve(deviceID.length() + controlID.length() + color.length() + MESSAGE_RESERVE_LEN);
+    DashStringPrint out(message);
+    writeColorMessage(out, controlID, color);
     return message;
 }
 
+void DashioDevice::writeColorMessage(Print& out, const String& controlID, const String& color) {
+    writeControlBaseMessage(out, COLOR_ID, controlID);
+    out.print(color);
+    out.print(END_DELIM);
+}
+
 String DashioDevice::getAudioVisualMessage(const String& controlID, const String& url) {
-    String message = getControlBaseMessage(AV_ID, controlID);
-    message += url;
-    message += String(END_DELIM);
+    String message((char *)0);
+    message.reserve(deviceID.length() + controlID.length() + url.length() + MESSAGE_RESERVE_LEN);
+    DashStringPrint out(message);
+    writeAudioVisualMessage(out, controlID, url);
     return message;
 }
 
+void DashioDevice::writeAudioVisualMessage(Print& out, const String& controlID, const String& url) {
+    writeControlBaseMessage(out, AV_ID, controlID);
+    out.print(url);
+    out.print(END_DELIM);
+}
+
 void DashioDevice::addEventLogMessage(String& message, const String& controlID, const String& timeStr, const String& color, String text[], int numTextRows) {
-    addControlBaseMessage(message, EVENT_LOG_ID, controlID);
-    message += timeStr;
-    message += String(DELIM);
-    message += color;
+    DashStringPrint out(message);
+    writeEventLogMessage(out, controlID, timeStr, color, text, numTextRows);
+}
+
+void DashioDevice::writeEventLogMessage(Print& out, const String& controlID, const String& timeStr, const String& color, String text[], int numTextRows) {
+    writeEventLogRowsMessage(out, controlID, timeStr.c_str(), color, text, numTextRows);
+}
+
+void DashioDevice::writeEventLogRowsMessage(Print& out, const String& controlID, const char *timeStr, const String& color, String text[], int numTextRows) {
+    writeControlBaseMessage(out, EVENT_LOG_ID, controlID);
+    out.print(timeStr);
+    out.print(DELIM);
+    out.print(color);
     for (int i = 0; i < numTextRows; i++) {
-        message += String(DELIM);
-        message += text[i];
+        out.print(DELIM);
+        out.print(text[i]);
     }
-    message += String(END_DELIM);
+    out.print(END_DELIM);
 }
 
 void DashioDevice::addEventLogMessage(String& message, const String& controlID, const String& color, String text[], int numTextRows) {
-    return addEventLogMessage(message, controlID, "", color, text, numTextRows);
+    DashStringPrint out(message);
+    writeEventLogMessage(out, controlID, color, text, numTextRows);
+}
+
+void DashioDevice::writeEventLogMessage(Print& out, const String& controlID, const String& color, String text[], int numTextRows) {
+    writeEventLogRowsMessage(out, controlID, "", color, text, numTextRows);
 }
 
 void DashioDevice::addEventLogMessage(String& message, const String& controlID, Event events[], int numEvents) {
-    addControlBaseMessage(message, EVENT_LOG_ID, controlID);
-    message += dashboardID;
-    message += String(DELIM);
+    DashStringPrint out(message);
+    writeEventLogMessage(out, controlID, events, numEvents);
+}
+
+void DashioDevice::writeEventLogMessage(Print& out, const String& controlID, Event events[], int numEvents) {
+    writeControlBaseMessage(out, EVENT_LOG_ID, controlID);
+    out.print(dashboardID);
+    out.print(DELIM);
 
     for (int i = 0; i < numEvents; i++) {
-        addEventJSON(message, events[i]);
-        if (i < numEvents - 1) { // because getControlBaseMessage ends in a DELIM
-            message += String(DELIM);
+        writeEventJSON(out, events[i]);
+        if (i < numEvents - 1) { // because writeControlBaseMessage ends in a DELIM
+            out.print(DELIM);
         }
     }
-    message += String(END_DELIM);
+    out.print(END_DELIM);
 }
 
 String DashioDevice::getC64ConfigBaseMessage() {
-    String message = String(DELIM);
-    message += deviceID;
-    message += String(DELIM);
-    message += CONFIG_ID;
-    message += String(DELIM);
-    message += dashboardID;
-    message += String(DELIM);
-    message += CONFIG_C64;
-    message += String(DELIM);
+    String message((char *)0);
+    message.reserve(deviceID.length() + dashboardID.length() + MESSAGE_RESERVE_LEN);
+    DashStringPrint out(message);
+    writeC64ConfigBaseMessage(out);
     return message;
 }
 
+void DashioDevice::writeC64ConfigBaseMessage(Print& out) {
+    out.print(DELIM);
+    out.print(deviceID);
+    out.print(DELIM);
+    out.print(CONFIG_ID);
+    out.print(DELIM);
+    out.print(dashboardID);
+    out.print(DELIM);
+    out.print(CONFIG_C64);
+    out.print(DELIM);
+}
+
 String DashioDevice::getC64ConfigMessage() {
     String message = getC64ConfigBaseMessage();
     message += configC64Str;
@@ -1010,181 +1862,289 @@ String DashioDevice::getC64ConfigMessage() {
     return message;
 }
 
+// Shared by all connections, so a chunk must be sent before the next one is requested
+static char configChunkBuffer[MAX_CONFIG_CHUNK_LEN + 1];
+
+int DashioDevice::getC64ConfigChunk(const char **chunk, unsigned int offset, unsigned int maxChunkLength) {
+    // The config is streamed as the C64 string followed by END_DELIM, one block at a time, straight from PROGMEM.
+    // Call with offset = 0 for the first block and advance offset by the returned length until 0 is returned.
+    *chunk = configChunkBuffer;
+    if (configC64Str == nullptr) {
+        return 0;
+    }
+    if (offset == 0) {
+        configC64Length = strlen_P(configC64Str);
+    }
+    if (offset > configC64Length) {
+        return 0;
+    }
+
+    if ((maxChunkLength == 0) || (maxChunkLength > MAX_CONFIG_CHUNK_LEN)) {
+        maxChunkLength = MAX_CONFIG_CHUNK_LEN;
+    }
+
+    unsigned int length = configC64Length - offset;
+    if (length >= maxChunkLength) {
+        length = maxChunkLength;
+        memcpy_P(configChunkBuffer, configC64Str + offset, length);
+    } else {
+        memcpy_P(configChunkBuffer, configC64Str + offset, length);
+        configChunkBuffer[length++] = END_DELIM;
+    }
+    configChunkBuffer[length] = '\0'; // So the chunk can also be used as a C string
+    return length;
+}
+
 void DashioDevice::addChartLineInts(String& message, const String& controlID, const String& lineID, const String& lineName, LineType lineType, const String& color, YAxisSelect yAxisSelect, int lineData[], int dataLength) {
-    addControlBaseMessage(message, CHART_ID, controlID);
-    message += lineID;
-    message += String(DELIM);
-    message += lineName;
-    message += String(DELIM);
-    addLineTypeStr(message, lineType);
-    message += String(DELIM);
-    message += color;
-    message += String(DELIM);
-    addYaxisSelectStr(message, yAxisSelect);
+    DashStringPrint out(message);
+    writeChartLineInts(out, controlID, lineID, lineName, lineType, color, yAxisSelect, lineData, dataLength);
+}
+
+void DashioDevice::writeChartLineInts(Print& out, const String& controlID, const String& lineID, const String& lineName, LineType lineType, const String& color, YAxisSelect yAxisSelect, int lineData[], int dataLength) {
+    writeChartLineBaseMessage(out, controlID, lineID, lineName, lineType, color, yAxisSelect);
     for (int i = 0; i < dataLength; i++) {
-        message += String(DELIM);
-        message += formatInt(lineData[i]);
+        out.print(DELIM);
+        writeInt(out, lineData[i]);
     }
-    message += String(END_DELIM);
+    out.print(END_DELIM);
 }
 
 void DashioDevice::addChartLineFloats(String& message, const String& controlID, const String& lineID, const String& lineName, LineType lineType, const String& color, YAxisSelect yAxisSelect, float lineData[], int dataLength) {
-    addControlBaseMessage(message, CHART_ID, controlID);
-    message += lineID;
-    message += String(DELIM);
-    message += lineName;
-    message += String(DELIM);
-    addLineTypeStr(message, lineType);
-    message += String(DELIM);
-    message += color;
-    message += String(DELIM);
-    addYaxisSelectStr(message, yAxisSelect);
-    for (int i = 0; i < dataLength; i++) {
-        message += String(DELIM);
-        message += formatFloat(lineData[i]);
-    }
-    message += String(END_DELIM);
+    DashStringPrint out(message);
+    writeChartLineFloats(out, controlID, lineID, lineName, lineType, color, yAxisSelect, lineData, dataLength);
 }
 
-void DashioDevice::addTimeGraphLineBaseMessage(String& message, const String& _dashboardID, const String& controlID, const String& lineID, const String& lineName, LineType lineType, const String& color, YAxisSelect yAxisSelect) {
-    addControlBaseMessage(message, TIME_GRAPH_ID, controlID);
-    message += _dashboardID;
-    message += String(DELIM);
-    message += lineID;
-    message += String(DELIM);
-    message += lineName;
-    message += String(DELIM);
-    addLineTypeStr(message, lineType);
-    message += String(DELIM);
-    message += color;
-    message += String(DELIM);
-    addYaxisSelectStr(message, yAxisSelect);
+void DashioDevice::writeChartLineFloats(Print& out, const String& controlID, const String& lineID, const String& lineName, LineType lineType, const String& color, YAxisSelect yAxisSelect, float lineData[], int dataLength) {
+    writeChartLineBaseMessage(out, controlID, lineID, lineName, lineType, color, yAxisSelect);
+    for (int i = 0; i < dataLength; i++) {
+        out.print(DELIM);
+        writeFloat(out, lineData[i]);
+    }
+    out.print(END_DELIM);
+}
+
+void DashioDevice::writeChartLineBaseMessage(Print& out, const String& controlID, const String& lineID, const String& lineName, LineType lineType, const String& color, YAxisSelect yAxisSelect) {
+    writeControlBaseMessage(out, CHART_ID, controlID);
+    out.print(lineID);
+    out.print(DELIM);
+    out.print(lineName);
+    out.print(DELIM);
+    writeLineTypeStr(out, lineType);
+    out.print(DELIM);
+    out.print(color);
+    out.print(DELIM);
+    writeYaxisSelectStr(out, yAxisSelect);
+}
+
+void DashioDevice::writeTimeGraphLineBaseMessage(Print& out, const char *_dashboardID, const String& controlID, const String& lineID, const String& lineName, LineType lineType, const String& color, YAxisSelect yAxisSelect) {
+    writeControlBaseMessage(out, TIME_GRAPH_ID, controlID);
+    out.print(_dashboardID);
+    out.print(DELIM);
+    out.print(lineID);
+    out.print(DELIM);
+    out.print(lineName);
+    out.print(DELIM);
+    writeLineTypeStr(out, lineType);
+    out.print(DELIM);
+    out.print(color);
+    out.print(DELIM);
+    writeYaxisSelectStr(out, yAxisSelect);
 }
 
 String DashioDevice::getTimeGraphLine(const String& controlID, const String& lineID, const String& lineName, LineType lineType, const String& color, YAxisSelect yAxisSelect) {
-    String message = "";
-    addTimeGraphLineBaseMessage(message, "BRDCST", controlID, lineID, lineName, lineType, color, yAxisSelect);
-    message += String(END_DELIM);
+    String message((char *)0);
+    message.reserve(deviceID.length() + controlID.length() + lineID.length() + lineName.length() + color.length() + MESSAGE_RESERVE_LEN);
+    DashStringPrint out(message);
+    writeTimeGraphLine(out, controlID, lineID, lineName, lineType, color, yAxisSelect);
     return message;
 }
 
+void DashioDevice::writeTimeGraphLine(Print& out, const String& controlID, const String& lineID, const String& lineName, LineType lineType, const String& color, YAxisSelect yAxisSelect) {
+    writeTimeGraphLineBaseMessage(out, "BRDCST", controlID, lineID, lineName, lineType, color, yAxisSelect);
+    out.print(END_DELIM);
+}
+
 void DashioDevice::addTimeGraphLineFloats(String& message, const String& controlID, const String& lineID, const String& lineName, LineType lineType, const String& color, YAxisSelect yAxisSelect, String times[], float lineData[], int dataLength) {
-    addTimeGraphLineBaseMessage(message, dashboardID, controlID, lineID, lineName, lineType, color, yAxisSelect);
+    DashStringPrint out(message);
+    writeTimeGraphLineFloats(out, controlID, lineID, lineName, lineType, color, yAxisSelect, times, lineData, dataLength);
+}
+
+void DashioDevice::writeTimeGraphLineFloats(Print& out, const String& controlID, const String& lineID, const String& lineName, LineType lineType, const String& color, YAxisSelect yAxisSelect, String times[], float lineData[], int dataLength) {
+    writeTimeGraphLineBaseMessage(out, dashboardID.c_str(), controlID, lineID, lineName, lineType, color, yAxisSelect);
     for (int i = 0; i < dataLength; i++) {
-        message += String(DELIM);
-        message += times[i];
-        message += ",";
-        message += formatFloat(lineData[i]);
+        out.print(DELIM);
+        out.print(times[i]);
+        out.print(',');
+        writeFloat(out, lineData[i]);
     }
-    message += String(END_DELIM);
+    out.print(END_DELIM);
 }
 
 void DashioDevice::addTimeGraphLineFloats(String& message, const String& controlID, const String& lineID, const String& lineName, LineType lineType, const String& color, YAxisSelect yAxisSelect, time_t times[], float lineData[], int dataLength, bool breakLine) {
-    addTimeGraphLineBaseMessage(message, dashboardID, controlID, lineID, lineName, lineType, color, yAxisSelect);
-    char timeBuf[21];
+    DashStringPrint out(message);
+    writeTimeGraphLineFloats(out, controlID, lineID, lineName, lineType, color, yAxisSelect, times, lineData, dataLength, breakLine);
+}
+
+void DashioDevice::writeTimeGraphLineFloats(Print& out, const String& controlID, const String& lineID, const String& lineName, LineType lineType, const String& color, YAxisSelect yAxisSelect, time_t times[], float lineData[], int dataLength, bool breakLine) {
+    writeTimeGraphLineBaseMessage(out, dashboardID.c_str(), controlID, lineID, lineName, lineType, color, yAxisSelect);
+    DashTimeStamp timeStamp;
     if (breakLine && (dataLength > 0)) {
-        message += String(DELIM);
-        time_t breakTime = times[0] - 1; // - 1 second for break point time
-        strftime(timeBuf, 21, "%Y-%m-%dT%H:%M:%SZ", localtime(&breakTime));
-        message += String(timeBuf);
-        message += ",";
-        message += "B";
+        out.print(DELIM);
+        out.print(timeStamp.encode(times[0] - 1)); // - 1 second for break point time
+        out.print(',');
+        out.print('B');
     }
     for (int i = 0; i < dataLength; i++) {
-        message += String(DELIM);
-        strftime(timeBuf, 21, "%Y-%m-%dT%H:%M:%SZ", localtime(&times[i]));
-        message += String(timeBuf);
-        message += ",";
-        message += formatFloat(lineData[i]);
+        out.print(DELIM);
+        out.print(timeStamp.encode(times[i]));
+        out.print(',');
+        writeFloat(out, lineData[i]);
     }
-    message += String(END_DELIM);
+    out.print(END_DELIM);
 }
 
 void DashioDevice::addTimeGraphLineFloatsArr(String& message, const String& controlID, const String& lineID, const String& lineName, LineType lineType, const String& color, YAxisSelect yAxisSelect, time_t times[], float **lineData, int dataLength, int arrSize) {
-    addTimeGraphLineBaseMessage(message, dashboardID, controlID, lineID, lineName, lineType, color, yAxisSelect);
-    char timeBuf[21];
+    DashStringPrint out(message);
+    writeTimeGraphLineFloatsArr(out, controlID, lineID, lineName, lineType, color, yAxisSelect, times, lineData, dataLength, arrSize);
+}
+
+void DashioDevice::writeTimeGraphLineFloatsArr(Print& out, const String& controlID, const String& lineID, const String& lineName, LineType lineType, const String& color, YAxisSelect yAxisSelect, time_t times[], float **lineData, int dataLength, int arrSize) {
+    writeTimeGraphLineBaseMessage(out, dashboardID.c_str(), controlID, lineID, lineName, lineType, color, yAxisSelect);
+    DashTimeStamp timeStamp;
     for (int i = 0; i < dataLength; i++) {
-        message += String(DELIM);
-        strftime(timeBuf, 21, "%Y-%m-%dT%H:%M:%SZ", localtime(&times[i]));
-        message += String(timeBuf);
-        message += ",";
-        message += "[";
+        out.print(DELIM);
+        out.print(timeStamp.encode(times[i]));
+        out.print(',');
+        out.print('[');
         for (int j = 0; j < arrSize; j++) {
             if (j > 0) {
-                message += ",";
+                out.print(',');
             }
-            message += formatFloat(lineData[i][j]);
+            writeFloat(out, lineData[i][j]);
         }
-        message += "]";
+        out.print(']');
     }
-    message += String(END_DELIM);
+    out.print(END_DELIM);
 }
 
 void DashioDevice::addTimeGraphLineBools(String& message, const String& controlID, const String& lineID, const String& lineName, LineType lineType, const String& color, String times[], bool lineData[], int dataLength) {
-    addTimeGraphLineBaseMessage(message, dashboardID, controlID, lineID, lineName, lineType, color, yLeft);
+    DashStringPrint out(message);
+    writeTimeGraphLineBools(out, controlID, lineID, lineName, lineType, color, times, lineData, dataLength);
+}
+
+void DashioDevice::writeTimeGraphLineBools(Print& out, const String& controlID, const String& lineID, const String& lineName, LineType lineType, const String& color, String times[], bool lineData[], int dataLength) {
+    writeTimeGraphLineBaseMessage(out, dashboardID.c_str(), controlID, lineID, lineName, lineType, color, yLeft);
     for (int i = 0; i < dataLength; i++) {
-        message += String(DELIM);
-        message += times[i];
-        message += ",";
+        out.print(DELIM);
+        out.print(times[i]);
+        out.print(',');
         if (lineData[i]) {
-            message += "T";
+            out.print('T');
         } else {
-            message += "F";
+            out.print('F');
         }
     }
-    message += String(END_DELIM);
+    out.print(END_DELIM);
 }
 
-String DashioDevice::getTimeGraphPoint(const String& controlID, const String& lineID, float value) {
-    String message = getControlBaseMessage(TIME_GRAPH_ID, controlID);
-    message += lineID;
-    message += String(DELIM);
-    message += formatFloat(value);
-    message += String(END_DELIM);
-    return message;
+uint16_t DashioDevice::addTimeGraphLineSeries(String& message, DashTimeSeries& series, uint16_t offset, unsigned int maxLength) {
+    DashStringPrint out(message);
+    return writeTimeGraphLineSeries(out, series, offset, maxLength);
 }
 
-String DashioDevice::getTimeGraphPoint(const String& controlID, const String& lineID, String time, float value) {
-    String message = getControlBaseMessage(TIME_GRAPH_ID, controlID);
-    message += lineID;
-    message += String(DELIM);
-    message += time;
-    message += ",";
-    message += formatFloat(value);
-    message += String(END_DELIM);
-    return message;
-}
+// Writes one time graph line message holding as many samples, starting from offset (0 is the oldest), as fit
+// in maxLength bytes. Returns the number of samples written, which is 0 once all samples have been sent.
+uint16_t DashioDevice::writeTimeGraphLineSeries(Print& out, DashTimeSeries& series, uint16_t offset, unsigned int maxLength) {
+    if (offset >= series.count()) {
+        return 0;
+    }
 
-void DashioDevice::addTimeGraphPointArr(String& message, const String& controlID, const String& lineID, float value[], int arrSize) {
-    addControlBaseMessage(message, TIME_GRAPH_ID, controlID);
-    message += lineID;
-    message += String(DELIM);
-    message += "[";
-    for (int i = 0; i < arrSize; i++) {
-        if (i > 0) {
-            message += ",";
+    DashLengthPrint header;
+    writeTimeGraphLineBaseMessage(header, dashboardID.c_str(), series.controlID, series.lineID, series.lineName, series.lineType, series.color, series.yAxisSelect);
+    unsigned int length = header.length + 1; // + END_DELIM
+
+    writeTimeGraphLineBaseMessage(out, dashboardID.c_str(), series.controlID, series.lineID, series.lineName, series.lineType, series.color, series.yAxisSelect);
+    DashTimeStamp timeStamp;
+    char valueBuf[16];
+    uint16_t numSamples = 0;
+    while (offset + numSamples < series.count()) {
+        const DashTimeSample& sample = series.getSample(offset + numSamples);
+        formatFloat(valueBuf, sample.value);
+        unsigned int sampleLength = strlen(valueBuf) + 22; // DELIM, timestamp and ','
+        if ((numSamples > 0) && (length + sampleLength > maxLength)) { // Always send at least one sample
+            break;
         }
-        message += formatFloat(value[i]);
+        out.print(DELIM);
+        out.print(timeStamp.encode(sample.time));
+        out.print(',');
+        out.print(valueBuf);
+        length += sampleLength;
+        numSamples++;
     }
-    message += "]";
-    message += String(END_DELIM);
+    out.print(END_DELIM);
+    return numSamples;
+}
+
+String DashioDevice::getTimeGraphPoint(const String& controlID, const String& lineID, float value) {
+    String message((char *)0);
+    message.reserve(deviceID.length() + controlID.length() + lineID.length() + MESSAGE_RESERVE_LEN);
+    DashStringPrint out(message);
+    writeTimeGraphPoint(out, controlID, lineID, value);
+    return message;
+}
+
+void DashioDevice::writeTimeGraphPoint(Print& out, const String& controlID, const String& lineID, float value) {
+    writeControlBaseMessage(out, TIME_GRAPH_ID, controlID);
+    out.print(lineID);
+    out.print(DELIM);
+    writeFloat(out, value);
+    out.print(END_DELIM);
+}
+
+String DashioDevice::getTimeGraphPoint(const String& controlID, const String& lineID, String time, float value) {
+    String message((char *)0);
+    message.reserve(deviceID.length() + controlID.length() + lineID.length() + time.length() + MESSAGE_RESERVE_LEN);
+    DashStringPrint out(message);
+    writeTimeGraphPoint(out, controlID, lineID, time, value);
+    return message;
+}
+
+void DashioDevice::writeTimeGraphPoint(Print& out, const String& controlID, const String& lineID, const String& time, float value) {
+    writeControlBaseMessage(out, TIME_GRAPH_ID, controlID);
+    out.print(lineID);
+    out.print(DELIM);
+    out.print(time);
+    out.print(',');
+    writeFloat(out, value);
+    out.print(END_DELIM);
+}
+
+void DashioDevice::addTimeGraphPointArr(String& message, const String& controlID, const String& lineID, float value[], int arrSize) {
+    DashStringPrint out(message);
+    writeTimeGraphPointArr(out, controlID, lineID, value, arrSize);
+}
+
+void DashioDevice::writeTimeGraphPointArr(Print& out, const String& controlID, const String& lineID, float value[], int arrSize) {
+    writeControlBaseMessage(out, TIME_GRAPH_ID, controlID);
+    out.print(lineID);
+    out.print(DELIM);
+    writeFloatList(out, value, arrSize);
+    out.print(END_DELIM);
 }
 
 void DashioDevice::addTimeGraphPointArr(String& message, const String& controlID, const String& lineID, String time, float value[], int arrSize) {
-    addControlBaseMessage(message, TIME_GRAPH_ID, controlID);
-    message += lineID;
-    message += String(DELIM);
-    message += time;
-    message += ",";
-    message += "[";
-    for (int i = 0; i < arrSize; i++) {
-        if (i != 0) {
-            message += ",";
-        }
-        message += formatFloat(value[i]);
-    }
-    message += "]";
-    message += String(END_DELIM);
+    DashStringPrint out(message);
+    writeTimeGraphPointArr(out, controlID, lineID, time, value, arrSize);
+}
+
+void DashioDevice::writeTimeGraphPointArr(Print& out, const String& controlID, const String& lineID, const String& time, float value[], int arrSize) {
+    writeControlBaseMessage(out, TIME_GRAPH_ID, controlID);
+    out.print(lineID);
+    out.print(DELIM);
+    out.print(time);
+    out.print(',');
+    writeFloatList(out, value, arrSize);
+    out.print(END_DELIM);
 }
 
 String DashioDevice::getControlTypeStr(ControlType controltype) {
@@ -1238,78 +2198,11 @@ String DashioDevice::getControlTypeStr(ControlType controltype) {
 }
 
 ControlType DashioDevice::getControlType(String controltypeStr) {
-    if (controltypeStr == CONNECT_ID) {
-        return connect;
-    } else if (controltypeStr == WHO_ID) {
-        return who;
-    } else if (controltypeStr == CTRL_ID) {
-        return ctrl;
-    } else if (controltypeStr == STATUS_ID) {
-        return status;
-    } else if (controltypeStr == CLOCK_ID) {
-        return dashClock;
-    } else if (controltypeStr == CONFIG_ID) {
-        return config;   
-    } else if (controltypeStr == DEVICE_ID) {
-        return device;
-    } else if (controltypeStr == DEVICE_VIEW_ID) {
-        return deviceView;
-    } else if (controltypeStr == LABEL_ID) {
-        return label;
-    } else if (controltypeStr == BUTTON_ID) {
-        return button;
-    } else if (controltypeStr == MENU_ID) {
-        return menu;
-    } else if (controltypeStr == BUTTON_GROUP_ID) {
-        return buttonGroup;
-    } else if (controltypeStr == EVENT_LOG_ID) {
-        return eventLog;
-    } else if (controltypeStr == SLIDER_ID) {
-        return slider;
-    } else if (controltypeStr == KNOB_ID) {
-        return knob;
-    } else if (controltypeStr == DIAL_ID) {
-        return dial;
-    } else if (controltypeStr == DIRECTION_ID) {
-        return direction;
-    } else if (controltypeStr == TEXT_BOX_ID) {
-        return textBox;
-    } else if (controltypeStr == SELECTOR_ID) {
-        return selector;
-     } else if (controltypeStr == CHART_ID) {
-       return chart;
-    } else if (controltypeStr == TIME_GRAPH_ID) {
-        return timeGraph;
-    } else if (controltypeStr == MAP_ID) {
-        return mapper;
-    } else if (controltypeStr == COLOR_ID) {
-        return colorPicker;
-    } else if (controltypeStr == AV_ID) {
-        return audioVisual;
-    } else if (controltypeStr == DEVICE_NAME_ID) {
-        return deviceName;
-    } else if (controltypeStr == WIFI_SETUP_ID) {
-        return wifiSetup;
-    } else if (controltypeStr == TCP_SETUP_ID) {
-        return tcpSetup;
-    } else if (controltypeStr == DASHIO_SETUP_ID) {
-        return dashioSetup;
-    } else if (controltypeStr == MQTT_SETUP_ID) {
-        return mqttSetup;
-    } else if (controltypeStr == RESET_DEVICE_ID) {
-        return resetDevice;
-    } else if (controltypeStr == MQTT_CONNECTION_ID) {
-        return mqttConn;
-    } else if (controltypeStr == BLE_CONNECTION_ID) {
-        return bleConn;
-    } else if (controltypeStr == TCP_CONNECTION_ID) {
-        return tcpConn;
-    } else if (controltypeStr == ALARM_ID) {
-        return alarmNotify;
-    } else if (controltypeStr == INIT_MODULE_ID) {
-        return initModule;
-    }
-    return unknown;
+    return controlTypeFromID(controltypeStr.c_str());
+}
+
+ControlType DashioDevice::getControlType(const char *controltypeStr) {
+    return controlTypeFromID(controltypeStr);
 }
 
 String DashioDevice::getMQTTSubscribeTopic(const String& userName) {
@@ -1339,63 +2232,87 @@ String DashioDevice::getMQTTTopic(const String& userName, MQTTTopicType topic) {
     return userName + "/" + deviceID + "/" + tip;
 }
 
-void DashioDevice::addLineTypeStr(String& message, LineType lineType) {
+void DashioDevice::writeLineTypeStr(Print& out, LineType lineType) {
     switch (lineType) {
         case line:
-            message += LINE_ID;
+            out.print(LINE_ID);
             break;
         case bar:
-            message += BAR_GRAPH_ID;
+            out.print(BAR_GRAPH_ID);
             break;
         case segBar:
-            message += SEGMENTED_BAR_ID;
+            out.print(SEGMENTED_BAR_ID);
             break;
         case peakBar:
-            message +=  PEAK_BAR_ID;
+            out.print(PEAK_BAR_ID);
             break;
         case bln:
-            message +=  BOOL_ID;
+            out.print(BOOL_ID);
             break;
         default:
-            message +=  LINE_ID;
+            out.print(LINE_ID);
             break;
     }
 }
 
-void DashioDevice::addYaxisSelectStr(String& message, YAxisSelect yAxisSelect) {
+void DashioDevice::writeYaxisSelectStr(Print& out, YAxisSelect yAxisSelect) {
     switch (yAxisSelect) {
         case yLeft:
-            message +=  LEFT_ID;
+            out.print(LEFT_ID);
             break;
         default:
-            message +=  RIGHT_ID;
+            out.print(RIGHT_ID);
             break;
     }
 }
 
-void DashioDevice::addIntArray(String& message, int idata[], int dataLength) {
+void DashioDevice::writeInt(Print& out, int value) {
+    if (value == INVALID_INT_VALUE) {
+        out.print("nan");
+    } else {
+        out.print(value);
+    }
+}
+
+void DashioDevice::writeFloat(Print& out, float value) {
+    char buffer[16];
+    out.print(formatFloat(buffer, value));
+}
+
+void DashioDevice::writeIntArray(Print& out, int idata[], int dataLength) {
     for (int i = 0; i < dataLength; i++) {
         if (i > 0) {
-            message += String(DELIM);
+            out.print(DELIM);
         }
-        message += formatInt(idata[i]);
+        writeInt(out, idata[i]);
     }
-    message += String(END_DELIM);
+    out.print(END_DELIM);
 }
 
-void DashioDevice::addFloatArray(String& message, float fdata[], int dataLength) {
+void DashioDevice::writeFloatArray(Print& out, float fdata[], int dataLength) {
     for (int i = 0; i < dataLength; i++) {
         if (i > 0) {
-            message += String(DELIM);
+            out.print(DELIM);
         }
-        message += formatFloat(fdata[i]);
+        writeFloat(out, fdata[i]);
     }
-    message += String(END_DELIM);
+    out.print(END_DELIM);
 }
 
-void DashioDevice::addWaypointJSON(String& message, Waypoint waypoint) {
-    DashJSON json;
-    json.start();
+void DashioDevice::writeFloatList(Print& out, float fdata[], int dataLength) {
+    out.print('[');
+    for (int i = 0; i < dataLength; i++) {
+        if (i > 0) {
+            out.print(',');
+        }
+        writeFloat(out, fdata[i]);
+    }
+    out.print(']');
+}
+
+void DashioDevice::writeWaypointJSON(Print& out, const Waypoint& waypoint) {
+    DashJSONWriter json(out);
+    json.startObject();
     if (waypoint.time.length() > 0) {
         json.addKeyString(F("time"), waypoint.time);
     }
@@ -1415,15 +2332,1010 @@ void DashioDevice::addWaypointJSON(String& message, Waypoint waypoint) {
         json.addKeyString(F("distance"), waypoint.distance);
     }
     json.addKeyString(F("latitude"), waypoint.latitude);
-    json.addKeyString(F("longitude"), waypoint.longitude, true);
-    message += json.jsonStr;
+    json.addKeyString(F("longitude"), waypoint.longitude);
+    json.endObject();
 }
 
-void DashioDevice::addEventJSON(String& message, Event event) {
-    DashJSON json;
-    json.start();
+// Same keys as a Waypoint, with the coordinates at full precision
+void DashioDevice::writeTrackPointJSON(Print& out, const DashTrackPoint& point, DashTimeStamp& timeStamp) {
+    char buffer[16];
+    DashJSONWriter json(out);
+    json.startObject();
+    const char *timeStr = timeStamp.encode(point.time);
+    json.key(F("time"));
+    json.addString(timeStr, strlen(timeStr));
+    if (point.speed != GPS_NO_SPEED) {
+        json.key(F("avgeSpeed"));
+        json.addString(buffer, formatFixed(buffer, point.speed, 2));
+    }
+    if (point.course != GPS_NO_COURSE) {
+        json.key(F("course"));
+        json.addString(buffer, formatFixed(buffer, point.course, 1));
+    }
+    json.key(F("latitude"));
+    json.addString(buffer, formatFixed(buffer, point.latitude, 7));
+    json.key(F("longitude"));
+    json.addString(buffer, formatFixed(buffer, point.longitude, 7));
+    json.endObject();
+}
+
+void DashioDevice::writeEventJSON(Print& out, const Event& event) {
+    DashJSONWriter json(out);
+    json.startObject();
     json.addKeyString(F("time"), event.time);
     json.addKeyString(F("color"), event.color);
-    json.addKeyStringArray(F("lines"), event.lines, event.numLines, true);
-    message += json.jsonStr;
+    json.key(F("lines"));
+    json.startArray();
+    for (int i = 0; i < event.numLines; i++) {
+        json.addString(event.lines[i]);
+    }
+    json.endArray();
+    json.endObject();
+}
+
+/* --------------- */
+DashClientReader::DashClientReader(unsigned int _size) {
+    size = _size;
+    if (size > 0) {
+        block = new char[size];
+    }
+}
+
+DashClientReader::~DashClientReader() {
+    delete[] block;
+}
+
+/* --------------- */
+DashSendQueue::DashSendQueue(unsigned int _size) {
+    begin(_size);
+}
+
+DashSendQueue::~DashSendQueue() {
+    delete[] buffer;
+}
+
+bool DashSendQueue::begin(unsigned int _size) {
+    delete[] buffer;
+    buffer = nullptr;
+    size = 0;
+    clear();
+    if (_size > 0) {
+        buffer = new char[_size];
+        if (buffer == nullptr) {
+            return false;
+        }
+        size = _size;
+    }
+    return true;
+}
+
+bool DashSendQueue::write(const char *data, size_t length) {
+    if (length == 0) {
+        return true;
+    }
+    if (length > space()) {
+        overflowCount++;
+        return false;
+    }
+
+    size_t writePtr = (readPtr + count) % size;
+    size_t firstLength = size - writePtr;
+    if (firstLength > length) {
+        firstLength = length;
+    }
+    memcpy(buffer + writePtr, data, firstLength);
+    memcpy(buffer, data + firstLength, length - firstLength); // Wrapped part, if any
+    count += length;
+    return true;
+}
+
+// Copies up to maxLength bytes, starting offset bytes from the front of the queue, without removing them
+size_t DashSendQueue::peek(char *block, size_t maxLength, size_t offset) {
+    if (offset >= count) {
+        return 0;
+    }
+    size_t length = count - offset < maxLength ? count - offset : maxLength;
+    size_t start = (readPtr + offset) % size;
+    size_t firstLength = size - start;
+    if (firstLength > length) {
+        firstLength = length;
+    }
+    memcpy(block, buffer + start, firstLength);
+    memcpy(block + firstLength, buffer, length - firstLength);
+    return length;
+}
+
+void DashSendQueue::remove(size_t length) {
+    if (length > count) {
+        length = count;
+    }
+    if (length == 0) {
+        return;
+    }
+    readPtr = (readPtr + length) % size;
+    count -= length;
+}
+
+void DashSendQueue::clear() {
+    readPtr = 0;
+    count = 0;
+}
+
+/* --------------- */
+bool DashOfflineQueue::store(MQTTTopicType topic, const char *message, size_t length) {
+    if ((length > 0xFFFF) || (length + OFFLINE_HEADER_LEN > queue.space())) {
+        return false;
+    }
+    char header[OFFLINE_HEADER_LEN] = {(char)topic, (char)(length >> 8), (char)(length & 0xFF)};
+    queue.write(header, OFFLINE_HEADER_LEN);
+    queue.write(message, length);
+    numMessages++;
+    return true;
+}
+
+size_t DashOfflineQueue::nextLength() {
+    uint8_t header[OFFLINE_HEADER_LEN];
+    if (queue.peek((char *)header, OFFLINE_HEADER_LEN) < OFFLINE_HEADER_LEN) {
+        return 0;
+    }
+    return ((size_t)header[1] << 8) | header[2];
+}
+
+size_t DashOfflineQueue::peek(MQTTTopicType *topic, char *message, size_t maxLength) {
+    char header[OFFLINE_HEADER_LEN];
+    size_t length = nextLength();
+    if ((length == 0) || (length > maxLength)) {
+        return 0;
+    }
+    queue.peek(header, OFFLINE_HEADER_LEN);
+    *topic = (MQTTTopicType)header[0];
+    queue.peek(message, length, OFFLINE_HEADER_LEN);
+    return length;
+}
+
+void DashOfflineQueue::remove() {
+    if (numMessages > 0) {
+        queue.remove(OFFLINE_HEADER_LEN + nextLength());
+        numMessages--;
+    }
+}
+
+void DashOfflineQueue::clear() {
+    queue.clear();
+    numMessages = 0;
+}
+
+/* --------------- */
+void DashBackoff::failed() {
+    unsigned long limit = minMs;
+    for (unsigned int i = 0; (i < failures) && (limit < maxMs); i++) {
+        limit *= 2;
+    }
+    if (limit > maxMs) {
+        limit = maxMs;
+    }
+    failures++;
+    waitMs = limit / 2 + random(limit / 2 + 1);
+    lastFailTime = millis();
+}
+
+void DashBackoff::reset() {
+    failures = 0;
+    waitMs = 0;
+}
+
+unsigned long DashBackoff::getTimeoutMs(unsigned long baseMs, unsigned long limitMs) {
+    unsigned long timeout = baseMs;
+    for (unsigned int i = 0; (i < failures) && (timeout < limitMs); i++) {
+        timeout *= 2;
+    }
+    return (timeout > limitMs) ? limitMs : timeout;
+}
+
+/* --------------- */
+// Control types whose messages carry state, so an unchanged message can be skipped
+static const char * const deltaControlTypes[] = {BUTTON_ID, TEXT_BOX_ID, TEXT_CAPTION_ID, SELECTOR_ID, SLIDER_ID, BAR_ID, KNOB_ID, KNOB_DIAL_ID, DIAL_ID, DIRECTION_ID, COLOR_ID, LABEL_ID};
+
+DashDeltaCache::~DashDeltaCache() {
+    delete[] entries;
+}
+
+void DashDeltaCache::begin(unsigned int _maxControls, unsigned long _refreshMs) {
+    delete[] entries;
+    entries = nullptr;
+    maxControls = 0;
+    numControls = 0;
+    refreshMs = _refreshMs;
+    if (_maxControls > 0) {
+        entries = new DashDeltaEntry[_maxControls];
+        if (entries != nullptr) {
+            maxControls = _maxControls;
+        }
+    }
+}
+
+// A line is "\tdeviceID\tcontrolType\tcontrolID\t...\n". Lines that can't be parsed, or that aren't for a state
+// control, always count as changed
+bool DashDeltaCache::isChanged(const char *line, size_t length) {
+    if (!enabled() || (length == 0) || (line[0] != DELIM)) {
+        return true;
+    }
+
+    const char *fieldStart[4];
+    int numFields = 0;
+    for (size_t i = 0; (i < length) && (numFields < 4); i++) {
+        if (line[i] == DELIM) {
+            fieldStart[numFields++] = line + i + 1;
+        }
+    }
+    if (numFields < 4) {
+        return true;
+    }
+
+    const char *type = fieldStart[1];
+    size_t typeLength = fieldStart[2] - type - 1;
+    bool stateControl = false;
+    for (size_t i = 0; i < sizeof(deltaControlTypes) / sizeof(deltaControlTypes[0]); i++) {
+        if ((strlen(deltaControlTypes[i]) == typeLength) && (strncmp(type, deltaControlTypes[i], typeLength) == 0)) {
+            stateControl = true;
+            break;
+        }
+    }
+    if (!stateControl) {
+        return true;
+    }
+
+    uint32_t key = fnv1aHash(type, fieldStart[3] - type - 1); // Type and ID
+    uint32_t value = fnv1aHash(line, length);
+    unsigned long timeNow = millis();
+    for (unsigned int i = 0; i < numControls; i++) {
+        if (entries[i].key == key) {
+            if ((entries[i].value == value) && (timeNow - entries[i].sentTime < refreshMs)) {
+                suppressedCount++;
+                return false;
+            }
+            entries[i].value = value;
+            entries[i].sentTime = timeNow;
+            return true;
+        }
+    }
+
+    if (numControls < maxControls) { // Otherwise the control just isn't cached
+        entries[numControls].key = key;
+        entries[numControls].value = value;
+        entries[numControls].sentTime = timeNow;
+        numControls++;
+    }
+    return true;
+}
+
+void DashDeltaCache::clear() {
+    numControls = 0;
+}
+
+/* --------------- */
+#define COMPACT_LITERAL_HEADER  0x80
+#define COMPACT_DEVICE_ID_FLAG  0x40
+#define COMPACT_INDEX_MASK      0x3F
+#define COMPACT_FLOAT_TAG       1
+#define COMPACT_MAX_CONTROL_LEN 15
+#define COMPACT_LENGTH_RESERVE  3    // Varint bytes reserved for the body length, so bodies up to 2MB
+
+DashCompactCodec::~DashCompactCodec() {
+    delete[] buffer;
+}
+
+bool DashCompactCodec::begin(size_t _maxLength) {
+    delete[] buffer;
+    buffer = nullptr;
+    maxLength = 0;
+    if (_maxLength > 0) {
+        buffer = new uint8_t[_maxLength];
+        if (buffer == nullptr) {
+            return false;
+        }
+        maxLength = _maxLength;
+    }
+    reset();
+    return true;
+}
+
+void DashCompactCodec::reset() {
+    deviceIDKnown = false;
+    deviceIDLength = 0;
+    bufferLength = 0;
+    skipLength = 0;
+}
+
+bool DashCompactCodec::put(const void *data, size_t length) {
+    if (bufferLength + length > maxLength) {
+        return false;
+    }
+    memcpy(buffer + bufferLength, data, length);
+    bufferLength += length;
+    return true;
+}
+
+bool DashCompactCodec::putVarint(uint32_t value) {
+    do {
+        uint8_t byte = value & 0x7F;
+        value >>= 7;
+        if (value > 0) {
+            byte |= 0x80;
+        }
+        if (!put(&byte, 1)) {
+            return false;
+        }
+    } while (value > 0);
+    return true;
+}
+
+bool DashCompactCodec::readVarint(const uint8_t *data, size_t length, size_t& pos, uint32_t& value) {
+    value = 0;
+    for (int shift = 0; (shift < 32) && (pos < length); shift += 7) {
+        uint8_t byte = data[pos++];
+        value |= (uint32_t)(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Returns the length of the frames for all the lines in text, or 0 if they don't fit in the buffer
+size_t DashCompactCodec::encode(const char *text, size_t length) {
+    bufferLength = 0;
+    if (!enabled()) {
+        return 0;
+    }
+    size_t lineStart = 0;
+    for (size_t i = 0; i < length; i++) {
+        if ((text[i] == END_DELIM) || (i == length - 1)) { // A trailing part line goes in a literal frame
+            if (!encodeLine(text + lineStart, i + 1 - lineStart)) {
+                bufferLength = 0;
+                deviceIDKnown = false; // The peer may not have seen it, so send it with the next frame
+                return 0;
+            }
+            lineStart = i + 1;
+        }
+    }
+    textBytes += length;
+    frameBytes += bufferLength;
+    return bufferLength;
+}
+
+// Queues the text as frames, or as text if the frames won't fit in the encode buffer. Returns false if the queue is full
+bool DashCompactCodec::write(DashSendQueue& queue, const char *text, size_t length) {
+    size_t frameLength = encode(text, length);
+    if (frameLength == 0) {
+        return queue.write(text, length);
+    }
+    if (!queue.write(frames(), frameLength)) {
+        deviceIDKnown = false; // The peer won't see this frame's deviceID
+        return false;
+    }
+    return true;
+}
+
+bool DashCompactCodec::encodeLine(const char *line, size_t length) {
+    size_t frameStart = bufferLength;
+    uint8_t marker = COMPACT_FRAME_MARKER;
+    if (!put(&marker, 1)) {
+        return false;
+    }
+    bufferLength += COMPACT_LENGTH_RESERVE;
+    if (bufferLength > maxLength) {
+        return false;
+    }
+    size_t bodyStart = bufferLength;
+
+    // Split "\tdeviceID\tcontrolType[\tfield...]\n" into its fields
+    const char *fields[2];
+    size_t fieldLengths[2];
+    int numFields = 0;
+    const char *rest = nullptr;
+    if ((length >= 2) && (line[0] == DELIM) && (line[length - 1] == END_DELIM)) {
+        const char *fieldStart = line + 1;
+        for (const char *ptr = fieldStart; ptr < line + length; ptr++) {
+            if ((*ptr == DELIM) || (*ptr == END_DELIM)) {
+                fields[numFields] = fieldStart;
+                fieldLengths[numFields] = ptr - fieldStart;
+                numFields++;
+                fieldStart = ptr + 1;
+                if (numFields == 2) {
+                    rest = ptr;
+                    break;
+                }
+            }
+        }
+    }
+
+    uint8_t index = CONTROL_TYPE_NO_SLOT;
+    if ((numFields == 2) && (fieldLengths[0] > 0) && (fieldLengths[1] <= COMPACT_MAX_CONTROL_LEN)) {
+        char controlStr[COMPACT_MAX_CONTROL_LEN + 1];
+        memcpy(controlStr, fields[1], fieldLengths[1]);
+        controlStr[fieldLengths[1]] = '\0';
+        index = controlTypeIndex(controlStr);
+    }
+
+    bool ok;
+    if (index == CONTROL_TYPE_NO_SLOT) {
+        uint8_t header = COMPACT_LITERAL_HEADER;
+        ok = put(&header, 1) && put(line, length);
+    } else {
+        bool sameDevice = deviceIDKnown && (fieldLengths[0] == deviceIDLength) && (memcmp(fields[0], deviceID, deviceIDLength) == 0);
+        uint8_t header = index;
+        if (!sameDevice) {
+            header |= COMPACT_DEVICE_ID_FLAG;
+        }
+        ok = put(&header, 1);
+        if (ok && !sameDevice) {
+            ok = putVarint(fieldLengths[0]) && put(fields[0], fieldLengths[0]);
+            deviceIDKnown = fieldLengths[0] <= COMPACT_MAX_DEVICE_ID_LEN; // Otherwise it's sent every time
+            if (deviceIDKnown) {
+                memcpy(deviceID, fields[0], fieldLengths[0]);
+                deviceIDLength = fieldLengths[0];
+            }
+        }
+
+        const char *fieldStart = rest + 1;
+        for (const char *ptr = fieldStart; ok && (*rest != END_DELIM) && (ptr < line + length); ptr++) {
+            if ((*ptr == DELIM) || (*ptr == END_DELIM)) {
+                ok = encodeField(fieldStart, ptr - fieldStart);
+                fieldStart = ptr + 1;
+            }
+        }
+    }
+    if (!ok) {
+        return false;
+    }
+
+    // Move the body down onto the length, now that it's known
+    size_t bodyLength = bufferLength - bodyStart;
+    bufferLength = frameStart + 1;
+    putVarint(bodyLength);
+    if (bufferLength - frameStart - 1 > COMPACT_LENGTH_RESERVE) {
+        return false;
+    }
+    memmove(buffer + bufferLength, buffer + bodyStart, bodyLength);
+    bufferLength += bodyLength;
+    return true;
+}
+
+// Packs the field as a float when that's shorter and formatFloat() turns it back into exactly the same text
+bool DashCompactCodec::encodeField(const char *field, size_t length) {
+    if ((length > sizeof(float)) && (length < 16)) {
+        char fieldStr[16];
+        memcpy(fieldStr, field, length);
+        fieldStr[length] = '\0';
+        char *end;
+        float value = strtod(fieldStr, &end);
+        if (end == fieldStr + length) {
+            char floatStr[16];
+            if (strcmp(formatFloat(floatStr, value), fieldStr) == 0) {
+                uint32_t bits;
+                memcpy(&bits, &value, sizeof(bits));
+                uint8_t bytes[1 + sizeof(bits)] = {COMPACT_FLOAT_TAG, (uint8_t)bits, (uint8_t)(bits >> 8), (uint8_t)(bits >> 16), (uint8_t)(bits >> 24)};
+                return put(bytes, sizeof(bytes));
+            }
+        }
+    }
+    return putVarint((uint32_t)length << 1) && put(field, length);
+}
+
+// Returns false, having appended any frames before it, if a frame is malformed
+bool DashCompactCodec::decode(const char *data, size_t length, String& text) {
+    const uint8_t *frameData = (const uint8_t *)data;
+    size_t pos = 0;
+    while (pos < length) {
+        uint32_t bodyLength;
+        if ((frameData[pos++] != COMPACT_FRAME_MARKER) || !readVarint(frameData, length, pos, bodyLength) || (bodyLength > length - pos)) {
+            return false;
+        }
+        if (!decodeFrame(frameData + pos, bodyLength, text)) {
+            return false;
+        }
+        pos += bodyLength;
+    }
+    return true;
+}
+
+// For links that split frames across writes. Appends any text as it is, and each frame once the rest of it has
+// arrived, to text. Without a buffer everything is taken as text. Returns true if a frame was decoded
+bool DashCompactCodec::receive(const char *data, size_t length, String& text) {
+    if (!enabled()) {
+        DashStringPrint(text).write((const uint8_t *)data, length);
+        return false;
+    }
+
+    bool decoded = false;
+    size_t pos = 0;
+    while (pos < length) {
+        if (skipLength > 0) { // The rest of a frame that was too big for the buffer
+            size_t skip = min(skipLength, length - pos);
+            skipLength -= skip;
+            pos += skip;
+            continue;
+        }
+
+        if (bufferLength == 0) {
+            const char *marker = (const char *)memchr(data + pos, COMPACT_FRAME_MARKER, length - pos);
+            size_t textLength = (marker != nullptr) ? marker - (data + pos) : length - pos;
+            if (textLength > 0) {
+                DashStringPrint(text).write((const uint8_t *)data + pos, textLength);
+                pos += textLength;
+                continue;
+            }
+        }
+
+        // The marker and body length come a byte at a time, until the length is known
+        size_t bodyStart = 1;
+        uint32_t bodyLength;
+        if (!readVarint(buffer, bufferLength, bodyStart, bodyLength)) {
+            if ((bufferLength > COMPACT_LENGTH_RESERVE) || (bufferLength >= maxLength)) {
+                errorCount++;
+                bufferLength = 0;
+                continue;
+            }
+            buffer[bufferLength++] = data[pos++];
+            continue;
+        }
+
+        size_t frameLength = bodyStart + bodyLength;
+        if (frameLength > maxLength) {
+            errorCount++;
+            skipLength = frameLength - bufferLength;
+            bufferLength = 0;
+            continue;
+        }
+        size_t copyLength = min(frameLength - bufferLength, length - pos);
+        memcpy(buffer + bufferLength, data + pos, copyLength);
+        bufferLength += copyLength;
+        pos += copyLength;
+        if (bufferLength == frameLength) {
+            unsigned int textLength = text.length();
+            if (decodeFrame(buffer + bodyStart, bodyLength, text)) {
+                decoded = true;
+            } else {
+                errorCount++;
+                text.remove(textLength); // Any part of the line decoded before the error
+            }
+            bufferLength = 0;
+        }
+    }
+    return decoded;
+}
+
+// Passes a write from the peer on to messageData, decoding any compact frames in it first. Text goes straight
+// through, as does everything if the codec has no buffer. Returns true if a frame was decoded
+bool DashCompactCodec::receive(const char *data, size_t length, MessageData& messageData, uint16_t connectionHandle) {
+    if (!enabled() || (!receiving() && (memchr(data, COMPACT_FRAME_MARKER, length) == nullptr))) {
+        messageData.processMessage(data, length, connectionHandle);
+        return false;
+    }
+    String text((char *)0);
+    bool decoded = receive(data, length, text);
+    messageData.processMessage(text.c_str(), text.length(), connectionHandle);
+    return decoded;
+}
+
+bool DashCompactCodec::decodeFrame(const uint8_t *body, size_t length, String& text) {
+    if (length == 0) {
+        return false;
+    }
+    DashStringPrint out(text);
+    uint8_t header = body[0];
+    if (header == COMPACT_LITERAL_HEADER) {
+        out.write(body + 1, length - 1);
+        return true;
+    }
+    uint8_t index = header & COMPACT_INDEX_MASK;
+    if ((header & COMPACT_LITERAL_HEADER) || (index >= NUM_CONTROL_TYPE_IDS)) {
+        return false;
+    }
+
+    size_t pos = 1;
+    out.print(DELIM);
+    if (header & COMPACT_DEVICE_ID_FLAG) {
+        uint32_t idLength;
+        if (!readVarint(body, length, pos, idLength) || (idLength > length - pos)) {
+            return false;
+        }
+        out.write(body + pos, idLength);
+        deviceIDKnown = idLength <= COMPACT_MAX_DEVICE_ID_LEN;
+        if (deviceIDKnown) {
+            memcpy(deviceID, body + pos, idLength);
+            deviceIDLength = idLength;
+        }
+        pos += idLength;
+    } else if (deviceIDKnown) {
+        out.write((const uint8_t *)deviceID, deviceIDLength);
+    } else {
+        return false; // Missed the frame with the deviceID
+    }
+    out.print(DELIM);
+    printControlTypeID(out, index);
+
+    while (pos < length) {
+        uint32_t tag;
+        if (!readVarint(body, length, pos, tag)) {
+            return false;
+        }
+        out.print(DELIM);
+        if (tag == COMPACT_FLOAT_TAG) {
+            if (length - pos < sizeof(uint32_t)) {
+                return false;
+            }
+            uint32_t bits = (uint32_t)body[pos] | ((uint32_t)body[pos + 1] << 8) | ((uint32_t)body[pos + 2] << 16) | ((uint32_t)body[pos + 3] << 24);
+            float value;
+            memcpy(&value, &bits, sizeof(value));
+            char floatStr[16];
+            out.print(formatFloat(floatStr, value));
+            pos += sizeof(uint32_t);
+        } else if ((tag & 1) == 0) {
+            uint32_t fieldLength = tag >> 1;
+            if (fieldLength > length - pos) {
+                return false;
+            }
+            out.write(body + pos, fieldLength);
+            pos += fieldLength;
+        } else {
+            return false;
+        }
+    }
+    out.print(END_DELIM);
+    return true;
+}
+
+/* --------------- */
+DashMessageBatch::~DashMessageBatch() {
+    delete[] buffer;
+}
+
+bool DashMessageBatch::begin(size_t _maxLength) {
+    delete[] buffer;
+    buffer = nullptr;
+    maxLength = 0;
+    if (_maxLength > 0) {
+        buffer = new char[_maxLength + 1]; // + 1 for the NUL
+        if (buffer == nullptr) {
+            return false;
+        }
+        maxLength = _maxLength;
+    }
+    clear();
+    return true;
+}
+
+// Returns false, without adding anything, if the message doesn't fit in what's left of the batch
+bool DashMessageBatch::add(const char *message, size_t length) {
+    if (!enabled() || !fits(length)) {
+        return false;
+    }
+    if (bufferLength == 0) {
+        firstMessageTime = millis();
+    }
+    memcpy(buffer + bufferLength, message, length);
+    bufferLength += length;
+    buffer[bufferLength] = '\0';
+    numMessages++;
+    return true;
+}
+
+void DashMessageBatch::clear() {
+    bufferLength = 0;
+    numMessages = 0;
+    if (buffer != nullptr) {
+        buffer[0] = '\0';
+    }
+}
+
+/* --------------- */
+static const char * const mqttTopicTips[] = {DATA_TOPIC_TIP, CONTROL_TOPIC_TIP, ALARM_TOPIC_TIP, ANNOUNCE_TOPIC_TIP, WILL_TOPIC_TIP}; // In MQTTTopicType order
+
+DashMQTTTopics::~DashMQTTTopics() {
+    delete[] buffer;
+}
+
+const char *DashMQTTTopics::getTopic(const char *userName, const String& deviceID, MQTTTopicType topic) {
+    if (userName == nullptr) {
+        userName = "";
+    }
+    if (!matches(userName, deviceID)) {
+        build(userName, deviceID);
+    }
+    return buffer + topicOffsets[topic];
+}
+
+// The buffer starts with the data topic, "userName/deviceID/data", so compare against that
+bool DashMQTTTopics::matches(const char *userName, const String& deviceID) {
+    if ((buffer == nullptr) || (strncmp(buffer, userName, userNameLength) != 0) || (userName[userNameLength] != '\0')) {
+        return false;
+    }
+    const char *deviceIDPtr = buffer + userNameLength + 1;
+    return (strncmp(deviceIDPtr, deviceID.c_str(), deviceID.length()) == 0) && (deviceIDPtr[deviceID.length()] == '/');
+}
+
+void DashMQTTTopics::build(const char *userName, const String& deviceID) {
+    userNameLength = strlen(userName);
+    size_t size = 0;
+    for (int i = 0; i <= will_topic; i++) {
+        size += userNameLength + deviceID.length() + strlen(mqttTopicTips[i]) + 3; // Two '/' and a NUL
+    }
+    if (size > bufferSize) {
+        delete[] buffer;
+        buffer = new char[size];
+        bufferSize = size;
+    }
+
+    char *ptr = buffer;
+    for (int i = 0; i <= will_topic; i++) {
+        topicOffsets[i] = ptr - buffer;
+        memcpy(ptr, userName, userNameLength);
+        ptr += userNameLength;
+        *ptr++ = '/';
+        memcpy(ptr, deviceID.c_str(), deviceID.length());
+        ptr += deviceID.length();
+        *ptr++ = '/';
+        strcpy(ptr, mqttTopicTips[i]);
+        ptr += strlen(mqttTopicTips[i]) + 1;
+    }
+}
+
+/* --------------- */
+DashTimeSeries::DashTimeSeries(const String& _controlID, const String& _lineID, uint16_t _capacity, uint16_t _decimation) {
+    controlID = _controlID;
+    lineID = _lineID;
+    sampleCapacity = _capacity;
+    if (sampleCapacity > 0) {
+        samples = new DashTimeSample[sampleCapacity];
+    }
+    if (_decimation > 0) {
+        decimation = _decimation;
+    }
+}
+
+DashTimeSeries::~DashTimeSeries() {
+    delete[] samples;
+}
+
+void DashTimeSeries::setLine(const String& _lineName, LineType _lineType, const String& _color, YAxisSelect _yAxisSelect) {
+    lineName = _lineName;
+    lineType = _lineType;
+    color = _color;
+    yAxisSelect = _yAxisSelect;
+}
+
+// Returns true when a sample is stored, i.e. every decimation calls, with the average of those values
+bool DashTimeSeries::addSample(time_t time, float value) {
+    if (sampleCapacity == 0) {
+        return false;
+    }
+
+    pendingSum += value;
+    pendingCount++;
+    if (pendingCount < decimation) {
+        return false;
+    }
+
+    samples[nextIndex].time = time;
+    samples[nextIndex].value = pendingSum / pendingCount;
+    pendingSum = 0;
+    pendingCount = 0;
+
+    nextIndex++;
+    if (nextIndex >= sampleCapacity) {
+        nextIndex = 0;
+    }
+    if (sampleCount < sampleCapacity) {
+        sampleCount++;
+    }
+    return true;
+}
+
+const DashTimeSample& DashTimeSeries::getSample(uint16_t index) {
+    uint16_t first = (nextIndex + sampleCapacity - sampleCount) % sampleCapacity;
+    return samples[(first + index) % sampleCapacity];
+}
+
+void DashTimeSeries::clear() {
+    sampleCount = 0;
+    nextIndex = 0;
+    pendingCount = 0;
+    pendingSum = 0;
+}
+
+/* --------------- */
+#define GPS_FIXED_SCALE      1e7
+#define GPS_METERS_PER_DEG   111320.0
+#define GPS_FULL_CIRCLE      3600000000L // 360 degrees in fixed point
+
+DashGPSTrack::DashGPSTrack(const String& _controlID, const String& _trackID, uint16_t _capacity, float _minDistanceM, float _minTurnDeg) {
+    controlID = _controlID;
+    trackID = _trackID;
+    pointCapacity = _capacity;
+    if (pointCapacity > 0) {
+        points = new DashTrackPoint[pointCapacity];
+    }
+    minDistanceM = _minDistanceM;
+    minTurnDeg = _minTurnDeg;
+}
+
+DashGPSTrack::~DashGPSTrack() {
+    delete[] points;
+}
+
+// Flat earth approximation, which is plenty for the distances between neighbouring points
+void DashGPSTrack::offsetMeters(const DashTrackPoint& from, const DashTrackPoint& to, float& east, float& north) {
+    int64_t dLon = (int64_t)to.longitude - from.longitude;
+    if (dLon > GPS_FULL_CIRCLE / 2) { // Across the antimeridian
+        dLon -= GPS_FULL_CIRCLE;
+    } else if (dLon < -GPS_FULL_CIRCLE / 2) {
+        dLon += GPS_FULL_CIRCLE;
+    }
+    float latRadians = from.latitude / GPS_FIXED_SCALE * DEG_TO_RAD;
+    north = (to.latitude - from.latitude) / GPS_FIXED_SCALE * GPS_METERS_PER_DEG;
+    east = dLon / GPS_FIXED_SCALE * GPS_METERS_PER_DEG * cos(latRadians);
+}
+
+// Returns true when the point is added as a new point, or false when it replaces the newest point
+bool DashGPSTrack::addPoint(time_t time, double latitude, double longitude, float speed, float course) {
+    if (pointCapacity == 0) {
+        return false;
+    }
+
+    DashTrackPoint point;
+    point.latitude = lround(latitude * GPS_FIXED_SCALE);
+    point.longitude = lround(longitude * GPS_FIXED_SCALE);
+    point.time = time;
+    point.speed = (speed < 0) ? GPS_NO_SPEED : min(lround(speed * 100), (long)GPS_NO_SPEED - 1);
+    point.course = (course < 0) ? GPS_NO_COURSE : lround(fmod(course, 360) * 10);
+
+    if (pointCount >= 2) {
+        const DashTrackPoint& anchor = pointAt(pointCount - 2);
+        DashTrackPoint& last = pointAt(pointCount - 1);
+        float east1, north1, east2, north2;
+        offsetMeters(anchor, last, east1, north1);
+        offsetMeters(last, point, east2, north2);
+        float turnDeg = fabs(atan2(east1 * north2 - north1 * east2, east1 * east2 + north1 * north2)) * RAD_TO_DEG;
+        bool tooClose = (east1 * east1 + north1 * north1) < (minDistanceM * minDistanceM);
+        if (tooClose || (turnDeg < minTurnDeg)) {
+            last = point; // The last point isn't needed to show the track
+            droppedCount++;
+            return false;
+        }
+    }
+
+    points[nextIndex] = point;
+    nextIndex++;
+    if (nextIndex >= pointCapacity) {
+        nextIndex = 0;
+    }
+    if (pointCount < pointCapacity) {
+        pointCount++;
+    }
+    return true;
+}
+
+const DashTrackPoint& DashGPSTrack::getPoint(uint16_t index) {
+    return pointAt(index);
+}
+
+void DashGPSTrack::clear() {
+    pointCount = 0;
+    nextIndex = 0;
+}
+
+/* --------------- */
+const char *DashTimeStamp::encode(time_t time) {
+    long day = time / 86400L;
+    long secondOfDay = time % 86400L;
+    if (secondOfDay < 0) { // Before 1970
+        secondOfDay += 86400L;
+        day--;
+    }
+
+    if (day != cachedDay) {
+        encodeDate(day);
+        cachedDay = day;
+        cachedSecondOfDay = -1;
+    }
+
+    if (secondOfDay != cachedSecondOfDay) {
+        if ((cachedSecondOfDay < 0) || (secondOfDay / 60 != cachedSecondOfDay / 60)) {
+            writeTwoDigits(&timeStr[11], secondOfDay / 3600);
+            writeTwoDigits(&timeStr[14], (secondOfDay / 60) % 60);
+        }
+        writeTwoDigits(&timeStr[17], secondOfDay % 60);
+        cachedSecondOfDay = secondOfDay;
+    }
+    return timeStr;
+}
+
+void DashTimeStamp::encodeDate(long day) {
+    // Days since 1970-01-01 to a civil date, using 400 year eras starting on March 1st
+    day += 719468L;
+    long era = (day >= 0 ? day : day - 146096L) / 146097L;
+    long dayOfEra = day - era * 146097L;
+    long yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+    long dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+    int monthIndex = (5 * dayOfYear + 2) / 153;
+    int dayOfMonth = dayOfYear - (153 * monthIndex + 2) / 5 + 1;
+    int month = monthIndex < 10 ? monthIndex + 3 : monthIndex - 9;
+    long year = yearOfEra + era * 400 + (month <= 2 ? 1 : 0);
+
+    writeTwoDigits(&timeStr[0], (year / 100) % 100);
+    writeTwoDigits(&timeStr[2], year % 100);
+    timeStr[4] = '-';
+    writeTwoDigits(&timeStr[5], month);
+    timeStr[7] = '-';
+    writeTwoDigits(&timeStr[8], dayOfMonth);
+    timeStr[10] = 'T';
+    timeStr[13] = ':';
+    timeStr[16] = ':';
+    timeStr[19] = 'Z';
+    timeStr[20] = '\0';
+}
+
+void DashTimeStamp::writeTwoDigits(char *ptr, int value) {
+    ptr[0] = '0' + (value / 10);
+    ptr[1] = '0' + (value % 10);
+}
+
+/* --------------- */
+DashStringPrint::DashStringPrint(String& _message) : message(_message) {
+}
+
+size_t DashStringPrint::write(uint8_t c) {
+    message += (char)c;
+    return 1;
+}
+
+// String::concat(const char *, unsigned int) is public on current cores (ESP32, ESP8266, ArduinoCore-API, AVR 1.8.3
+// and later) but protected on older ones, so which of these is used is worked out at compile time
+template<typename S> static auto appendBlock(S& str, const char *data, size_t length, int) -> decltype(str.concat(data, (unsigned int)length)) {
+    return str.concat(data, (unsigned int)length);
+}
+
+template<typename S> static bool appendBlock(S& str, const char *data, size_t length, long) {
+    if (!str.reserve(str.length() + length)) { // One allocation for the whole block, if any
+        return false;
+    }
+    for (size_t i = 0; i < length; i++) {
+        str += data[i];
+    }
+    return true;
+}
+
+size_t DashStringPrint::write(const uint8_t *data, size_t length) {
+    return appendBlock(message, (const char *)data, length, 0) ? length : 0;
+}
+
+DashBufferPrint::DashBufferPrint(char *_buffer, size_t _size) {
+    buffer = _buffer;
+    size = _size;
+    clear();
+}
+
+size_t DashBufferPrint::write(uint8_t c) {
+    return write(&c, 1);
+}
+
+size_t DashBufferPrint::write(const uint8_t *data, size_t length) {
+    if ((size == 0) || (bufferLength + length >= size)) { // Always leave room for the NUL
+        overflowed = true;
+        return 0;
+    }
+    memcpy(buffer + bufferLength, data, length);
+    bufferLength += length;
+    buffer[bufferLength] = '\0';
+    return length;
+}
+
+void DashBufferPrint::clear() {
+    bufferLength = 0;
+    overflowed = false;
+    if (size > 0) {
+        buffer[0] = '\0';
+    }
 }
@@ -73,6 +73,9 @@ typedef DashioSoftAP DashSoftAP;
 class DashioLTE;
 typedef DashioLTE DashLTE;
 
+class DashioBroadcast;
+typedef DashioBroadcast DashBroadcast;
+
 extern char DASH_SERVER[];
 #define DASH_PORT 8883
 #define DEFAULT_TCP_PORT 5650
@@ -83,6 +86,20 @@ extern char DASH_SERVER[];
 
 #define DEFAULT_DEVICE_NAME "DashIO Device"
 
+// Maximum length of a single tab delimited field in an incoming message. Longer fields are truncated
+#ifdef ARDUINO_ARCH_AVR
+    #define MAX_MESSAGE_FIELD_LEN 64
+#else
+    #define MAX_MESSAGE_FIELD_LEN 256
+#endif
+
+// Maximum length of a block of C64 config streamed by getC64ConfigChunk
+#ifdef ARDUINO_ARCH_AVR
+    #define MAX_CONFIG_CHUNK_LEN 100
+#else
+    #define MAX_CONFIG_CHUNK_LEN 1024
+#endif
+
 const char END_DELIM = '\n';
 const char DELIM = '\t';
 const char NOT_AVAILABLE[] = "NA";
@@ -122,7 +139,7 @@ enum ControlType {
     knob,
     dial,
     direction,
-    textBox,
+    textBox,      // Text entered on the dashboard arrives truncated to MAX_MESSAGE_FIELD_LEN (64 characters on AVR)
     selector,
     chart,
     timeGraph,
@@ -167,6 +184,14 @@ enum MQTTTopicType {
     will_topic
 };
 
+// Steps of an MQTT connect, one per call to run(). Each step is a blocking call with a short timeout
+enum MQTTConnectStep {
+    connectDNS,
+    connectTLS,
+    connectMQTT,
+    connectSubscribe
+};
+
 enum StatusCode {
     noError,
     wifiConnected,
@@ -223,6 +248,9 @@ public:
     String payloadStr = ((char *)0);
     String payloadStr2 = ((char *)0);
     uint16_t connectionHandle = 0;
+    unsigned long overflowCount = 0; // Incoming blocks dropped because the buffer was full
+    int highWater = 0;               // Most of the buffer ever used, in bytes
+    unsigned long truncatedCount = 0; // Incoming fields cut short at MAX_MESSAGE_FIELD_LEN
     /*
      String payloadStr3 = ((char *)0);
      String payloadStr4 = ((char *)0);
@@ -230,6 +258,7 @@ public:
     
     MessageData(ConnectionType connType, int _bufferLength = 0);
     void processMessage(const String& message, uint16_t _connectionHandle = 0);
+    void processMessage(const char *message, size_t length, uint16_t _connectionHandle = 0);
     bool processChar(char chr);
     String getMessageGeneric(const String& controlStr, bool connectionPrefix = false);
     String getReceivedMessageForPrint(const String& controlStr);
@@ -237,16 +266,389 @@ public:
     String getConnectionTypeStr();
     
     void checkBuffer();
+    bool nextMessage();
     
 private:
     char* buffer = nullptr;
-    int bufferWritePtr = 0;
-    int bufferReadPtr = 0;
+    volatile int bufferWritePtr = 0; // Only written by loadBuffer
+    volatile int bufferReadPtr = 0;  // Only written by checkBuffer
     int bufferLength = 0;
     int segmentCount = -1;
-    String readStr;
+    char readBuffer[MAX_MESSAGE_FIELD_LEN + 1]; // Fixed buffer for the field being read, so there is no heap allocation per character
+    uint16_t readLength = 0;
+    bool truncating = false; // Dropping the rest of a field that didn't fit in readBuffer
     
-    void loadBuffer(const String& message, uint16_t _connectionHandle);
+    static const int BUFFER_PREFIX_LEN = 2 * sizeof(uint16_t);
+    char blockPrefix[BUFFER_PREFIX_LEN];
+    uint8_t blockPrefixCount = 0;
+    uint16_t blockConnectionHandle = 0;
+    uint16_t blockRemaining = 0;
+
+    void loadBuffer(const char *message, size_t length, uint16_t _connectionHandle);
+    int copyToBuffer(int writePtr, const char *data, int length);
+};
+
+// Print sink that appends to an existing String, so the DashioDevice write functions can build Strings
+class DashStringPrint : public Print {
+public:
+    DashStringPrint(String& _message);
+    size_t write(uint8_t c);
+    size_t write(const uint8_t *data, size_t length);
+    using Print::write;
+
+private:
+    String& message;
+};
+
+// Print sink that writes into a caller supplied fixed size buffer. The buffer is always NUL terminated
+// and writes that don't fit are discarded and flagged by overflow()
+class DashBufferPrint : public Print {
+public:
+    DashBufferPrint(char *_buffer, size_t _size);
+    size_t write(uint8_t c);
+    size_t write(const uint8_t *data, size_t length);
+    using Print::write;
+    const char *c_str() {return buffer;}
+    size_t length() {return bufferLength;}
+    bool overflow() {return overflowed;}
+    void clear();
+
+private:
+    char *buffer = nullptr;
+    size_t size = 0;
+    size_t bufferLength = 0;
+    bool overflowed = false;
+};
+
+// Reads a client in blocks rather than a byte at a time (each read can be a system call, or an SPI transfer to a
+// WiFi module) and hands back one complete message at a time:
+// while (reader.nextMessage(client, data)) {...}
+// Keep calling until it returns false, so nothing read from one client is left over when the next is read
+class DashClientReader {
+public:
+    unsigned long readCount = 0; // Reads from clients
+
+    DashClientReader(unsigned int _size);
+    ~DashClientReader();
+
+    template<typename C> bool nextMessage(C& client, MessageData& data) {
+        while (true) {
+            while (blockPtr < blockLength) {
+                if (data.processChar(block[blockPtr++])) {
+                    return true;
+                }
+            }
+            int available = client.available();
+            if (available <= 0) {
+                return false;
+            }
+            int length = client.read((uint8_t *)block, ((unsigned int)available < size) ? available : size);
+            if (length <= 0) {
+                return false;
+            }
+            readCount++;
+            blockLength = length;
+            blockPtr = 0;
+        }
+    }
+
+private:
+    char *block = nullptr;
+    unsigned int size = 0;
+    unsigned int blockLength = 0;
+    unsigned int blockPtr = 0;
+};
+
+// Ring buffer of outgoing bytes. Connections queue messages here and send them from run() in blocks, as fast
+// as the link allows, so sending never blocks the caller. Messages that don't fit are dropped and counted
+class DashSendQueue {
+public:
+    unsigned long overflowCount = 0;
+
+    DashSendQueue(unsigned int _size);
+    ~DashSendQueue();
+    bool begin(unsigned int _size); // Reallocates the queue, empty
+    bool write(const char *data, size_t length);
+    bool write(const String& message) {return write(message.c_str(), message.length());}
+    size_t available() {return count;}
+    size_t space() {return size - count;}
+    size_t peek(char *block, size_t maxLength, size_t offset = 0);
+    void remove(size_t length);
+    void clear();
+
+private:
+    char *buffer = nullptr;
+    size_t size = 0;
+    size_t readPtr = 0;
+    size_t count = 0;
+};
+
+// Data and alarm messages published while MQTT is offline, held oldest first so they can be replayed in order
+// on reconnect. Each message is stored with its topic and length in a DashSendQueue
+class DashOfflineQueue {
+public:
+    unsigned long droppedCount = 0;
+
+    DashOfflineQueue(unsigned int _size) : queue(_size) {}
+    bool begin(unsigned int _size) {numMessages = 0; return queue.begin(_size);} // Held messages are lost
+    bool store(MQTTTopicType topic, const char *message, size_t length); // false, without storing, if there's no room
+    size_t peek(MQTTTopicType *topic, char *message, size_t maxLength); // Returns the oldest message's length, 0 if empty
+    size_t nextLength();
+    void remove();
+    void dropOldest() {remove(); droppedCount++;}
+    unsigned int depth() {return numMessages;}
+    bool fitsEmpty(size_t length) {return length + OFFLINE_HEADER_LEN <= queue.space() + queue.available();}
+    void clear();
+
+private:
+    static const size_t OFFLINE_HEADER_LEN = 3; // Topic and 16 bit length
+    DashSendQueue queue;
+    unsigned int numMessages = 0;
+};
+
+// Collects messages for one MQTT topic so they can go out as a single publish. The owner publishes the batch
+// when the next message won't fit or when the oldest message has waited long enough (isDue)
+class DashMessageBatch {
+public:
+    ~DashMessageBatch();
+    bool begin(size_t _maxLength); // 0 disables batching
+    bool enabled() {return maxLength > 0;}
+    bool fits(size_t length) {return bufferLength + length <= maxLength;}
+    bool add(const char *message, size_t length);
+    bool isDue(unsigned long maxLatencyMs) {return (bufferLength > 0) && (millis() - firstMessageTime >= maxLatencyMs);}
+    const char *c_str() {return buffer;}
+    size_t length() {return bufferLength;}
+    unsigned int messageCount() {return numMessages;}
+    void clear();
+
+private:
+    char *buffer = nullptr;
+    size_t maxLength = 0;
+    size_t bufferLength = 0;
+    unsigned int numMessages = 0;
+    unsigned long firstMessageTime = 0;
+};
+
+// The five MQTT topics for a user and device, built into one buffer and only rebuilt when the user name or
+// deviceID changes, so publishing a message needs no String work
+class DashMQTTTopics {
+public:
+    ~DashMQTTTopics();
+    const char *getTopic(const char *userName, const String& deviceID, MQTTTopicType topic);
+
+private:
+    char *buffer = nullptr;
+    size_t bufferSize = 0;
+    size_t userNameLength = 0;
+    size_t topicOffsets[will_topic + 1];
+
+    bool matches(const char *userName, const String& deviceID);
+    void build(const char *userName, const String& deviceID);
+};
+
+// Exponential backoff between reconnect attempts. Each failure doubles the wait, up to maxMs, and the actual wait
+// is a random point between half and all of that, so devices that lost the same server don't retry in lockstep
+class DashBackoff {
+public:
+    unsigned int failures = 0;
+
+    DashBackoff(unsigned long _minMs, unsigned long _maxMs) : minMs(_minMs), maxMs(_maxMs) {}
+    bool ready() {return millis() - lastFailTime >= waitMs;}
+    void failed();
+    void reset();
+    unsigned long getWaitMs() {return waitMs;}
+    unsigned long getTimeoutMs(unsigned long baseMs, unsigned long limitMs); // baseMs doubled for each failure so far
+
+private:
+    unsigned long minMs;
+    unsigned long maxMs;
+    unsigned long waitMs = 0;
+    unsigned long lastFailTime = 0;
+};
+
+struct DashDeltaEntry {
+    uint32_t key;                 // Hash of control type and ID
+    uint32_t value;               // Hash of the whole message line
+    unsigned long sentTime;
+};
+
+// Remembers the last message line sent for each state control (button, text box, slider etc.), keyed by control
+// type and ID, so lines that haven't changed can be left out. Each control is still resent every refreshMs.
+// Time graph points, logs, maps and other controls where every message is new data are never suppressed
+class DashDeltaCache {
+public:
+    unsigned long suppressedCount = 0;
+
+    ~DashDeltaCache();
+    void begin(unsigned int _maxControls, unsigned long _refreshMs);
+    bool enabled() {return maxControls > 0;}
+    bool isChanged(const char *line, size_t length); // Records the line as sent when it returns true
+    void clear();
+
+private:
+    DashDeltaEntry *entries = nullptr;
+    unsigned int maxControls = 0;
+    unsigned int numControls = 0;
+    unsigned long refreshMs = 0;
+};
+
+#define COMPACT_FRAME_MARKER 0xC1 // Text messages always start with DELIM, so a peer can tell the two formats apart
+#define COMPACT_MAX_DEVICE_ID_LEN 47
+#define COMPACT_FRAME_OVERHEAD 5 // Marker, body length and header, so a literal frame is at most this much longer than its text
+
+// Optional compact binary framing for metered or low MTU links. Each text line becomes one frame:
+// [COMPACT_FRAME_MARKER][varint body length][header][deviceID][fields], where the header byte is the control type
+// index, the deviceID is only included when it differs from the last frame (so it's elided after the CONNECT reply)
+// and each field is a varint tag, either (length << 1) followed by the text, or 1 followed by a little endian float.
+// Floats are only packed when formatFloat() gives back exactly the same text, so decoding always reproduces the
+// original line. Anything that isn't a complete control line (WHO, config chunks) goes in a literal frame.
+// One codec holds the state for one direction of one connection, and reset() must be called on both ends on connect.
+// On a pub/sub link (MQTT) the sender resets before every publish, so each payload can be decoded on its own.
+// On links that can split a frame across writes (BLE), the receiving codec's buffer holds a frame until it's complete
+class DashCompactCodec {
+public:
+    unsigned long textBytes = 0;  // Encoded so far, for comparing the two formats
+    unsigned long frameBytes = 0;
+    unsigned long errorCount = 0; // Frames dropped by receive(), as malformed or too big for the buffer
+
+    ~DashCompactCodec();
+    bool begin(size_t _maxLength); // Size of the encode, or receive, buffer. 0 disables encoding
+    bool enabled() {return maxLength > 0;}
+    static bool isCompact(const char *data, size_t length) {return (length > 0) && ((uint8_t)data[0] == COMPACT_FRAME_MARKER);}
+    size_t encode(const char *text, size_t length); // Returns 0 if the frames won't fit in the buffer
+    const char *frames() {return (const char *)buffer;}
+    bool write(DashSendQueue& queue, const char *text, size_t length);
+    bool decode(const char *data, size_t length, String& text); // Appends the decoded lines to text
+    bool receive(const char *data, size_t length, String& text);
+    bool receive(const char *data, size_t length, MessageData& messageData, uint16_t connectionHandle = 0);
+    bool receiving() {return (bufferLength > 0) || (skipLength > 0);}
+    void reset();
+
+private:
+    uint8_t *buffer = nullptr;
+    size_t maxLength = 0;
+    size_t bufferLength = 0;
+    size_t skipLength = 0;
+    char deviceID[COMPACT_MAX_DEVICE_ID_LEN + 1];
+    uint8_t deviceIDLength = 0;
+    bool deviceIDKnown = false;
+
+    bool encodeLine(const char *line, size_t length);
+    bool encodeField(const char *field, size_t length);
+    bool put(const void *data, size_t length);
+    bool putVarint(uint32_t value);
+    bool decodeFrame(const uint8_t *body, size_t length, String& text);
+    static bool readVarint(const uint8_t *data, size_t length, size_t& pos, uint32_t& value);
+};
+
+// Renders time_t values as ISO-8601 UTC strings ("2024-01-31T23:59:59Z"). The date part is cached, so
+// consecutive timestamps on the same day only re-render the time digits that changed
+class DashTimeStamp {
+public:
+    const char *encode(time_t time);
+
+private:
+    char timeStr[21];
+    long cachedDay = LONG_MIN;
+    long cachedSecondOfDay = -1;
+
+    void encodeDate(long day);
+    static void writeTwoDigits(char *ptr, int value);
+};
+
+struct DashTimeSample {
+    uint32_t time;
+    float value;
+};
+
+// Fixed size ring of time graph samples for one graph line, so that history can be replayed to a dashboard
+// when it connects. With decimation > 1, that many added samples are averaged into each stored sample
+class DashTimeSeries {
+public:
+    String controlID;
+    String lineID;
+    String lineName;
+    LineType lineType = line;
+    String color;
+    YAxisSelect yAxisSelect = yLeft;
+
+    DashTimeSeries(const String& _controlID, const String& _lineID, uint16_t _capacity, uint16_t _decimation = 1);
+    ~DashTimeSeries();
+    void setLine(const String& _lineName, LineType _lineType, const String& _color, YAxisSelect _yAxisSelect = yLeft);
+    bool addSample(time_t time, float value);
+    uint16_t count() {return sampleCount;}
+    uint16_t capacity() {return sampleCapacity;}
+    const DashTimeSample& getSample(uint16_t index); // 0 is the oldest sample
+    void clear();
+
+private:
+    DashTimeSample *samples = nullptr;
+    uint16_t sampleCapacity = 0;
+    uint16_t sampleCount = 0;
+    uint16_t nextIndex = 0;
+    uint16_t decimation = 1;
+    uint16_t pendingCount = 0;
+    float pendingSum = 0;
+};
+
+#define GPS_NO_SPEED  0xFFFF
+#define GPS_NO_COURSE -1
+
+// 16 bytes per point, against eight Strings for a Waypoint. Coordinates are in 1e-7 degrees (about 1cm)
+struct DashTrackPoint {
+    int32_t latitude;
+    int32_t longitude;
+    uint32_t time;
+    uint16_t speed;  // cm/s, or GPS_NO_SPEED. Sent as avgeSpeed in m/s
+    int16_t course;  // 0.1 degrees, or GPS_NO_COURSE
+};
+
+// Fixed size ring of GPS points for one map track, sent with writeMapTrackSeries. Points are thinned as they're
+// added: a point is dropped if it's within minDistanceM of the point before it, or if the track turns less than
+// minTurnDeg there. The newest point is always kept, replacing the last one until the track moves on or turns
+class DashGPSTrack {
+public:
+    String controlID;
+    String trackID;
+    String text;
+    String color;
+    unsigned long droppedCount = 0; // Points thinned out
+
+    DashGPSTrack(const String& _controlID, const String& _trackID, uint16_t _capacity, float _minDistanceM = 0, float _minTurnDeg = 0);
+    ~DashGPSTrack();
+    bool addPoint(time_t time, double latitude, double longitude, float speed = -1, float course = -1); // speed in m/s, course in degrees
+    uint16_t count() {return pointCount;}
+    uint16_t capacity() {return pointCapacity;}
+    const DashTrackPoint& getPoint(uint16_t index); // 0 is the oldest point
+    void clear();
+
+private:
+    DashTrackPoint *points = nullptr;
+    uint16_t pointCapacity = 0;
+    uint16_t pointCount = 0;
+    uint16_t nextIndex = 0;
+    float minDistanceM = 0;
+    float minTurnDeg = 0;
+
+    DashTrackPoint& pointAt(uint16_t index) {return points[(nextIndex + pointCapacity - pointCount + index) % pointCapacity];}
+    static void offsetMeters(const DashTrackPoint& from, const DashTrackPoint& to, float& east, float& north);
+};
+
+enum DashStateType {
+    noState,
+    boolState,
+    intState,
+    floatState,
+    stringState
+};
+
+struct DashControl {
+    ControlType controlType;
+    uint32_t idHash;
+    String controlID;
+    void (*handler)(MessageData *messageData);
+    void *state;
+    DashStateType stateType;
 };
 
 class DashioDevice {
@@ -271,6 +673,22 @@ public:
     void (*statusCallback)(StatusCode statusCode) = nullptr; // Only used for ESP32
     void onStatusCallback(StatusCode statusCode);
 
+    // Delta suppression for periodic updates. Replies to STATUS should send the full state without filtering
+    void enableDeltaCache(unsigned int maxControls, unsigned long refreshMs = 60000);
+    String getChangedMessages(const String& messages); // Only the lines that changed or are due a refresh
+    void resyncDeltaCache(); // Everything is sent again on the next update
+
+    // Control registry. Incoming messages for a registered control go to its handler (if any) instead of the
+    // connection's callback. Values in incoming messages are copied to int, float and String state. A button press
+    // carries no value, so bool state is left for the handler to change. Registered state also answers STATUS
+    void registerControl(ControlType controlType, const String& controlID, void (*handler)(MessageData *messageData), bool *state = nullptr);
+    void registerControl(ControlType controlType, const String& controlID, void (*handler)(MessageData *messageData), int *state);
+    void registerControl(ControlType controlType, const String& controlID, void (*handler)(MessageData *messageData), float *state);
+    void registerControl(ControlType controlType, const String& controlID, void (*handler)(MessageData *messageData), String *state);
+    bool dispatchMessage(MessageData *messageData); // Returns false if the control isn't registered
+    bool hasRegisteredState();
+    String getRegisteredStatusMessage();
+
     String getWhoMessage();
     String getConnectMessage();
     String getClockMessage();
@@ -341,6 +759,8 @@ public:
     void addTimeGraphLineFloats(String& message, const String& controlID, const String& lineID, const String& lineName, LineType lineType, const String& color, YAxisSelect yAxisSelect, time_t times[], float lineData[], int dataLength, bool breakLine = false);
     void addTimeGraphLineFloatsArr(String& message, const String& controlID, const String& lineID, const String& lineName, LineType lineType, const String& color, YAxisSelect yAxisSelect, time_t times[], float **lineData, int dataLength, int arrSize);
     void addTimeGraphLineBools(String& message, const String& controlID, const String& lineID, const String& lineName, LineType lineType, const String& color, String times[], bool lineData[], int dataLength);
+    uint16_t addTimeGraphLineSeries(String& message, DashTimeSeries& series, uint16_t offset = 0, unsigned int maxLength = MAX_CONFIG_CHUNK_LEN);
+    uint16_t addMapTrackSeries(String& message, DashGPSTrack& track, uint16_t offset = 0, unsigned int maxLength = MAX_CONFIG_CHUNK_LEN);
 
     String getTimeGraphPoint(const String& controlID, const String& lineID, float value);
     String getTimeGraphPoint(const String& controlID, const String& lineID, String time, float value);
@@ -350,6 +770,7 @@ public:
 //  Config messages
     String getC64ConfigBaseMessage();
     String getC64ConfigMessage(); //??? Obsolete - remove in due course
+    int getC64ConfigChunk(const char **chunk, unsigned int offset, unsigned int maxChunkLength);
 
     String getOnlineMessage();
     String getOfflineMessage();
@@ -358,21 +779,126 @@ public:
 
     String getControlTypeStr(ControlType controltype);
     ControlType getControlType(String controltypeStr);
+    ControlType getControlType(const char *controltypeStr);
 
     String getMQTTSubscribeTopic(const String& userName);
     String getMQTTTopic(const String& userName, MQTTTopicType topic);
     
+//  Write messages directly to a Print sink (e.g. a Client or DashBufferPrint) without building a String
+    void writeWhoMessage(Print& out);
+    void writeConnectMessage(Print& out);
+    void writeClockMessage(Print& out);
+
+    void writeDeviceNameMessage(Print& out);
+    void writeWifiUpdateAckMessage(Print& out);
+    void writeTCPUpdateAckMessage(Print& out);
+    void writeDashioUpdateAckMessage(Print& out);
+    void writeMQTTUpdateAckMessage(Print& out);
+    void writeResetDeviceMessage(Print& out);
+
+    void writeAlarmMessage(Print& out, const String& alarmID, const String& title, const String& description);
+    void writeAlarmMessage(Print& out, const Notification& alarm);
+
+    void writeButtonMessage(Print& out, const String& controlID);
+    void writeButtonMessage(Print& out, const String& controlID, bool on, const String& iconName = "", const String& text = "");
+
+    void writeTextBoxMessage(Print& out, const String& controlID, const String& text, const String& color = "");
+    void writeTextBoxCaptionMessage(Print& out, const String& controlID, const String& text, const String& color = "");
+
+    void writeSelectorMessage(Print& out, const String& controlID);
+    void writeSelectorMessage(Print& out, const String& controlID, int index);
+    void writeSelectorMessage(Print& out, const String& controlID, int index, String selectionItems[], int numItems);
+    void writeSelectorMessage(Print& out, const String& controlID, int index, const String& selectionStr);
+
+    void writeSliderMessage(Print& out, const String& controlID, int value);
+    void writeSliderMessage(Print& out, const String& controlID, float value);
+    void writeSliderMessage(Print& out, const String& controlID);
+    void writeSingleBarMessage(Print& out, const String& controlID, int value);
+    void writeSingleBarMessage(Print& out, const String& controlID, float value);
+    void writeSingleBarMessage(Print& out, const String& controlID);
+    void writeDoubleBarMessage(Print& out, const String& controlID, int value1, int value2);
+    void writeDoubleBarMessage(Print& out, const String& controlID, float value1, float value2);
+    void writeDoubleBarMessage(Print& out, const String& controlID);
+
+    void writeKnobMessage(Print& out, const String& controlID, int value);
+    void writeKnobMessage(Print& out, const String& controlID, float value);
+    void writeKnobMessage(Print& out, const String& controlID);
+    void writeKnobDialMessage(Print& out, const String& controlID, int value);
+    void writeKnobDialMessage(Print& out, const String& controlID, float value);
+    void writeKnobDialMessage(Print& out, const String& controlID);
+
+    void writeDialMessage(Print& out, const String& controlID, int value);
+    void writeDialMessage(Print& out, const String& controlID, float value);
+    void writeDialMessage(Print& out, const String& controlID);
+
+    void writeDirectionMessage(Print& out, const String& controlID, int direction, float speed = -1);
+    void writeDirectionMessage(Print& out, const String& controlID, float direction, float speed = -1);
+    void writeDirectionMessage(Print& out, const String& controlID);
+
+    void writeMapWaypointMessage(Print& out, const String& controlID, const String& trackID, const String& latitude, const String& longitude);
+    void writeMapWaypointMessage(Print& out, const String& controlID, const String& trackID, float latitude, float longitude);
+    void writeMapTrackMessage(Print& out, const String& controlID, const String& trackID, const String& text, const String& colour, Waypoint waypoints[] = {}, int numWaypoints = 0);
+
+    void writeEventLogMessage(Print& out, const String& controlID, const String& color, String text[], int numTextRows);
+    void writeEventLogMessage(Print& out, const String& controlID, const String& timeStr, const String& color, String text[], int numTextRows);
+    void writeEventLogMessage(Print& out, const String& controlID, Event events[], int numEvents);
+
+    void writeColorMessage(Print& out, const String& controlID, const String& color);
+
+    void writeAudioVisualMessage(Print& out, const String& controlID, const String& url = "");
+
+    void writeChartLineInts(Print& out, const String& controlID, const String& lineID, const String& lineName, LineType lineType, const String& color, YAxisSelect yAxisSelect, int lineData[], int dataLength);
+    void writeChartLineFloats(Print& out, const String& controlID, const String& lineID, const String& lineName, LineType lineType, const String& color, YAxisSelect yAxisSelect, float lineData[], int dataLength);
+
+    void writeTimeGraphLine(Print& out, const String& controlID, const String& lineID, const String& lineName, LineType lineType, const String& color, YAxisSelect yAxisSelect);
+    void writeTimeGraphLineFloats(Print& out, const String& controlID, const String& lineID, const String& lineName, LineType lineType, const String& color, YAxisSelect yAxisSelect, String times[], float lineData[], int dataLength);
+    void writeTimeGraphLineFloats(Print& out, const String& controlID, const String& lineID, const String& lineName, LineType lineType, const String& color, YAxisSelect yAxisSelect, time_t times[], float lineData[], int dataLength, bool breakLine = false);
+    void writeTimeGraphLineFloatsArr(Print& out, const String& controlID, const String& lineID, const String& lineName, LineType lineType, const String& color, YAxisSelect yAxisSelect, time_t times[], float **lineData, int dataLength, int arrSize);
+    void writeTimeGraphLineBools(Print& out, const String& controlID, const String& lineID, const String& lineName, LineType lineType, const String& color, String times[], bool lineData[], int dataLength);
+    uint16_t writeTimeGraphLineSeries(Print& out, DashTimeSeries& series, uint16_t offset = 0, unsigned int maxLength = MAX_CONFIG_CHUNK_LEN);
+    uint16_t writeMapTrackSeries(Print& out, DashGPSTrack& track, uint16_t offset = 0, unsigned int maxLength = MAX_CONFIG_CHUNK_LEN);
+
+    void writeTimeGraphPoint(Print& out, const String& controlID, const String& lineID, float value);
+    void writeTimeGraphPoint(Print& out, const String& controlID, const String& lineID, const String& time, float value);
+    void writeTimeGraphPointArr(Print& out, const String& controlID, const String& lineID, float value[], int arrSize);
+    void writeTimeGraphPointArr(Print& out, const String& controlID, const String& lineID, const String& time, float value[], int arrSize);
+
+    void writeC64ConfigBaseMessage(Print& out);
+    void writeOnlineMessage(Print& out);
+    void writeRegisteredStatusMessage(Print& out);
+    void writeOfflineMessage(Print& out);
+    void writeDataStoreEnableMessage(Print& out, const DashStore& dashStore);
+
 private:
-    String getControlBaseMessage(const String& messageType, const String& controlID);
-    void addControlBaseMessage(String& message, const String& messageType, const String& controlID);
-    void addLineTypeStr(String& message, LineType lineType);
-    void addYaxisSelectStr(String& message, YAxisSelect yAxisSelect);
-    void addTimeGraphLineBaseMessage(String& message, const String& _dashboardID, const String& controlID, const String& lineID, const String& lineName, LineType lineType, const String& color, YAxisSelect yAxisSelect);
-    void addIntArray(String& message, int idata[], int dataLength);
-    void addFloatArray(String& message, float fdata[], int dataLength);
-
-    void addWaypointJSON(String& message, Waypoint waypoint);
-    void addEventJSON(String& message, Event event);
+    unsigned int configC64Length = 0;
+    DashDeltaCache deltaCache;
+    DashControl *controls = nullptr; // Sorted by control type then ID hash
+    int numControls = 0;
+
+    void addControl(ControlType controlType, const String& controlID, void (*handler)(MessageData *messageData), void *state, DashStateType stateType);
+    DashControl *findControl(ControlType controlType, const String& controlID);
+    void writeControlState(Print& out, const DashControl& control);
+
+    void writeDeviceMessage(Print& out, const char *messageType);
+    void writeControlBaseMessage(Print& out, const char *controlType, const String& controlID);
+    void writeNotAvailableMessage(Print& out, const char *controlType, const String& controlID);
+    void writeIntMessage(Print& out, const char *controlType, const String& controlID, int value);
+    void writeFloatMessage(Print& out, const char *controlType, const String& controlID, float value);
+    void writeLineTypeStr(Print& out, LineType lineType);
+    void writeYaxisSelectStr(Print& out, YAxisSelect yAxisSelect);
+    void writeChartLineBaseMessage(Print& out, const String& controlID, const String& lineID, const String& lineName, LineType lineType, const String& color, YAxisSelect yAxisSelect);
+    void writeEventLogRowsMessage(Print& out, const String& controlID, const char *timeStr, const String& color, String text[], int numTextRows);
+    void writeMapTrackBaseMessage(Print& out, const String& controlID, const String& trackID, const String& text, const String& colour);
+    void writeTimeGraphLineBaseMessage(Print& out, const char *_dashboardID, const String& controlID, const String& lineID, const String& lineName, LineType lineType, const String& color, YAxisSelect yAxisSelect);
+    void writeInt(Print& out, int value);
+    void writeFloat(Print& out, float value);
+    void writeIntArray(Print& out, int idata[], int dataLength);
+    void writeFloatArray(Print& out, float fdata[], int dataLength);
+    void writeFloatList(Print& out, float fdata[], int dataLength);
+
+    void writeWaypointJSON(Print& out, const Waypoint& waypoint);
+    void writeTrackPointJSON(Print& out, const DashTrackPoint& point, DashTimeStamp& timeStamp);
+    void writeEventJSON(Print& out, const Event& event);
 };
 
 #endif
@@ -36,27 +36,15 @@ void DashioBluno::sendMessage(const String& writeStr) {
 
 void DashioBluno::processConfig() {
     sendMessage(dashioDevice->getC64ConfigBaseMessage());
-    
-    int c64Length = strlen_P(dashioDevice->configC64Str);
-    int length = 0;
-    String message = "";
-    for (int k = 0; k < c64Length; k++) {
-        char myChar = pgm_read_byte_near(dashioDevice->configC64Str + k);
 
-        message += myChar;
-        length++;
-        if (length == 100) {
-            sendMessage(message);
-            delay(100);
-            message = "";
-            length = 0;
-        }
-    }
-    if (message.length() > 0) {
-        sendMessage(message);
+    const char *chunk;
+    unsigned int offset = 0;
+    int length;
+    while ((length = dashioDevice->getC64ConfigChunk(&chunk, offset, 100)) > 0) {
+        Serial.write(chunk, length);
+        delay(100);
+        offset += length;
     }
-
-    sendMessage(String('\n'));
 }
 
 void DashioBluno::run() {
@@ -75,11 +63,19 @@ void DashioBluno::run() {
             case config:
                 processConfig();
                 break;
-            default:
+            case status:
+                if (dashioDevice->hasRegisteredState()) {
+                    sendMessage(dashioDevice->getRegisteredStatusMessage());
+                }
                 if (processBLEmessageCallback != NULL) {
                     processBLEmessageCallback(&messageData);
                 }
                 break;
+            default:
+                if (!dashioDevice->dispatchMessage(&messageData) && (processBLEmessageCallback != NULL)) {
+                    processBLEmessageCallback(&messageData);
+                }
+                break;
             }
         }
     }
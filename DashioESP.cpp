@@ -37,13 +37,36 @@ const int INCOMING_BUFFER_SIZE = 512;
 
 // MQTT
 const int MQTT_QOS = 2;
-const int MQTT_RETRY_S = 10; // Retry after 10 seconds
+const unsigned long MQTT_RETRY_MIN_MS = 2000;   // Backoff between connect attempts doubles from here ...
+const unsigned long MQTT_RETRY_MAX_MS = 120000; // ... up to here
+const unsigned long MQTT_STEP_TIMEOUT_MS = 500;      // Wait in each connect step (TLS, CONNACK, SUBACK) starts here ...
+const unsigned long MQTT_STEP_TIMEOUT_MAX_MS = 4000; // ... and doubles after each failed attempt, for slow links, up to here
+const int MQTT_COMMAND_TIMEOUT_MS = 10000;           // Wait for QoS acknowledgements once connected
 const int MQTT_CLIENT_BUFFER_SIZE = 2048;
+const int MQTT_PACKET_OVERHEAD = 128; // Fixed header, topic and packet ID share the client buffer with the payload
+const int MQTT_MAX_BATCH_LENGTH = MQTT_CLIENT_BUFFER_SIZE - MQTT_PACKET_OVERHEAD;
 const int MQTT_SEND_WAIT_MS = 1000;
 const int MQTT_SEND_BUFFER_MIN = 1024;
+const int MQTT_OFFLINE_QUEUE_SIZE = 4096;
+const unsigned long MQTT_REPLAY_INTERVAL_MS = 50; // Between replayed messages, so a backlog doesn't flood the broker
+#ifdef DASH_MQTT_OFFLINE_SPILL
+const size_t MQTT_SPILL_FILE_SIZE = 65536;
+const char MQTT_SPILL_FILE[] = "/dash_offline";
+const size_t MQTT_SPILL_HEADER_LEN = 3; // Topic and 16 bit length, as in DashOfflineQueue
+#endif
+
+// TCP
+const int TCP_READ_BUFFER_SIZE = 256;
+#ifdef ESP32
+const int TCP_TX_BUFFER_SIZE = 1436; // lwIP TCP_MSS
+#else
+const int TCP_TX_BUFFER_SIZE = 536;
+#endif
 
 // BLE
 const int BLE_MAX_SEND_MESSAGE_LENGTH = 185; // 185 for iPhone 6, but can be up to 517
+const int BLE_SEND_QUEUE_SIZE = 2048; // Per client
+const int BLE_COMPACT_BUFFER_SIZE = 512; // Per client, each way, with compactFraming. Longer messages go as text
 
 // ---------------------------------------- WiFi ---------------------------------------
 
@@ -262,7 +285,7 @@ void DashioSoftAP::run() {
 // ---------------------------------------- TCP ----------------------------------------
 
 #ifdef ESP32
-DashioTCP::DashioTCP(DashioDevice *_dashioDevice, bool _printMessages, uint16_t _tcpPort, uint8_t _maxTCPclients) {
+DashioTCP::DashioTCP(DashioDevice *_dashioDevice, bool _printMessages, uint16_t _tcpPort, uint8_t _maxTCPclients) : clientReader(TCP_READ_BUFFER_SIZE) {
     dashioDevice = _dashioDevice;
     tcpPort = _tcpPort;
     printMessages = _printMessages;
@@ -270,15 +293,21 @@ DashioTCP::DashioTCP(DashioDevice *_dashioDevice, bool _printMessages, uint16_t
 
     maxTCPclients = _maxTCPclients;
     tcpClients = new TCPclient[_maxTCPclients];
+    for (int i = 0; i < maxTCPclients; i++) {
+        tcpClients[i].txBuffer = new char[TCP_TX_BUFFER_SIZE];
+    }
 }
 #elif ESP8266
-DashioTCP::DashioTCP(DashioDevice *_dashioDevice, bool _printMessages, uint16_t _tcpPort, uint8_t _maxTCPclients) : wifiServer(_tcpPort) {
+DashioTCP::DashioTCP(DashioDevice *_dashioDevice, bool _printMessages, uint16_t _tcpPort, uint8_t _maxTCPclients) : wifiServer(_tcpPort), clientReader(TCP_READ_BUFFER_SIZE) {
     dashioDevice = _dashioDevice;
     tcpPort = _tcpPort;
     printMessages = _printMessages;
 
     maxTCPclients = _maxTCPclients;
     tcpClients = new TCPclient[_maxTCPclients];
+    for (int i = 0; i < maxTCPclients; i++) {
+        tcpClients[i].txBuffer = new char[TCP_TX_BUFFER_SIZE];
+    }
 }
 #endif
 
@@ -309,7 +338,7 @@ void DashioTCP::sendMessage(const String& message, uint8_t index) {
     if (index < maxTCPclients) {
         WiFiClient *clientPtr = &tcpClients[index].client;
         if (clientPtr->connected()) {
-            clientPtr->print(message);
+            sendBuffer(message.c_str(), message.length(), index);
             if (printMessages) {
                 Serial.println(F("---- TCP Sent ----"));
                 Serial.println(message);
@@ -319,8 +348,36 @@ void DashioTCP::sendMessage(const String& message, uint8_t index) {
 }
 
 void DashioTCP::sendMessage(const String& message) {
+    bool sent = false;
+    for (int i = 0; i < maxTCPclients; i++) {
+        if (tcpClients[i].client.connected()) {
+            sendBuffer(message.c_str(), message.length(), i);
+            sent = true;
+        }
+    }
+
+    if (sent && printMessages) { // Once, rather than per client
+        Serial.println(F("---- TCP Sent ----"));
+        Serial.println(message);
+    }
+}
+
+// Writes out anything waiting in the transmit buffers now, rather than at the end of the flush window
+void DashioTCP::flush() {
     for (int i = 0; i < maxTCPclients; i++) {
-        sendMessage(message, i);
+        flushClient(i);
+    }
+}
+
+void DashioTCP::flushClient(uint8_t index) {
+    TCPclient *tcpClientPtr = &tcpClients[index];
+    if (tcpClientPtr->txLength > 0) {
+        if (tcpClientPtr->client.connected()) {
+            tcpClientPtr->client.write((const uint8_t *)tcpClientPtr->txBuffer, tcpClientPtr->txLength);
+            txByteCount += tcpClientPtr->txLength;
+            txSegmentCount++;
+        }
+        tcpClientPtr->txLength = 0;
     }
 }
 
@@ -355,62 +412,91 @@ void DashioTCP::end() {
 
 void DashioTCP::processConfig(uint16_t index) {
     sendMessage(dashioDevice->getC64ConfigBaseMessage(), index);
-    
-    int c64Length = strlen_P(dashioDevice->configC64Str);
-    int length = 0;
-    String message = "";
-    for (int k = 0; k < c64Length; k++) {
-        char myChar = pgm_read_byte_near(dashioDevice->configC64Str + k);
 
-        message += myChar;
-        length++;
-        if (length == C64_MAX_LENGHT) {
-            sendMessage(message, index);
-            message = "";
-            length = 0;
+    const char *chunk;
+    unsigned int offset = 0;
+    int length;
+    while ((length = dashioDevice->getC64ConfigChunk(&chunk, offset, C64_MAX_LENGHT)) > 0) {
+        sendBuffer(chunk, length, index);
+        offset += length;
+    }
+
+    if (printMessages) {
+        Serial.println(F("---- TCP Sent ----"));
+        Serial.println(F("C64 config"));
+    }
+}
+
+// Adds to the client's transmit buffer, writing it out whenever it fills
+void DashioTCP::sendBuffer(const char *buffer, size_t length, uint8_t index) {
+    if (index < maxTCPclients) {
+        TCPclient *tcpClientPtr = &tcpClients[index];
+        if (tcpClientPtr->client.connected()) {
+            if (tcpClientPtr->txLength + length > TCP_TX_BUFFER_SIZE) {
+                flushClient(index);
+            }
+            if (length >= TCP_TX_BUFFER_SIZE) { // Too big to buffer, so write straight out
+                tcpClientPtr->client.write((const uint8_t *)buffer, length);
+                txByteCount += length;
+                txSegmentCount++;
+            } else {
+                if (tcpClientPtr->txLength == 0) {
+                    tcpClientPtr->txStartTime = millis();
+                }
+                memcpy(tcpClientPtr->txBuffer + tcpClientPtr->txLength, buffer, length);
+                tcpClientPtr->txLength += length;
+            }
         }
     }
-    message += String(END_DELIM);
-    sendMessage(message, index);
 }
 
-bool DashioTCP::checkTCP(int index) {
+void DashioTCP::processMessage(uint8_t index) {
     TCPclient *tcpClientPtr = &tcpClients[index];
-    if (tcpClientPtr->client.connected()) {
-        while (tcpClientPtr->client.available()>0) {
-            char c = tcpClientPtr->client.read();
-            if (tcpClientPtr->data.processChar(c)) {
-                tcpClientPtr->data.connectionHandle = index; // So we have a reference to the index in the MessageData
+    tcpClientPtr->data.connectionHandle = index; // So we have a reference to the index in the MessageData
 
-                if (printMessages) {
-                    Serial.println(tcpClientPtr->data.getReceivedMessageForPrint(dashioDevice->getControlTypeStr(tcpClientPtr->data.control)));
-                }
-                
-                switch (tcpClientPtr->data.control) {
-                case who:
-                    sendMessage(dashioDevice->getWhoMessage(), index);
-                    break;
-                case connect:
-                    sendMessage(dashioDevice->getConnectMessage(), index);
-                    break;
-                case config:
-                    dashioDevice->dashboardID = tcpClientPtr->data.idStr;
-                    if (dashioDevice->configC64Str != nullptr) {
-                        processConfig(index);
-                    } else {
-                        if (processTCPmessageCallback != nullptr) {
-                            processTCPmessageCallback(&tcpClientPtr->data);
-                        }
-                    }
-                    break;
-                default:
-                    if (processTCPmessageCallback != nullptr) {
-                        processTCPmessageCallback(&tcpClientPtr->data);
-                    }
-                    break;
-                }
+    if (printMessages) {
+        Serial.println(tcpClientPtr->data.getReceivedMessageForPrint(dashioDevice->getControlTypeStr(tcpClientPtr->data.control)));
+    }
+    
+    switch (tcpClientPtr->data.control) {
+    case who:
+        sendMessage(dashioDevice->getWhoMessage(), index);
+        break;
+    case connect:
+        sendMessage(dashioDevice->getConnectMessage(), index);
+        break;
+    case config:
+        dashioDevice->dashboardID = tcpClientPtr->data.idStr;
+        if (dashioDevice->configC64Str != nullptr) {
+            processConfig(index);
+        } else {
+            if (processTCPmessageCallback != nullptr) {
+                processTCPmessageCallback(&tcpClientPtr->data);
             }
         }
+        break;
+    case status:
+        if (dashioDevice->hasRegisteredState()) {
+            sendMessage(dashioDevice->getRegisteredStatusMessage(), index);
+        }
+        if (processTCPmessageCallback != nullptr) {
+            processTCPmessageCallback(&tcpClientPtr->data);
+        }
+        break;
+    default:
+        if (!dashioDevice->dispatchMessage(&tcpClientPtr->data) && (processTCPmessageCallback != nullptr)) {
+            processTCPmessageCallback(&tcpClientPtr->data);
+        }
+        break;
+    }
+}
+
+bool DashioTCP::checkTCP(int index) {
+    TCPclient *tcpClientPtr = &tcpClients[index];
+    if (tcpClientPtr->client.connected()) {
+        while (clientReader.nextMessage(tcpClientPtr->client, tcpClientPtr->data)) {
+            processMessage(index);
+        }
         return true;
     } else {
         return false;
@@ -423,13 +509,43 @@ void DashioTCP::run() {
         for (int i = 0; i < maxTCPclients; ++i) {
             if (!tcpClients[i].client) {
                 newClient.setTimeout(2000);
+                newClient.setNoDelay(true); // Messages are already coalesced, so don't let Nagle hold them back
                 tcpClients[i].client = newClient;
+                tcpClients[i].txLength = 0;
                 break;
             }
         }
     }
 
+#ifdef ESP32
+    // One select() across all client sockets, so only clients with data waiting, or that have closed, are read
+    fd_set readSet;
+    FD_ZERO(&readSet);
+    int maxFd = -1;
     for (int i = 0; i < maxTCPclients; i++) {
+        int fd = tcpClients[i].client.fd();
+        if (fd >= 0) {
+            FD_SET(fd, &readSet);
+            if (fd > maxFd) {
+                maxFd = fd;
+            }
+        }
+    }
+    if (maxFd >= 0) {
+        struct timeval timeout = {0, 0};
+        if (select(maxFd + 1, &readSet, nullptr, nullptr, &timeout) <= 0) {
+            FD_ZERO(&readSet);
+        }
+    }
+#endif
+
+    for (int i = 0; i < maxTCPclients; i++) {
+#ifdef ESP32
+        int fd = tcpClients[i].client.fd();
+        if ((fd >= 0) && !FD_ISSET(fd, &readSet)) {
+            continue; // Nothing waiting
+        }
+#endif
         if (!checkTCP(i)) {
             if (tcpClients[i].client) {
                 tcpClients[i].client.stop(); // This doesn't every get called
@@ -437,6 +553,12 @@ void DashioTCP::run() {
             }
         }
     }
+
+    for (int i = 0; i < maxTCPclients; i++) {
+        if ((tcpClients[i].txLength > 0) && (millis() - tcpClients[i].txStartTime >= flushWindowMs)) {
+            flushClient(i);
+        }
+    }
     
 #ifdef ESP8266
     MDNS.update();
@@ -445,7 +567,7 @@ void DashioTCP::run() {
 
 // ---------------------------------------- MQTT ---------------------------------------
 
-DashioMQTT::DashioMQTT(DashioDevice *_dashioDevice, bool _sendRebootAlarm, bool _printMessages) : mqttClient(MQTT_CLIENT_BUFFER_SIZE) {
+DashioMQTT::DashioMQTT(DashioDevice *_dashioDevice, bool _sendRebootAlarm, bool _printMessages) : mqttClient(MQTT_CLIENT_BUFFER_SIZE), offlineQueue(MQTT_OFFLINE_QUEUE_SIZE), connectBackoff(MQTT_RETRY_MIN_MS, MQTT_RETRY_MAX_MS) {
     dashioDevice = _dashioDevice;
     sendRebootAlarm  = _sendRebootAlarm;
     printMessages = _printMessages;
@@ -455,13 +577,12 @@ DashioMQTT::DashioMQTT(DashioDevice *_dashioDevice, bool _sendRebootAlarm, bool
 #endif
 }
 
-DashioMQTT::DashioMQTT(DashioDevice *_dashioDevice, bool _sendRebootAlarm, bool _printMessages, int _mqttBufferSize) : mqttClient(MQTT_CLIENT_BUFFER_SIZE) {
+DashioMQTT::DashioMQTT(DashioDevice *_dashioDevice, bool _sendRebootAlarm, bool _printMessages, int _mqttBufferSize) : mqttClient(MQTT_CLIENT_BUFFER_SIZE), offlineQueue(MQTT_OFFLINE_QUEUE_SIZE), connectBackoff(MQTT_RETRY_MIN_MS, MQTT_RETRY_MAX_MS) {
     dashioDevice = _dashioDevice;
     sendRebootAlarm  = _sendRebootAlarm;
     printMessages = _printMessages;
     if (_mqttBufferSize >= MQTT_SEND_BUFFER_MIN) {
-        mqttBuffersize = _mqttBufferSize;
-        mqttSendBuffer.reserve(_mqttBufferSize);
+        setBatching(_mqttBufferSize, MQTT_SEND_WAIT_MS);
     }
 
 #ifdef ESP32
@@ -470,48 +591,261 @@ DashioMQTT::DashioMQTT(DashioDevice *_dashioDevice, bool _sendRebootAlarm, bool
 }
 
 MessageData DashioMQTT::data(MQTT_CONN, INCOMING_BUFFER_SIZE);
+DashCompactCodec DashioMQTT::rxCodec;
+bool DashioMQTT::compactPeer = false;
 
 void DashioMQTT::messageReceivedMQTTCallback(MQTTClient *client, char *topic, char *payload, int payload_length) {
-    data.processMessage(String(payload)); // The message components are stored within the connection where the messageReceived flag is set
+    if (DashCompactCodec::isCompact(payload, payload_length)) {
+        String message((char *)0);
+        if (rxCodec.decode(payload, payload_length, message)) {
+            compactPeer = true; // The peer understands compact frames, so reply in them
+        }
+        data.processMessage(message.c_str(), message.length());
+        return;
+    }
+    data.processMessage(payload, payload_length); // The message components are stored within the connection where the messageReceived flag is set
+}
+
+// Batches data and announce messages into publishes of up to maxLength bytes (capped to fit the MQTT client buffer).
+// A batch is published when it's full, or maxLatencyMs after its first message. maxLength of 0 turns batching off
+void DashioMQTT::setBatching(unsigned int maxLength, unsigned long maxLatencyMs) {
+    flush();
+    if (maxLength > MQTT_MAX_BATCH_LENGTH) {
+        maxLength = MQTT_MAX_BATCH_LENGTH;
+    }
+    if (!dataBatch.begin(maxLength) || !announceBatch.begin(maxLength)) {
+        dataBatch.begin(0);
+        announceBatch.begin(0);
+    }
+    batchLatencyMs = maxLatencyMs;
 }
 
-void DashioMQTT::checkAndSendMQTTbuffer() {
-    if (mqttSendBuffer.length() > 0) {
-        unsigned long timeNow = millis();
-        long timeSinceLastMessage = timeNow - lastSentMessageTime;
-        if (timeSinceLastMessage < 0) {timeSinceLastMessage = MQTT_SEND_WAIT_MS;}
-        if (timeSinceLastMessage >= MQTT_SEND_WAIT_MS) {
-            lastSentMessageTime = timeNow;
-            publishMessage(mqttSendBuffer, data_topic);
-            mqttSendBuffer.clear();
+DashMessageBatch *DashioMQTT::getBatch(MQTTTopicType topic) {
+    switch (topic) {
+        case data_topic:
+            return dataBatch.enabled() ? &dataBatch : nullptr;
+        case announce_topic:
+            return announceBatch.enabled() ? &announceBatch : nullptr;
+        default:
+            return nullptr;
+    }
+}
+
+void DashioMQTT::sendMessage(const String& message, MQTTTopicType topic) {
+    bool offlineTopic = (topic == data_topic) || (topic == alarm_topic);
+    if (offlineTopic && (!mqttClient.connected() || (offlineDepth() > 0))) {
+        storeOffline(message.c_str(), message.length(), topic); // Behind anything still waiting to be replayed
+        return;
+    }
+
+    DashMessageBatch *batch = getBatch(topic);
+    if ((batch == nullptr) || !mqttClient.connected()) {
+        if (!publishBuffer(message.c_str(), message.length(), topic)) {
+            publishFailed(message.c_str(), message.length(), topic, 1);
+        }
+        return;
+    }
+
+    if (!batch->fits(message.length())) {
+        publishBatch(*batch, topic);
+    }
+    if (!batch->add(message.c_str(), message.length())) {
+        if (!publishBuffer(message.c_str(), message.length(), topic)) { // Bigger than a whole batch, so send it on its own
+            publishFailed(message.c_str(), message.length(), topic, 1);
         }
+    } else if (millis() - lastPublishTime >= batchLatencyMs) {
+        publishBatch(*batch, topic); // Nothing sent recently, so don't hold the message back
     }
 }
 
-void DashioMQTT::publishMessage(const String& message, MQTTTopicType topic) {
-    if (mqttClient.connected()) {
-        String publishTopic = dashioDevice->getMQTTTopic(username, topic);
-        mqttClient.publish(publishTopic.c_str(), message.c_str(), false, MQTT_QOS);
+void DashioMQTT::publishBatch(DashMessageBatch& batch, MQTTTopicType topic) {
+    if (batch.length() > 0) {
+        if (publishBuffer(batch.c_str(), batch.length(), topic)) {
+            batchedCount += batch.messageCount();
+        } else {
+            publishFailed(batch.c_str(), batch.length(), topic, batch.messageCount());
+        }
+        batch.clear();
+    }
+}
 
-        if (printMessages) {
-            Serial.print(F("---- MQTT Sent ---- Topic: "));
-            Serial.println(publishTopic);
-            Serial.println(message);
+// Data and alarm messages are held for replay. Anything else is lost
+void DashioMQTT::publishFailed(const char *buffer, size_t length, MQTTTopicType topic, unsigned int numMessages) {
+    if ((topic == data_topic) || (topic == alarm_topic)) {
+        storeOffline(buffer, length, topic);
+    } else {
+        droppedCount += numMessages;
+    }
+}
+
+void DashioMQTT::storeOffline(const char *message, size_t length, MQTTTopicType topic) {
+    if (length == 0) {
+        return;
+    }
+    if (!offlineQueue.fitsEmpty(length)) {
+        offlineQueue.droppedCount++;
+        return;
+    }
+    while (!offlineQueue.store(topic, message, length)) {
+#ifdef DASH_MQTT_OFFLINE_SPILL
+        if (offlineSpill && !spillStopped && spillOldest()) {
+            continue;
         }
+#endif
+        offlineQueue.dropOldest(); // Lose the oldest rather than the newest
     }
 }
 
-void DashioMQTT::sendMessage(const String& message, MQTTTopicType topic) {
-    if (mqttBuffersize >= MQTT_SEND_BUFFER_MIN && topic == data_topic) {
-        if (message.length() < (mqttBuffersize - mqttSendBuffer.length())) {
-            mqttSendBuffer += message;
-            checkAndSendMQTTbuffer();
+#ifdef DASH_MQTT_OFFLINE_SPILL
+// Moves the oldest message in RAM to the end of the spill file, so everything in the file is older than what's in RAM
+bool DashioMQTT::spillOldest() {
+    size_t length = offlineQueue.nextLength();
+    File file = LittleFS.open(MQTT_SPILL_FILE, "a");
+    if (!file) {
+        return false;
+    }
+    size_t spillStart = file.size();
+    if (spillStart + MQTT_SPILL_HEADER_LEN + length > MQTT_SPILL_FILE_SIZE) {
+        file.close();
+        return false;
+    }
+
+    char *message = new char[length];
+    MQTTTopicType topic;
+    offlineQueue.peek(&topic, message, length);
+    uint8_t header[MQTT_SPILL_HEADER_LEN] = {(uint8_t)topic, (uint8_t)(length >> 8), (uint8_t)(length & 0xFF)};
+    bool written = (file.write(header, MQTT_SPILL_HEADER_LEN) == MQTT_SPILL_HEADER_LEN) && (file.write((uint8_t *)message, length) == length);
+    if (!written) { // Don't leave a part record for the next one to be appended after
+#ifdef ESP8266
+        spillStopped = !file.truncate(spillStart);
+#else
+        spillStopped = true; // No truncate() on ESP32, so stop until the file has been replayed and removed
+#endif
+    }
+    file.close();
+    delete[] message;
+
+    if (written) {
+        offlineQueue.remove();
+        spillCount++;
+    }
+    return written;
+}
+
+// Messages spilled before a restart are still in the file, so count them to be replayed
+void DashioMQTT::countSpilled() {
+    spillCount = 0;
+    spillReadOffset = 0;
+    File file = LittleFS.open(MQTT_SPILL_FILE, "r");
+    if (file) {
+        uint8_t header[MQTT_SPILL_HEADER_LEN];
+        size_t offset = 0;
+        while (file.seek(offset) && (file.read(header, MQTT_SPILL_HEADER_LEN) == MQTT_SPILL_HEADER_LEN)) {
+            offset += MQTT_SPILL_HEADER_LEN + (((size_t)header[1] << 8) | header[2]);
+            if (offset > file.size()) { // Partly written
+                break;
+            }
+            spillCount++;
+        }
+        file.close();
+    }
+}
+#endif
+
+// Publishes one held message each MQTT_REPLAY_INTERVAL_MS, oldest (spilled) first
+void DashioMQTT::replayOffline() {
+    if ((offlineDepth() == 0) || (millis() - lastReplayTime < MQTT_REPLAY_INTERVAL_MS)) {
+        return;
+    }
+    lastReplayTime = millis();
+
+#ifdef DASH_MQTT_OFFLINE_SPILL
+    if (spillCount > 0) {
+        replaySpilled();
+        return;
+    }
+#endif
+
+    if (!allocateReplayBuffer()) {
+        return;
+    }
+    MQTTTopicType topic;
+    size_t length = offlineQueue.peek(&topic, replayBuffer, MQTT_CLIENT_BUFFER_SIZE - 1);
+    if (length == 0) {
+        offlineQueue.dropOldest(); // Too big for the MQTT client to publish
+        return;
+    }
+    replayBuffer[length] = '\0';
+    if (publishBuffer(replayBuffer, length, topic)) {
+        offlineQueue.remove();
+    }
+}
+
+// The replay buffer is allocated once, the first time there's anything to replay
+bool DashioMQTT::allocateReplayBuffer() {
+    if (replayBuffer == nullptr) {
+        replayBuffer = new char[MQTT_CLIENT_BUFFER_SIZE];
+    }
+    return replayBuffer != nullptr;
+}
+
+// Holds up to size bytes of data and alarm messages while MQTT is offline. Call before begin(), as any messages
+// already held are lost
+void DashioMQTT::setOfflineQueue(unsigned int size) {
+    offlineQueue.begin(size);
+}
+
+#ifdef DASH_MQTT_OFFLINE_SPILL
+void DashioMQTT::replaySpilled() {
+    if (!allocateReplayBuffer()) {
+        return;
+    }
+    File file = LittleFS.open(MQTT_SPILL_FILE, "r");
+    uint8_t header[MQTT_SPILL_HEADER_LEN];
+    if (file && file.seek(spillReadOffset) && (file.read(header, MQTT_SPILL_HEADER_LEN) == MQTT_SPILL_HEADER_LEN)) {
+        size_t length = ((size_t)header[1] << 8) | header[2];
+        if (length >= MQTT_CLIENT_BUFFER_SIZE) { // Too big for the MQTT client to publish
+            spillReadOffset += MQTT_SPILL_HEADER_LEN + length;
+            spillCount--;
+            offlineQueue.droppedCount++;
+        } else if (file.read((uint8_t *)replayBuffer, length) == length) {
+            replayBuffer[length] = '\0';
+            if (publishBuffer(replayBuffer, length, (MQTTTopicType)header[0])) {
+                spillReadOffset += MQTT_SPILL_HEADER_LEN + length;
+                spillCount--;
+            }
+        } else {
+            spillCount = 0; // Partly written, so there's nothing more to read
         }
     } else {
-        publishMessage(message, topic);
+        spillCount = 0;
+    }
+    if (file) {
+        file.close();
+    }
+
+    if (spillCount == 0) {
+        LittleFS.remove(MQTT_SPILL_FILE);
+        spillReadOffset = 0;
+        spillStopped = false;
+    }
+}
+#endif
+
+void DashioMQTT::publishDueBatches() {
+    if (dataBatch.isDue(batchLatencyMs)) {
+        publishBatch(dataBatch, data_topic);
+    }
+    if (announceBatch.isDue(batchLatencyMs)) {
+        publishBatch(announceBatch, announce_topic);
     }
 }
 
+void DashioMQTT::flush() {
+    publishBatch(dataBatch, data_topic);
+    publishBatch(announceBatch, announce_topic);
+}
+
 void DashioMQTT::sendAlarmMessage(const String& message) {
     sendMessage(message, alarm_topic);
 }
@@ -521,24 +855,45 @@ void DashioMQTT::sendWhoAnnounce() {
 }
 
 void DashioMQTT::processConfig() {
-    sendMessage(dashioDevice->getC64ConfigBaseMessage());
-    
-    int c64Length = strlen_P(dashioDevice->configC64Str);
-    int length = 0;
-    String message = "";
-    for (int k = 0; k < c64Length; k++) {
-        char myChar = pgm_read_byte_near(dashioDevice->configC64Str + k);
+    publishBatch(dataBatch, data_topic); // Keep message order
+    String message = dashioDevice->getC64ConfigBaseMessage();
+    publishBuffer(message.c_str(), message.length(), data_topic);
+
+    const char *chunk;
+    unsigned int offset = 0;
+    int length;
+    while ((length = dashioDevice->getC64ConfigChunk(&chunk, offset, MQTT_CLIENT_BUFFER_SIZE / 2)) > 0) {
+        publishBuffer(chunk, length, data_topic);
+        offset += length;
+    }
+}
 
-        message += myChar;
-        length++;
-        if (length == (MQTT_CLIENT_BUFFER_SIZE / 2)) {
-            sendMessage(message);
-            message = "";
-            length = 0;
+bool DashioMQTT::publishBuffer(const char *buffer, int length, MQTTTopicType topic) {
+    if (mqttClient.connected()) {
+        const char *publishTopic = mqttTopics.getTopic(username, dashioDevice->deviceID, topic);
+        const char *payload = buffer;
+        int payloadLength = length;
+        if (compactPeer && (topic == data_topic) && txCodec.enabled()) {
+            txCodec.reset(); // Each publish carries its deviceID, as a subscriber can join the topic at any time
+            size_t frameLength = txCodec.encode(buffer, length);
+            if (frameLength > 0) { // Otherwise send the text, which the peer can still read
+                payload = txCodec.frames();
+                payloadLength = frameLength;
+            }
+        }
+        if (mqttClient.publish(publishTopic, payload, payloadLength, false, MQTT_QOS)) {
+            publishCount++;
+            lastPublishTime = millis();
+
+            if (printMessages) {
+                Serial.print(F("---- MQTT Sent ---- Topic: "));
+                Serial.println(publishTopic);
+                Serial.println(buffer);
+            }
+            return true;
         }
     }
-    message += String(END_DELIM);
-    sendMessage(message);
+    return false;
 }
 
 void DashioMQTT::addDashStore(ControlType controlType, String controlID) {
@@ -563,9 +918,9 @@ void DashioMQTT::addDashStore(ControlType controlType, String controlID) {
 void DashioMQTT::setupLWT() {
     // Setup MQTT Last Will and Testament message (Optional). Default keep alive time is 10s
 
-    String willTopic = dashioDevice->getMQTTTopic(username, will_topic);
+    const char *willTopic = mqttTopics.getTopic(username, dashioDevice->deviceID, will_topic);
     String offlineMessage = dashioDevice->getOfflineMessage();
-    mqttClient.setWill(willTopic.c_str(), offlineMessage.c_str(), false, MQTT_QOS);
+    mqttClient.setWill(willTopic, offlineMessage.c_str(), false, MQTT_QOS);
 
     if (printMessages) {
         Serial.print(F("LWT topic: "));
@@ -592,21 +947,42 @@ void DashioMQTT::begin() {
     }
 
     mqttClient.begin(mqttHost, mqttPort, wifiClient);
-    mqttClient.setOptions(10, true, 10000);  // 10s timeout
+    mqttClient.setOptions(10, true, MQTT_COMMAND_TIMEOUT_MS);
     mqttClient.onMessageAdvanced(messageReceivedMQTTCallback);
   
     setupLWT(); // Once the deviceID is known
+#ifdef DASH_MQTT_OFFLINE_SPILL
+    if (offlineSpill) {
+        countSpilled();
+    }
+#endif
+    if (compactFraming) {
+        txCodec.begin(MQTT_MAX_BATCH_LENGTH); // Frames that would be bigger go as text
+    }
     state = disconnected;
 }
 
 void DashioMQTT::onConnected() {
-    // Subscribe to private MQTT connection
-    String subscriberTopic = dashioDevice->getMQTTSubscribeTopic(username);
-    mqttClient.subscribe(subscriberTopic.c_str(), MQTT_QOS); // ... and subscribe
+    compactPeer = false; // Text until the peer sends a compact frame on this connection
+    txCodec.reset();
+    rxCodec.reset();
 
     // Send MQTT ONLINE and WHO messages to connection (Optional)
     // WHO is only required here if using the Dash server and it must be send to the ANNOUNCE topic
-    sendMessage(dashioDevice->getOnlineMessage());
+    // ONLINE and the reboot alarm are published straight away, ahead of any replay of messages held while offline
+    String message = dashioDevice->getOnlineMessage();
+    if (!publishBuffer(message.c_str(), message.length(), data_topic)) {
+        publishFailed(message.c_str(), message.length(), data_topic, 1);
+    }
+    if (reboot) {
+        reboot = false;
+        if (sendRebootAlarm) {
+            message = dashioDevice->getAlarmMessage("ALX", "System Reboot", dashioDevice->name);
+            if (!publishBuffer(message.c_str(), message.length(), alarm_topic)) {
+                publishFailed(message.c_str(), message.length(), alarm_topic, 1);
+            }
+        }
+    }
     sendMessage(dashioDevice->getWhoMessage(), announce_topic); // Update announce topic with new name
     
     if (dashStore != nullptr) {
@@ -615,59 +991,80 @@ void DashioMQTT::onConnected() {
         }
     }
     
-    if (reboot) {
-        reboot = false;
-        if (sendRebootAlarm) {
-            sendAlarmMessage(dashioDevice->getAlarmMessage("ALX", "System Reboot", dashioDevice->name));
-        }
-    }
-    
     dashioDevice->onStatusCallback(mqttConnected);
 }
 
-void DashioMQTT::hostConnect() {
-    Serial.print(F("Connecting MQTT..."));
-    state = connecting;
-
-/* In case deviceID.c_str() gives trouble
-    int idLen = dashioDevice->deviceID.length() + 1;
-    char clientID[idLen];
-    dashioDevice->deviceID.toCharArray(clientID, idLen);
-*/
-    if (mqttClient.connect(dashioDevice->deviceID.c_str(), username, password, false)) { // skip = false is the default. Used in order to establish and verify TLS connections manually before giving control to the MQTT client
-        if (printMessages) {
-            Serial.println(F("connected"));
+// Makes one step of the connect per call (DNS, TLS, CONNECT then SUBSCRIBE). Each step blocks for at most its step
+// timeout, which starts at a few hundred ms and doubles after each failed attempt. Failed attempts are backed off
+void DashioMQTT::advanceConnect() {
+    bool stepOK = false;
+    unsigned long stepTimeoutMs = connectBackoff.getTimeoutMs(MQTT_STEP_TIMEOUT_MS, MQTT_STEP_TIMEOUT_MAX_MS);
+    switch (connectStep) {
+        case connectDNS: {
+            IPAddress hostIP;
+#ifdef ESP8266
+            stepOK = (WiFi.hostByName(mqttHost, hostIP, stepTimeoutMs) == 1); // Leaves the address in the DNS cache for the TLS step
+#else
+            stepOK = (WiFi.hostByName(mqttHost, hostIP) == 1); // Bounded by the ESP32 DNS client's own timeout
+#endif
+            break;
         }
-        state = serverConnected;
-    } else {
+        case connectTLS:
+            wifiClient.stop();
+#ifdef ESP32
+            wifiClient.setHandshakeTimeout((stepTimeoutMs + 999) / 1000); // Whole seconds
+            stepOK = wifiClient.connect(mqttHost, mqttPort, stepTimeoutMs);
+#else
+            wifiClient.setTimeout(stepTimeoutMs); // Bounds the TLS handshake as well as the TCP connect
+            stepOK = wifiClient.connect(mqttHost, mqttPort);
+#endif
+            break;
+        case connectMQTT:
+            mqttClient.setTimeout(stepTimeoutMs); // Wait for CONNACK
+            stepOK = mqttClient.connect(dashioDevice->deviceID.c_str(), username, password, true); // skip = true, as the TLS connection is already up
+            break;
+        case connectSubscribe:
+            mqttClient.setTimeout(stepTimeoutMs); // Wait for SUBACK
+            stepOK = mqttClient.subscribe(mqttTopics.getTopic(username, dashioDevice->deviceID, control_topic), MQTT_QOS);
+            break;
+    }
+
+    if (!stepOK) {
+        connectBackoff.failed();
         if (printMessages) {
-            Serial.print(F("failed - Try again in 10 seconds. E = "));
+            Serial.print(F("MQTT connect failed at step "));
+            Serial.print(connectStep);
+            Serial.print(F(" - Try again in "));
+            Serial.print(connectBackoff.getWaitMs() / 1000);
+            Serial.print(F("s. E = "));
             Serial.println(String(mqttClient.lastError()) + "  R = " + mqttClient.returnCode());
             // Invalid URL or port => E = -3  R = 0
             // Invalid username or password => E = -10  R = 5
             // Invalid SSL record => E = -5  R = 6
         }
+        wifiClient.stop();
         state = disconnected;
+        dashioDevice->onStatusCallback(mqttDisconnected);
+    } else if (connectStep == connectSubscribe) {
+        if (printMessages) {
+            Serial.println(F("MQTT connected"));
+        }
+        mqttClient.setTimeout(MQTT_COMMAND_TIMEOUT_MS);
+        connectBackoff.reset();
+        state = serverConnected;
+    } else {
+        connectStep = (MQTTConnectStep)(connectStep + 1);
     }
 }
 
+// Starts a connect when MQTT is down and the backoff allows. run() then steps through it
 void DashioMQTT::checkConnection() {
-    // Check and connect MQTT as necessary
-    if (WiFi.status() == WL_CONNECTED) {
-        if (state == disconnected) {
-            if (mqttConnectCount == 0) {
-                hostConnect();
-            }
-            if (mqttConnectCount >= MQTT_RETRY_S) {
-                mqttConnectCount = 0;
-
-                dashioDevice->onStatusCallback(mqttDisconnected);
-            } else {
-                mqttConnectCount++;
-            }
-        } else if (state == serverConnected) {
-            mqttConnectCount = 0;
+    if ((WiFi.status() == WL_CONNECTED) && (state == disconnected) && connectBackoff.ready()) {
+        if (printMessages) {
+            Serial.println(F("Connecting MQTT..."));
         }
+        connectStep = connectDNS;
+        state = connecting;
     }
 }
     
@@ -678,6 +1075,9 @@ void DashioMQTT::checkConnectionTask(void * parameter) {
         if (mqttConn != nullptr) {
             if (!mqttConn->esp32_mqtt_blocking) {
                 mqttConn->checkConnection();
+                while (mqttConn->state == connecting) {
+                    mqttConn->advanceConnect();
+                }
             }
         }
         vTaskDelay(1000 / portTICK_PERIOD_MS);
@@ -686,6 +1086,16 @@ void DashioMQTT::checkConnectionTask(void * parameter) {
 #endif
 
 void DashioMQTT::run() {
+    if (state == connecting) {
+#ifdef ESP32
+        if (!esp32_mqtt_blocking) {
+            return; // checkConnectionTask steps through the connect
+        }
+#endif
+        advanceConnect();
+        return;
+    }
+
     if (mqttClient.connected()) {
         mqttClient.loop();
 
@@ -694,9 +1104,7 @@ void DashioMQTT::run() {
             state = subscribed;
         }
 
-        if (data.messageReceived) {
-            data.messageReceived = false;
-
+        while (data.nextMessage()) {
             if (printMessages) {
                 Serial.println(data.getReceivedMessageForPrint(dashioDevice->getControlTypeStr(data.control)));
             }
@@ -718,16 +1126,24 @@ void DashioMQTT::run() {
                         }
                     }
                     break;
-                default:
+                case status:
+                    if (dashioDevice->hasRegisteredState()) {
+                        sendMessage(dashioDevice->getRegisteredStatusMessage());
+                    }
                     if (processMQTTmessageCallback != nullptr) {
                         processMQTTmessageCallback(&data);
                     }
                     break;
+                default:
+                    if (!dashioDevice->dispatchMessage(&data) && (processMQTTmessageCallback != nullptr)) {
+                        processMQTTmessageCallback(&data);
+                    }
+                    break;
             }
         }
 
-        data.checkBuffer();
-        checkAndSendMQTTbuffer();
+        publishDueBatches();
+        replayOffline();
     } else {
         if ((state == serverConnected) or (state == subscribed)) {
             state = disconnected;
@@ -737,6 +1153,7 @@ void DashioMQTT::run() {
 
 void DashioMQTT::end() {
     sendMessage(dashioDevice->getOfflineMessage());
+    flush();
     mqttClient.disconnect();
 }
 
@@ -798,11 +1215,11 @@ public:
 
     void onWrite(NimBLECharacteristic *pCharacteristic, ble_gap_conn_desc *desc) { // BLE callback for when a message is received
         std::string payload = pCharacteristic->getValue();
-        local_DashioBLE->data.processMessage(payload.c_str(), desc->conn_handle); /// The message components are stored within the connection where the messageReceived flag is set
+        local_DashioBLE->receive(desc->conn_handle, payload.data(), payload.length());
     }
 };
 
-DashioBLE::DashioBLE(DashioDevice *_dashioDevice, bool _printMessages) : data(BLE_CONN, INCOMING_BUFFER_SIZE) {
+DashioBLE::DashioBLE(DashioDevice *_dashioDevice, bool _printMessages) {
     dashioDevice = _dashioDevice;
     printMessages = _printMessages;
     maxBLEclients = 1;
@@ -810,7 +1227,7 @@ DashioBLE::DashioBLE(DashioDevice *_dashioDevice, bool _printMessages) : data(BL
     initialiseClientHolders();
 }
 
-DashioBLE::DashioBLE(DashioDevice *_dashioDevice, bool _printMessages, uint8_t _maxBLEclients) : data(BLE_CONN, INCOMING_BUFFER_SIZE) {
+DashioBLE::DashioBLE(DashioDevice *_dashioDevice, bool _printMessages, uint8_t _maxBLEclients) {
     dashioDevice = _dashioDevice;
     printMessages = _printMessages;
     maxBLEclients = _maxBLEclients;
@@ -818,33 +1235,65 @@ DashioBLE::DashioBLE(DashioDevice *_dashioDevice, bool _printMessages, uint8_t _
     initialiseClientHolders();
 }
 
-void DashioBLE::bleNotifyValue(const String& message) {
-    pCharacteristic->setValue(message);
-    pCharacteristic->notify();
+// Returns false if the stack has no buffers free, so the block should be sent again later
+bool DashioBLE::bleNotifyValue(const char *buffer, size_t length, uint16_t connectionHandle) {
+    struct os_mbuf *om = ble_hs_mbuf_from_flat(buffer, length);
+    if (om == nullptr) {
+        return false;
+    }
+    return (ble_gattc_notify_custom(connectionHandle, pCharacteristic->getHandle(), om) != BLE_HS_ENOMEM); // Frees om
 }
 
-void DashioBLE::sendMessage(const String& message) {
-    if (isConnected()) {
-        int maxMessageLength = NimBLEDevice::getMTU() - 3;
-        
-        if (message.length() <= maxMessageLength) {
-            bleNotifyValue(message);
-        } else {
-            int messageLength = message.length();
-            int numFullStrings = messageLength / maxMessageLength;
-    
-            String subStr((char *)0);
-            subStr.reserve(maxMessageLength);
-            
-            int start = 0;
-            for (unsigned int i = 0; i < numFullStrings; i++) {
-                subStr = message.substring(start, start + maxMessageLength);
-                bleNotifyValue(subStr);
-                start += maxMessageLength;
+void DashioBLE::queueMessage(BLEclientHolder& client, const String& message) {
+    bool queued;
+    if (client.compactPeer && client.txCodec.enabled()) {
+        queued = client.txCodec.write(*client.sendQueue, message.c_str(), message.length());
+    } else {
+        queued = client.sendQueue->write(message);
+    }
+    if (!queued) {
+        droppedCount++;
+        ESP_LOGI(DTAG, "BLE send queue full, handle: %d", client.connectionHandle);
+    }
+}
+
+// Sends as much of the client's queue as the stack will take, topping the queue up from a config download in progress
+void DashioBLE::sendQueued(BLEclientHolder& client) {
+    size_t maxLength = pServer->getPeerMTU(client.connectionHandle) - 3;
+    if ((maxLength < 20) || (maxLength > BLE_MAX_SEND_MESSAGE_LENGTH)) {
+        maxLength = NimBLEDevice::getMTU() - 3;
+    }
+
+    char block[BLE_MAX_SEND_MESSAGE_LENGTH];
+    while (true) {
+        if ((client.configOffset >= 0) && (client.sendQueue->space() >= maxLength + COMPACT_FRAME_OVERHEAD)) {
+            const char *chunk;
+            int length = dashioDevice->getC64ConfigChunk(&chunk, client.configOffset, maxLength);
+            if (length > 0) {
+                if (client.compactPeer && client.txCodec.enabled()) {
+                    client.txCodec.write(*client.sendQueue, chunk, length); // As a literal frame
+                } else {
+                    client.sendQueue->write(chunk, length);
+                }
+                client.configOffset += length;
+            } else {
+                client.configOffset = -1;
             }
-            if (start < messageLength) {
-                subStr = message.substring(start);
-                bleNotifyValue(subStr);
+        }
+
+        size_t length = client.sendQueue->peek(block, maxLength);
+        if ((length == 0) || !bleNotifyValue(block, length, client.connectionHandle)) {
+            break;
+        }
+        client.sendQueue->remove(length);
+    }
+}
+
+void DashioBLE::sendMessage(const String& message) {
+    if (isConnected() && (bleClients != nullptr)) {
+        for (int i = 0; i < maxBLEclients; i++) {
+            if (bleClients[i].active) {
+                queueMessage(bleClients[i], message);
             }
         }
     
@@ -855,86 +1304,113 @@ void DashioBLE::sendMessage(const String& message) {
     }
 }
 
-void DashioBLE::processConfig() {
-    sendMessage(dashioDevice->getC64ConfigBaseMessage());
-    
-    int c64Length = strlen_P(dashioDevice->configC64Str);
-    int length = 0;
-    String message = "";
-    for (int k = 0; k < c64Length; k++) {
-        char myChar = pgm_read_byte_near(dashioDevice->configC64Str + k);
+void DashioBLE::sendMessage(const String& message, uint16_t connectionHandle) {
+    if (isConnected() && (bleClients != nullptr)) {
+        for (int i = 0; i < maxBLEclients; i++) {
+            if (bleClients[i].active && (bleClients[i].connectionHandle == connectionHandle)) {
+                queueMessage(bleClients[i], message);
+            }
+        }
 
-        message += myChar;
-        length++;
-        if (length == C64_MAX_LENGHT) {
-            sendMessage(message);
-            message = "";
-            length = 0;
+        if (printMessages) {
+            Serial.print(F("---- BLE Sent to handle: "));
+            Serial.print(connectionHandle);
+            Serial.println(F(" ----"));
+            Serial.println(message);
         }
     }
-    message += String(END_DELIM);
-    sendMessage(message);
 }
 
-void DashioBLE::run() {
-    if (secureBLE && (bleClients != nullptr)) {
+void DashioBLE::processConfig(uint16_t connectionHandle) {
+    sendMessage(dashioDevice->getC64ConfigBaseMessage(), connectionHandle);
+
+    if (bleClients != nullptr) {
         for (int i = 0; i < maxBLEclients; i++) {
-            if (bleClients[i].authState == BLE_AUTH_REQ_CONN) {
-                bleClients[i].authState = BLE_AUTHENTICATED;
-                sendMessage(dashioDevice->getConnectMessage()); /// This wil go to all BLE clients as Arduino NimBLE doesn't yet allow messagein individual clients
-                break; // Remove break when NimBLE can send to specific client/connectionHandle
+            if (bleClients[i].active && (bleClients[i].connectionHandle == connectionHandle)) {
+                bleClients[i].configOffset = 0; // The config itself is streamed from run()
             }
         }
-    }
-    
-    if (data.messageReceived) {
-        data.messageReceived = false;
-        
+
         if (printMessages) {
-            Serial.println(data.getReceivedMessageForPrint(dashioDevice->getControlTypeStr(data.control)));
+            Serial.println(F("---- BLE Sent ----"));
+            Serial.println(F("C64 config"));
         }
-        
-        bool startAuth = false;
-        
-        switch (data.control) {
-            case who:
-                sendMessage(dashioDevice->getWhoMessage());
-                break;
-            case connect:
-                if (secureBLE && (bleClients != nullptr)) {
-                    for (int i = 0; i < maxBLEclients; i++) {
-                        if (bleClients[i].connectionHandle == data.connectionHandle) {
-                            if (bleClients[i].authState == BLE_NOT_AUTH) {
-                                startAuth = true;
-                            }
+    }
+}
+
+void DashioBLE::processMessage(MessageData *data) {
+    if (printMessages) {
+        Serial.println(data->getReceivedMessageForPrint(dashioDevice->getControlTypeStr(data->control)));
+    }
+    
+    bool startAuth = false;
+    
+    switch (data->control) {
+        case who:
+            sendMessage(dashioDevice->getWhoMessage(), data->connectionHandle);
+            break;
+        case connect:
+            if (secureBLE && (bleClients != nullptr)) {
+                for (int i = 0; i < maxBLEclients; i++) {
+                    if (bleClients[i].connectionHandle == data->connectionHandle) {
+                        if (bleClients[i].authState == BLE_NOT_AUTH) {
+                            startAuth = true;
                         }
                     }
                 }
-                if (startAuth) {
-                    NimBLEDevice::startSecurity(data.connectionHandle);
-                } else {
-                    sendMessage(dashioDevice->getConnectMessage());
-                }
-                break;
-            case config:
-                dashioDevice->dashboardID = data.idStr;
-                if (dashioDevice->configC64Str != nullptr) {
-                    processConfig();
-                } else {
-                    if (processBLEmessageCallback != nullptr) {
-                        processBLEmessageCallback(&data);
-                    }
-                }
-                break;
-            default:
+            }
+            if (startAuth) {
+                NimBLEDevice::startSecurity(data->connectionHandle);
+            } else {
+                sendMessage(dashioDevice->getConnectMessage(), data->connectionHandle);
+            }
+            break;
+        case config:
+            dashioDevice->dashboardID = data->idStr;
+            if (dashioDevice->configC64Str != nullptr) {
+                processConfig(data->connectionHandle);
+            } else {
                 if (processBLEmessageCallback != nullptr) {
-                    processBLEmessageCallback(&data);
+                    processBLEmessageCallback(data);
                 }
-                break;
+            }
+            break;
+        case status:
+            if (dashioDevice->hasRegisteredState()) {
+                sendMessage(dashioDevice->getRegisteredStatusMessage(), data->connectionHandle);
+            }
+            if (processBLEmessageCallback != nullptr) {
+                processBLEmessageCallback(data);
+            }
+            break;
+        default:
+            if (!dashioDevice->dispatchMessage(data) && (processBLEmessageCallback != nullptr)) {
+                processBLEmessageCallback(data);
+            }
+            break;
+    }
+}
+
+void DashioBLE::run() {
+    if (bleClients == nullptr) {
+        return;
+    }
+
+    for (int i = 0; i < maxBLEclients; i++) {
+        if (secureBLE && (bleClients[i].authState == BLE_AUTH_REQ_CONN)) {
+            bleClients[i].authState = BLE_AUTHENTICATED;
+            sendMessage(dashioDevice->getConnectMessage(), bleClients[i].connectionHandle);
+        }
+
+        MessageData *data = bleClients[i].data;
+        while (data->nextMessage()) {
+            processMessage(data);
+        }
+
+        if (bleClients[i].active) {
+            sendQueued(bleClients[i]);
         }
     }
-    
-    data.checkBuffer();
 }
 
 void DashioBLE::end() {
@@ -968,6 +1444,13 @@ void DashioBLE::begin(uint32_t _passKey) {
         setPassKey(passKey); // in case passKey was set BEFORE NimBLEDevice::init
     }
 
+    if (compactFraming && (bleClients != nullptr)) {
+        for (int i = 0; i < maxBLEclients; i++) {
+            bleClients[i].txCodec.begin(BLE_COMPACT_BUFFER_SIZE); // Frames that would be bigger go as text
+            bleClients[i].rxCodec.begin(BLE_COMPACT_BUFFER_SIZE); // Holds a frame split across writes
+        }
+    }
+
     // Setup server, service and characteristic
     pServer = NimBLEDevice::createServer();
     pServer->setCallbacks(new ServerCallbacks(this));
@@ -1004,7 +1487,36 @@ bool DashioBLE::isConnected() {
 
 void DashioBLE::initialiseClientHolders() {
     if (bleClients == nullptr) {
-        bleClients = new BLEclientHolder(maxBLEclients);
+        bleClients = new BLEclientHolder[maxBLEclients];
+        for (int i = 0; i < maxBLEclients; i++) {
+            bleClients[i].data = new MessageData(BLE_CONN, INCOMING_BUFFER_SIZE);
+            bleClients[i].sendQueue = new DashSendQueue(BLE_SEND_QUEUE_SIZE);
+        }
+    }
+}
+
+MessageData *DashioBLE::getClientData(uint16_t conn_handle) {
+    if (bleClients != nullptr) {
+        for (int i = 0; i < maxBLEclients; i++) {
+            if (bleClients[i].active && (bleClients[i].connectionHandle == conn_handle)) {
+                return bleClients[i].data;
+            }
+        }
+    }
+    return nullptr;
+}
+
+// Compact frames from the central are decoded into the same MessageData fields as text
+void DashioBLE::receive(uint16_t conn_handle, const char *payload, size_t length) {
+    if (bleClients != nullptr) {
+        for (int i = 0; i < maxBLEclients; i++) {
+            if (bleClients[i].active && (bleClients[i].connectionHandle == conn_handle)) {
+                if (bleClients[i].rxCodec.receive(payload, length, *bleClients[i].data, conn_handle)) { // The message components are stored within the client's connection where the messageReceived flag is set
+                    bleClients[i].compactPeer = true;
+                }
+                return;
+            }
+        }
     }
 }
 
@@ -1040,6 +1552,11 @@ void DashioBLE::setConnectionInactive(uint16_t conn_handle) {
                 bleClients[i].connectionHandle = -1;
                 bleClients[i].active = false;
                 bleClients[i].authState = BLE_NOT_AUTH;
+                bleClients[i].sendQueue->clear();
+                bleClients[i].configOffset = -1;
+                bleClients[i].compactPeer = false; // Text until the next central sends a compact frame
+                bleClients[i].txCodec.reset();
+                bleClients[i].rxCodec.reset();
             }
         }
     }
@@ -1055,7 +1572,38 @@ void DashioBLE::setConnectionAuthState(uint16_t conn_handle, BLEauthState authSt
     }
 }
 
-// -------------------------------------------------------------------------------------
+#endif
 
+// -------------------------------------- Broadcast ------------------------------------
+
+void DashioBroadcast::attachConnection(DashioTCP *_tcpConnection) {
+    tcpConnection = _tcpConnection;
+}
+
+void DashioBroadcast::attachConnection(DashioMQTT *_mqttConnection) {
+    mqttConnection = _mqttConnection;
+}
+
+#ifdef ESP32
+void DashioBroadcast::attachConnection(DashioBLE *_bleConnection) {
+    bleConnection = _bleConnection;
+}
 #endif
+
+void DashioBroadcast::sendMessage(const String& message) {
+    if (tcpConnection != nullptr) {
+        tcpConnection->sendMessage(message);
+    }
+    if (mqttConnection != nullptr) {
+        mqttConnection->sendMessage(message);
+    }
+#ifdef ESP32
+    if (bleConnection != nullptr) {
+        bleConnection->sendMessage(message);
+    }
+#endif
+}
+
+// -------------------------------------------------------------------------------------
+
 #endif
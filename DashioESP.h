@@ -38,6 +38,10 @@
 
 #include <WiFiClientSecure.h>  // Included in the espressif library
 #include <MQTT.h>              // arduino-mqtt library created by Joël Gähwiler.
+// Define DASH_MQTT_OFFLINE_SPILL in the build flags to let the MQTT offline queue spill to a LittleFS file
+#ifdef DASH_MQTT_OFFLINE_SPILL
+    #include <LittleFS.h>      // Included in both ESP libraries
+#endif
 #ifdef ESP8266
     #include <arduino-timer.h>
     #include <ESP8266WiFi.h>   // Included in the 8266 Arduino library
@@ -45,6 +49,7 @@
 #elif ESP32
     #include <WiFi.h>
     #include <esp_wifi.h>
+    #include <lwip/sockets.h> // For select() on the TCP clients
     #include <NimBLEDevice.h>  // ESP32 BLE Arduino library by Neil Kolban. Included in Arduino IDE
     #include <ESPmDNS.h>       // Included in the espressif library
 #endif
@@ -63,22 +68,32 @@
 struct TCPclient {
     WiFiClient client;
     MessageData data = MessageData(TCP_CONN);
+    char *txBuffer = nullptr; // Messages are coalesced here and written in MSS sized blocks
+    uint16_t txLength = 0;
+    unsigned long txStartTime = 0;
 };
 
 class DashioTCP {
 private:
     WiFiServer wifiServer;
     TCPclient *tcpClients = nullptr;
+    DashClientReader clientReader; // Shared, as each client is read until it has nothing waiting
     uint8_t maxTCPclients = 1;
 
     bool checkTCP(int index);
+    void processMessage(uint8_t index);
     void (*processTCPmessageCallback)(MessageData *messageData) = nullptr;
     void processConfig(uint16_t index);
+    void sendBuffer(const char *buffer, size_t length, uint8_t index);
+    void flushClient(uint8_t index);
 
 public:
     DashioDevice *dashioDevice = nullptr;
     bool printMessages = false;
     uint16_t tcpPort = 5650;
+    uint16_t flushWindowMs = 0; // 0 writes everything sent during a run() cycle at the end of the next run()
+    unsigned long txByteCount = 0;
+    unsigned long txSegmentCount = 0; // Writes to the clients
     uint8_t hasClient();
 
     DashioTCP(DashioDevice *_dashioDevice, bool _printMessages = false, uint16_t _tcpPort = 5650, uint8_t _maxTCPclients = 1);
@@ -87,6 +102,7 @@ public:
     void begin();
     void sendMessage(const String& message, uint8_t index);
     void sendMessage(const String& message);
+    void flush();
     void setupmDNSservice(const String& id);
     void startupServer();
     void run();
@@ -109,15 +125,40 @@ private:
     static MessageData data;
     WiFiClientSecure wifiClient;
     MQTTClient mqttClient;
-    unsigned long lastSentMessageTime;
-    String mqttSendBuffer = ((char *)0);
-    int mqttBuffersize = 0;
-    int mqttConnectCount = 0;
+    DashMQTTTopics mqttTopics;
+    DashMessageBatch dataBatch;
+    DashMessageBatch announceBatch;
+    unsigned long batchLatencyMs = 0;
+    unsigned long lastPublishTime = 0;
+    DashOfflineQueue offlineQueue;
+    char *replayBuffer = nullptr;
+    unsigned long lastReplayTime = 0;
+#ifdef DASH_MQTT_OFFLINE_SPILL
+    unsigned int spillCount = 0;
+    size_t spillReadOffset = 0;
+    bool spillStopped = false; // A write to the spill file failed part way
+#endif
+    MQTTConnectStep connectStep = connectDNS;
+    DashBackoff connectBackoff;
+    DashCompactCodec txCodec;
+    static DashCompactCodec rxCodec;
+    static bool compactPeer;
     char *username = nullptr;
     char *password = nullptr;
     void (*processMQTTmessageCallback)(MessageData *messageData) = nullptr;
-    void checkAndSendMQTTbuffer();
-    void publishMessage(const String& message, MQTTTopicType topic);
+    DashMessageBatch *getBatch(MQTTTopicType topic);
+    void publishBatch(DashMessageBatch& batch, MQTTTopicType topic);
+    void publishDueBatches();
+    bool publishBuffer(const char *buffer, int length, MQTTTopicType topic);
+    void publishFailed(const char *buffer, size_t length, MQTTTopicType topic, unsigned int numMessages);
+    void storeOffline(const char *message, size_t length, MQTTTopicType topic);
+    void replayOffline();
+    bool allocateReplayBuffer();
+#ifdef DASH_MQTT_OFFLINE_SPILL
+    bool spillOldest();
+    void countSpilled();
+    void replaySpilled();
+#endif
     void processConfig();
 #ifdef ESP32
     TaskHandle_t mqttConnectTaskHandle; // Don't really need to keep this as it's not being used.
@@ -125,7 +166,7 @@ private:
 
     static void messageReceivedMQTTCallback(MQTTClient *client, char *topic, char *payload, int payload_length);
     void onConnected();
-    void hostConnect();
+    void advanceConnect();
     void setupLWT();
 #ifdef ESP32
     static void checkConnectionTask(void * parameter);
@@ -143,10 +184,26 @@ public:
     bool wifiSetInsecure = true;
     MQTTstate state = notReady;
     bool esp32_mqtt_blocking = true;
+    unsigned long publishCount = 0;  // MQTT publishes, each of which may carry several batched messages
+    unsigned long batchedCount = 0;  // Messages that went out as part of a batch
+    unsigned long droppedCount = 0;  // Messages lost because the publish failed and they couldn't be held offline
+#ifdef DASH_MQTT_OFFLINE_SPILL
+    bool offlineSpill = false;       // Spill the offline queue to a LittleFS file when RAM is full. Call LittleFS.begin() first
+#endif
+    bool compactFraming = false;     // Answer a peer that sends compact frames in compact frames. Set before begin()
 
     DashioMQTT(DashioDevice *_dashioDevice, bool _sendRebootAlarm = false, bool _printMessages = false);
     DashioMQTT(DashioDevice *_dashioDevice, bool _sendRebootAlarm, bool _printMessages, int _mqttBufferSize);
     void setup(char *_username, char *_password);
+    void setBatching(unsigned int maxLength, unsigned long maxLatencyMs = 1000);
+    void setOfflineQueue(unsigned int size);
+    void flush();
+#ifdef DASH_MQTT_OFFLINE_SPILL
+    unsigned int offlineDepth() {return offlineQueue.depth() + spillCount;}
+#else
+    unsigned int offlineDepth() {return offlineQueue.depth();}
+#endif
+    unsigned long offlineDroppedCount() {return offlineQueue.droppedCount;}
     void addDashStore(ControlType controlType, String controlID = "");
     void sendMessage(const String& message, MQTTTopicType topic = data_topic);
     void sendAlarmMessage(const String& message);
@@ -172,6 +229,12 @@ struct BLEclientHolder {
     uint16_t connectionHandle = 65535;
     bool active = false;
     BLEauthState authState = BLE_NOT_AUTH;
+    MessageData *data = nullptr; // Each central gets its own parse state
+    DashSendQueue *sendQueue = nullptr; // and its own outgoing notifications
+    int configOffset = -1; // Position of a C64 config download in progress
+    DashCompactCodec txCodec;
+    DashCompactCodec rxCodec;
+    bool compactPeer = false; // The central has sent a compact frame on this connection, so reply in them
 };
 
 class DashioBLE {
@@ -182,22 +245,27 @@ private:
     NimBLEAdvertising *pAdvertising = nullptr;
     
     void initialiseClientHolders();
-    void bleNotifyValue(const String& message);
-    void processConfig();
+    bool bleNotifyValue(const char *buffer, size_t length, uint16_t connectionHandle);
+    void queueMessage(BLEclientHolder& client, const String& message);
+    void sendQueued(BLEclientHolder& client);
+    void processConfig(uint16_t connectionHandle);
+    void processMessage(MessageData *data);
     
 public:
     DashioDevice *dashioDevice = nullptr;
     static bool printMessages;
-    MessageData data;
     void (*processBLEmessageCallback)(MessageData *messageData) = nullptr;
     static uint32_t passKey;
 
     static BLEclientHolder *bleClients;
     static uint8_t maxBLEclients;
+    bool compactFraming = false; // Answer a central that sends compact frames in compact frames. Set before begin()
+    unsigned long droppedCount = 0; // Messages lost because a central's send queue was full
     
     DashioBLE(DashioDevice *_dashioDevice, bool _printMessages = false);
     DashioBLE(DashioDevice *_dashioDevice, bool _printMessages, uint8_t _maxBLEclients);
     void sendMessage(const String& message);
+    void sendMessage(const String& message, uint16_t connectionHandle);
     void run();
     void end();
     void setCallback(void (*processIncomingMessage)(MessageData *messageData));
@@ -207,6 +275,8 @@ public:
     bool isConnected();
     void setPassKey(uint32_t _passKey);
 
+    static MessageData *getClientData(uint16_t conn_handle);
+    static void receive(uint16_t conn_handle, const char *payload, size_t length);
     static bool setConnectionActive(uint16_t conn_handle);
     static void setConnectionInactive(uint16_t conn_handle);
     static void setConnectionAuthState(uint16_t conn_handle, BLEauthState authState);
@@ -263,6 +333,27 @@ public:
     void run();
 };
 
+// -------------------------------------- Broadcast ------------------------------------
+
+// Sends one message to every attached connection: all TCP clients, the MQTT data topic and all BLE centrals.
+// The message is built once by the sketch and passed by reference, so each connection only adds its own framing
+class DashioBroadcast {
+private:
+    DashioTCP *tcpConnection = nullptr;
+    DashioMQTT *mqttConnection = nullptr;
+#ifdef ESP32
+    DashioBLE *bleConnection = nullptr;
+#endif
+
+public:
+    void attachConnection(DashioTCP *_tcpConnection);
+    void attachConnection(DashioMQTT *_mqttConnection);
+#ifdef ESP32
+    void attachConnection(DashioBLE *_bleConnection);
+#endif
+    void sendMessage(const String& message);
+};
+
 // -------------------------------------------------------------------------------------
 
 #endif
@@ -23,6 +23,9 @@
 */
 
 #include "DashioJSON.h"
+#include "Dashio.h"
+
+#define JSON_NUMBER_BUFFER_LEN 48 // Enough for any float to three decimal places
 
 void DashJSON::start() {
     jsonStr = "{";
@@ -32,7 +35,8 @@ void DashJSON::addKeyString(const String& key, const String& text, bool last) {
     jsonStr += "\"";
     jsonStr += key;
     jsonStr += "\":\"";
-    jsonStr += text;
+    DashStringPrint out(jsonStr);
+    DashJSONWriter::writeEscaped(out, text.c_str(), text.length());
     jsonStr += "\"";
     nextChar(last);
 }
@@ -49,9 +53,10 @@ void DashJSON::addKeyStringArray(const String& key, String items[], int numItems
     jsonStr += "\"";
     jsonStr += key;
     jsonStr += "\":[";
+    DashStringPrint out(jsonStr);
     for (int i = 0; i < numItems; i++) {
         jsonStr += "\"";
-        jsonStr += items[i];
+        DashJSONWriter::writeEscaped(out, items[i].c_str(), items[i].length());
         jsonStr += "\"";
         if (i < numItems - 1) {
             jsonStr += ",";
@@ -65,11 +70,11 @@ void DashJSON::addKeyFloat(const String& key, float number, bool last) {
     jsonStr += "\"";
     jsonStr += key;
     jsonStr += "\":";
-    char numberBuffer[9];
+    char numberBuffer[JSON_NUMBER_BUFFER_LEN];
 #ifdef ARDUINO_ARCH_AVR
     dtostrf(number, 5, 3, numberBuffer);
 #else
-    sprintf(numberBuffer, "%5.3f", number);
+    snprintf(numberBuffer, sizeof(numberBuffer), "%5.3f", number);
 #endif
     jsonStr += numberBuffer;
     nextChar(last);
@@ -102,3 +107,172 @@ void DashJSON::nextChar(bool last) {
         jsonStr += ",";
     }
 }
+
+/* --------------- */
+DashJSONWriter::DashJSONWriter(Print& _out) : out(_out) {
+}
+
+void DashJSONWriter::startValue() {
+    if (afterKey) {
+        afterKey = false;
+    } else if (depth > 0) {
+        if (hasItems[depth - 1]) {
+            out.print(',');
+        }
+        hasItems[depth - 1] = true;
+    }
+}
+
+void DashJSONWriter::startContainer(char open) {
+    startValue();
+    if (depth >= JSON_MAX_DEPTH) {
+        overflowed = true;
+        return;
+    }
+    out.print(open);
+    hasItems[depth++] = false;
+}
+
+void DashJSONWriter::endContainer(char close) {
+    if ((depth == 0) || overflowed) {
+        overflowed = true;
+        return;
+    }
+    depth--;
+    out.print(close);
+}
+
+void DashJSONWriter::startObject() {
+    startContainer('{');
+}
+
+void DashJSONWriter::endObject() {
+    endContainer('}');
+}
+
+void DashJSONWriter::startArray() {
+    startContainer('[');
+}
+
+void DashJSONWriter::endArray() {
+    endContainer(']');
+}
+
+void DashJSONWriter::key(const char *name) {
+    startValue();
+    out.print('"');
+    out.print(name);
+    out.print(F("\":"));
+    afterKey = true;
+}
+
+void DashJSONWriter::key(const __FlashStringHelper *name) {
+    startValue();
+    out.print('"');
+    out.print(name);
+    out.print(F("\":"));
+    afterKey = true;
+}
+
+void DashJSONWriter::addString(const char *text, size_t length) {
+    startValue();
+    out.print('"');
+    writeEscaped(out, text, length);
+    out.print('"');
+}
+
+// Same as DashJSON, three decimal places. Most values are done with integer arithmetic, except on AVR where double
+// is float, so dtostrf is used. JSON has no NaN or infinity, so those are null
+void DashJSONWriter::addFloat(float number) {
+    startValue();
+    if (!isfinite(number)) {
+        out.print(F("null"));
+        return;
+    }
+    char numberBuffer[JSON_NUMBER_BUFFER_LEN];
+#ifdef ARDUINO_ARCH_AVR
+    dtostrf(number, 1, 3, numberBuffer); // double is float here, so number * 1000 would be rounded before lrint()
+#else
+    if (fabs(number) < 2000000.0) {
+        // Below 2e6 a float times 1000 is exact as a double, so lrint() (ties to even) gives what printf("%.3f") would
+        long scaled = lrint(fabs(number) * 1000.0);
+        if (signbit(number)) {
+            out.print('-'); // Including -0.000, as printf keeps the sign of small negatives
+        }
+        out.print(scaled / 1000);
+        out.print('.');
+        int fraction = scaled % 1000;
+        if (fraction < 100) {
+            out.print('0');
+        }
+        if (fraction < 10) {
+            out.print('0');
+        }
+        out.print(fraction);
+        return;
+    }
+    snprintf(numberBuffer, sizeof(numberBuffer), "%.3f", number);
+#endif
+    out.print(numberBuffer);
+}
+
+void DashJSONWriter::addInt(long number) {
+    startValue();
+    out.print(number);
+}
+
+void DashJSONWriter::addBool(bool boolean) {
+    startValue();
+    if (boolean) {
+        out.print(F("true"));
+    } else {
+        out.print(F("false"));
+    }
+}
+
+void DashJSONWriter::addNull() {
+    startValue();
+    out.print(F("null"));
+}
+
+// Runs of characters that don't need escaping are written in one go
+void DashJSONWriter::writeEscaped(Print& out, const char *text, size_t length) {
+    static const char hexDigits[] = "0123456789abcdef";
+    size_t runStart = 0;
+    for (size_t i = 0; i < length; i++) {
+        uint8_t chr = text[i];
+        if ((chr >= 0x20) && (chr != '"') && (chr != '\\')) {
+            continue;
+        }
+        out.write((const uint8_t *)text + runStart, i - runStart);
+        runStart = i + 1;
+        out.print('\\');
+        switch (chr) {
+            case '"':
+            case '\\':
+                out.print((char)chr);
+                break;
+            case '\n':
+                out.print('n');
+                break;
+            case '\r':
+                out.print('r');
+                break;
+            case '\t':
+                out.print('t');
+                break;
+            case '\b':
+                out.print('b');
+                break;
+            case '\f':
+                out.print('f');
+                break;
+            default:
+                out.print(F("u00"));
+                out.print(hexDigits[chr >> 4]);
+                out.print(hexDigits[chr & 0x0F]);
+                break;
+        }
+    }
+    out.write((const uint8_t *)text + runStart, length - runStart);
+}
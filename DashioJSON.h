@@ -48,4 +48,45 @@ private:
     void nextChar(bool last);
 };
 
+#define JSON_MAX_DEPTH 8
+
+// Writes JSON straight to a Print sink (a message String through DashStringPrint, a DashBufferPrint or a client),
+// so nothing is built up in between. Strings are escaped and commas are worked out from the nesting, so keys and
+// values just need adding in order. Keys are written as they are, so they mustn't need escaping
+class DashJSONWriter {
+public:
+    bool overflowed = false; // Nested more than JSON_MAX_DEPTH deep, or closed more than was opened
+
+    DashJSONWriter(Print& _out);
+    void startObject();
+    void endObject();
+    void startArray();
+    void endArray();
+    void key(const char *name);
+    void key(const __FlashStringHelper *name);
+    void addString(const char *text, size_t length);
+    void addString(const String& text) {addString(text.c_str(), text.length());}
+    void addFloat(float number);
+    void addInt(long number);
+    void addBool(bool boolean);
+    void addNull();
+
+    template<typename K> void addKeyString(K name, const String& text) {key(name); addString(text);}
+    template<typename K> void addKeyFloat(K name, float number) {key(name); addFloat(number);}
+    template<typename K> void addKeyInt(K name, long number) {key(name); addInt(number);}
+    template<typename K> void addKeyBool(K name, bool boolean) {key(name); addBool(boolean);}
+
+    static void writeEscaped(Print& out, const char *text, size_t length);
+
+private:
+    Print& out;
+    uint8_t depth = 0;
+    bool hasItems[JSON_MAX_DEPTH]; // At each level of nesting, so we know when a comma is needed
+    bool afterKey = false;
+
+    void startValue();
+    void startContainer(char open);
+    void endContainer(char close);
+};
+
 #endif
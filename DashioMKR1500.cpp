@@ -1,14 +1,28 @@
 #if defined ARDUINO_SAMD_MKRNB1500
 
-#include "dashiomkr1500.h"
+#include "DashioMKR1500.h"
 
 #define MQTT_BUFFER_SIZE 2048
+#define MQTT_PACKET_OVERHEAD 128 // Fixed header, topic and packet ID share the client buffer with the payload
 #define INCOMING_MQTT_BUFFER_SIZE 512
-
-const int NB_TIMEOUT_MS    = 30000;
+#define MQTT_OFFLINE_QUEUE_SIZE 2048
+
+const int NB_TIMEOUT_MS    = 30000; // Give up on an attach after this long and reset the modem
+const unsigned long LTE_CHECK_INTERVAL_MS = 10000; // Between attach and signal checks while connected
+const unsigned long LTE_AT_TIMEOUT_MS     = 5000;
+const int           LTE_CHECK_FAILURES    = 3;     // Soft reset after this many unanswered checks in a row
+const unsigned long LTE_RESET_WAIT_MS     = 5000;  // Before asking a reset modem whether it's up
+const unsigned long LTE_PROBE_INTERVAL_MS = 1000;
+const unsigned long LTE_RESET_TIMEOUT_MS  = 25000; // Hard reset if the modem isn't up after this long
+const unsigned long LTE_RESET_PULSE_MS    = 1000;  // SARA_RESETN is held high this long for a hard reset
 const int MQTT_QOS         = 2;
-const int MQTT_RETRY_S     = 10; // Retry after 10 seconds
-const int MQTT_RETRY_COUNT = 10; // Retry 10 times
+const int MQTT_RETRY_COUNT = 10; // Reset the modem after 10 failed connects
+const unsigned long MQTT_RETRY_MIN_MS = 5000;  // Backoff between connect attempts doubles from here ...
+const unsigned long MQTT_RETRY_MAX_MS = 60000; // ... up to here
+const unsigned long MQTT_STEP_TIMEOUT_MS = 500;      // Wait for CONNACK or SUBACK in a connect step starts here ...
+const unsigned long MQTT_STEP_TIMEOUT_MAX_MS = 4000; // ... and doubles after each failed attempt, for slow links, up to here
+const int MQTT_COMMAND_TIMEOUT_MS = 10000;           // Wait for QoS acknowledgements once connected
+const unsigned long MQTT_REPLAY_INTERVAL_MS = 250; // Between replayed messages, so a backlog doesn't flood the modem
 
 // ---------------------------------------- LTE ----------------------------------------
 
@@ -35,7 +49,9 @@ void DashioLTE::begin(const char* _pin, const char* _apn, const char* _username,
     pinMode(SARA_RESETN, OUTPUT); // Allow hard reset
 
     nbAccess.setTimeout(NB_TIMEOUT_MS);
+    MODEM.begin(true); // Restart the modem once here, in setup. The supervisor handles it from run() after this
     scannerNetworks.begin();
+    setState(lteAttach);
 
     timer.every(1000, onTimerCallback); // 1000ms
 }
@@ -48,9 +64,9 @@ String DashioLTE::getDeviceID() {
     return "IMEI:" + modem.getIMEI();
 }
 
+// The value from the last periodic check, so this never waits on the modem
 int DashioLTE::getSignalStrength() {
-    String signalStrength = scannerNetworks.getSignalStrength();
-    return signalStrength.toInt();
+    return signalStrength;
 }
 
 bool DashioLTE::onTimerCallback(void *argument) {
@@ -58,104 +74,236 @@ bool DashioLTE::onTimerCallback(void *argument) {
     return true; // to repeat the timer action - false to stop
 }
 
-void DashioLTE::resetCellModem() {
-    cellConnected = false;
+void DashioLTE::setState(LTEstate newState) {
+    state = newState;
+    stateStartTime = millis();
+}
 
-    MODEM.send("AT+CFUN=15");
-    MODEM.waitForResponse(5000);
-    delay(5000);
-    
-    int waitCounter = 0;
-    do {
-        delay(1000);
-        if (printMessages) {
-            Serial.print(".");
+void DashioLTE::sendCommand(const char *command) {
+    modemResponse = "";
+    MODEM.setResponseDataStorage(&modemResponse);
+    MODEM.send(command);
+    pendingCommand = command;
+    commandPending = true;
+    commandStartTime = millis();
+}
+
+// Returns 0 while the command is waiting for a reply, 1 for OK, or more than 1 for an error or a timeout
+int DashioLTE::commandResult(unsigned long timeoutMs) {
+    int ready = MODEM.ready();
+    if (ready == 0) {
+        if (millis() - commandStartTime < timeoutMs) {
+            return 0;
         }
+        ready = 2;
+    }
+    MODEM.setResponseDataStorage(NULL);
+    commandPending = false;
+    return ready;
+}
 
-        waitCounter++;
-        if (waitCounter > 20) {
-//            NVIC_SystemReset(); // processor software reset is not good enough
-            MODEM.hardReset();
-            modemIsReset = true;
-            if (printMessages) {
-                Serial.println("Modem has been HARD reset");
-            }
-            return;
+// Drives the modem as a timed state machine, so no call waits for more than one AT reply:
+// attach -> connected (with periodic checks) -> soft reset -> hard reset -> attach
+void DashioLTE::superviseModem() {
+    switch (state) {
+        case lteAttach:
+            checkAttach();
+            break;
+        case lteAttaching:
+            checkAttaching();
+            break;
+        case lteConnected:
+            checkConnected();
+            break;
+        case lteSoftReset:
+        case lteHardReset:
+            checkReset();
+            break;
+    }
+}
+
+// nbAccess.begin() starts with MODEM.begin(), whose autosense sends AT and waits up to 10s for the modem to answer.
+// So AT is sent here first, and nbAccess.begin() is only called once the modem has answered it
+void DashioLTE::checkAttach() {
+    if (!commandPending) {
+        sendCommand("AT");
+        return;
+    }
+
+    int result = commandResult(LTE_AT_TIMEOUT_MS);
+    if (result == 0) {
+        return;
+    }
+    if (result != 1) {
+        if (printMessages) {
+            Serial.println(F("Modem not answering - resetting"));
         }
-        
-        MODEM.noop();
-    } while (MODEM.waitForResponse(1000) != 1);
-    modemIsReset = true;
+        startSoftReset();
+        return;
+    }
+
     if (printMessages) {
-        Serial.println("Modem has been reset");
+        Serial.println(F("Connecting to cellular network"));
+    }
+    setState(lteAttaching);
+    if (nbAccess.begin(pin, apn, username, password, false, false) == NB_ERROR) { // last two fields = restartModem, synchronous
+        startSoftReset();
+    }
+}
+
+void DashioLTE::checkAttaching() {
+    int ready = nbAccess.ready();
+    if ((ready == 1) && (nbAccess.status() == NB_READY)) {
+        onAttached();
+    } else if ((ready > 1) || (stateTimeMs() > NB_TIMEOUT_MS)) {
+        if (printMessages) {
+            // enum NB_NetworkStatus_t { NB_ERROR, IDLE, CONNECTING, NB_READY, GPRS_READY, TRANSPARENT_CONNECTED, NB_OFF};
+            Serial.print(F("Failed to connect - resetting modem: Status: "));
+            Serial.println(nbAccess.status());
+        }
+        startSoftReset();
     }
 }
 
-bool DashioLTE::connectToCellNet() {
+void DashioLTE::onAttached() {
+    attachTimeMs = stateTimeMs();
+    cellConnected = true;
+    checkFailures = 0;
+    lastCheckTime = millis() - LTE_CHECK_INTERVAL_MS; // Read the signal strength straight away
+    setState(lteConnected);
+
     if (printMessages) {
-        Serial.println("Connecting to cellular network");
+        Serial.print(F("Cellular network attached in "));
+        Serial.print(attachTimeMs);
+        Serial.println(F("ms"));
+    }
+
+    if (mqttConnection != NULL) {
+        if (mqttConnection->dashioDevice->deviceID == "") {
+            mqttConnection->dashioDevice->setup(getDeviceID());
+        }
+        mqttConnection->begin();
     }
+}
 
-    NB_NetworkStatus_t networkStatus = nbAccess.begin(pin, apn, username, password, true, true); // last two fields = restartModem, synchronous
-    if (networkStatus == NB_READY) {
-        cellConnected = true;
+// Checks the network attach (AT+CGATT?) and then the signal strength (AT+CSQ) each LTE_CHECK_INTERVAL_MS
+void DashioLTE::checkConnected() {
+    if (!commandPending) {
+        if (millis() - lastCheckTime >= LTE_CHECK_INTERVAL_MS) {
+            lastCheckTime = millis();
+            sendCommand("AT+CGATT?");
+        }
+        return;
+    }
 
-        if (printMessages) {
-            Serial.print("Current carrier: ");
-            Serial.println(scannerNetworks.getCurrentCarrier());
-            
-            Serial.print("Signal Strength: ");
-            Serial.print(scannerNetworks.getSignalStrength());
-            Serial.println(" [0-31]");
+    const char *command = pendingCommand;
+    int result = commandResult(LTE_AT_TIMEOUT_MS);
+    if (result == 0) {
+        return;
+    }
+    if (result != 1) {
+        checkFailures++;
+        if (checkFailures >= LTE_CHECK_FAILURES) {
+            if (printMessages) {
+                Serial.println(F("Modem not answering - resetting"));
+            }
+            startSoftReset();
         }
-        
-        return true;
-    } else {
+        return;
+    }
+
+    checkFailures = 0;
+    if (strcmp(command, "AT+CGATT?") == 0) {
+        if (modemResponse.indexOf("+CGATT: 1") >= 0) {
+            sendCommand("AT+CSQ");
+        } else {
+            if (printMessages) {
+                Serial.println(F("No cellular connection"));
+            }
+            cellConnected = false;
+            setState(lteAttach);
+        }
+    } else { // AT+CSQ
+        int start = modemResponse.indexOf("+CSQ: ");
+        if (start >= 0) {
+            signalStrength = modemResponse.substring(start + 6).toInt();
+        }
+    }
+}
+
+void DashioLTE::startSoftReset() {
+    cellConnected = false;
+    commandPending = false;
+    softResetCount++;
+    MODEM.send("AT+CFUN=15");
+    setState(lteSoftReset);
+}
+
+void DashioLTE::startHardReset() {
+    commandPending = false;
+    hardResetCount++;
+    digitalWrite(SARA_RESETN, HIGH); // checkReset() ends the pulse, rather than MODEM.hardReset() waiting out a delay(1000)
+    resetPulse = true;
+    setState(lteHardReset);
+}
+
+// Once the modem has had LTE_RESET_WAIT_MS to restart, sends AT each LTE_PROBE_INTERVAL_MS until it answers
+void DashioLTE::checkReset() {
+    if (resetPulse) {
+        if (stateTimeMs() < LTE_RESET_PULSE_MS) {
+            return;
+        }
+        digitalWrite(SARA_RESETN, LOW);
+        resetPulse = false;
         if (printMessages) {
-            // enum NB_NetworkStatus_t { NB_ERROR, IDLE, CONNECTING, NB_READY, GPRS_READY, TRANSPARENT_CONNECTED, NB_OFF};
-            Serial.print("Failed to connect - resetting modem: Status: ");
-            Serial.println(networkStatus);
+            Serial.println(F("Modem has been HARD reset"));
         }
-        resetCellModem();
     }
 
-    return false;
+    if (commandPending) {
+        int result = commandResult(LTE_PROBE_INTERVAL_MS);
+        if (result == 1) {
+            modemIsReset = true;
+            if (printMessages) {
+                Serial.println(F("Modem has been reset"));
+            }
+            setState(lteAttach);
+            return;
+        }
+        if (result == 0) {
+            return;
+        }
+    }
+
+    if (stateTimeMs() > LTE_RESET_TIMEOUT_MS) {
+        startHardReset(); // processor software reset is not good enough
+    } else if (stateTimeMs() >= LTE_RESET_WAIT_MS) {
+        if (printMessages) {
+            Serial.print(".");
+        }
+        sendCommand("AT");
+    }
 }
 
 void DashioLTE::run() {
     timer.tick();
+    superviseModem();
+
+    if ((state != lteConnected) || commandPending) {
+        return; // Keep the MQTT client off the modem until it's attached and the supervisor's command has been answered
+    }
 
     if (mqttConnection != NULL) {
         mqttConnection->run();
-    }
 
-    if (oneSecond) {
-        oneSecond = false;
-        
-        if (cellConnected) {
-            if (nbAccess.isAccessAlive()) {
-                if (mqttConnection != NULL) {
-                    if (mqttConnection->checkConnection()) {
-                    } else {
-                        mqttRetry++;
-                        if (mqttRetry > MQTT_RETRY_COUNT) {
-                            mqttRetry = 0;
-                            resetCellModem();
-                        }
-                    }
+        if (oneSecond) {
+            oneSecond = false;
+            if (!mqttConnection->checkConnection()) {
+                mqttRetry++;
+                if (mqttRetry > MQTT_RETRY_COUNT) {
+                    mqttRetry = 0;
+                    startSoftReset();
                 }
-            } else {
-                if (printMessages) {
-                    Serial.println("No cellular connection");
-                }
-                cellConnected = false;
-            }
-        } else {
-            if (connectToCellNet()) {
-                if (mqttConnection->dashioDevice->deviceID == "") {
-                    mqttConnection->dashioDevice->setup(getDeviceID());
-                }
-                mqttConnection->begin();
             }
         }
     }
@@ -163,31 +311,159 @@ void DashioLTE::run() {
 
 // ---------------------------------------- MQTT ---------------------------------------
 
-DashioMQTT::DashioMQTT(DashioDevice *_dashioDevice, bool _sendRebootAlarm, bool _printMessages) : mqttClient(MQTT_BUFFER_SIZE) {
+DashioMQTT::DashioMQTT(DashioDevice *_dashioDevice, bool _sendRebootAlarm, bool _printMessages) : mqttClient(MQTT_BUFFER_SIZE), offlineQueue(MQTT_OFFLINE_QUEUE_SIZE), connectBackoff(MQTT_RETRY_MIN_MS, MQTT_RETRY_MAX_MS) {
     dashioDevice = _dashioDevice;
     sendRebootAlarm  = _sendRebootAlarm;
     printMessages = _printMessages;
 }
 
 MessageData DashioMQTT::data(MQTT_CONN, INCOMING_MQTT_BUFFER_SIZE);
+DashCompactCodec DashioMQTT::rxCodec;
+bool DashioMQTT::compactPeer = false;
 
 void DashioMQTT::messageReceivedMQTTCallback(MQTTClient *client, char *topic, char *payload, int payload_length) {
-    data.processMessage(String(payload)); // The message components are stored within the connection where the messageReceived flag is set
+    if (DashCompactCodec::isCompact(payload, payload_length)) {
+        String message((char *)0);
+        if (rxCodec.decode(payload, payload_length, message)) {
+            compactPeer = true; // The peer understands compact frames, so reply in them
+        }
+        data.processMessage(message.c_str(), message.length());
+        return;
+    }
+    data.processMessage(payload, payload_length); // The message components are stored within the connection where the messageReceived flag is set
+}
+
+// Batches data and announce messages into publishes of up to maxLength bytes (capped to fit the MQTT client buffer),
+// saving a cellular round trip per message. A batch is published when it's full, or maxLatencyMs after its first
+// message. maxLength of 0 turns batching off
+void DashioMQTT::setBatching(unsigned int maxLength, unsigned long maxLatencyMs) {
+    flush();
+    if (maxLength > MQTT_BUFFER_SIZE - MQTT_PACKET_OVERHEAD) {
+        maxLength = MQTT_BUFFER_SIZE - MQTT_PACKET_OVERHEAD;
+    }
+    if (!dataBatch.begin(maxLength) || !announceBatch.begin(maxLength)) {
+        dataBatch.begin(0);
+        announceBatch.begin(0);
+    }
+    batchLatencyMs = maxLatencyMs;
+}
+
+DashMessageBatch *DashioMQTT::getBatch(MQTTTopicType topic) {
+    switch (topic) {
+        case data_topic:
+            return dataBatch.enabled() ? &dataBatch : nullptr;
+        case announce_topic:
+            return announceBatch.enabled() ? &announceBatch : nullptr;
+        default:
+            return nullptr;
+    }
 }
 
 void DashioMQTT::sendMessage(const String& message, MQTTTopicType topic) {
-    if (mqttClient.connected()) {
-        String publishTopic = dashioDevice->getMQTTTopic(username, topic);
-        mqttClient.publish(publishTopic.c_str(), message.c_str(), false, MQTT_QOS);
+    bool offlineTopic = (topic == data_topic) || (topic == alarm_topic);
+    if (offlineTopic && (!mqttClient.connected() || (offlineQueue.depth() > 0))) {
+        storeOffline(message.c_str(), message.length(), topic); // Behind anything still waiting to be replayed
+        return;
+    }
 
-        if (printMessages) {
-            Serial.print(F("---- MQTT Sent ---- Topic: "));
-            Serial.println(publishTopic);
-            Serial.println(message);
+    DashMessageBatch *batch = getBatch(topic);
+    if ((batch == nullptr) || !mqttClient.connected()) {
+        if (!publishBuffer(message.c_str(), message.length(), topic)) {
+            publishFailed(message.c_str(), message.length(), topic, 1);
+        }
+        return;
+    }
+
+    if (!batch->fits(message.length())) {
+        publishBatch(*batch, topic);
+    }
+    if (!batch->add(message.c_str(), message.length())) {
+        if (!publishBuffer(message.c_str(), message.length(), topic)) { // Bigger than a whole batch, so send it on its own
+            publishFailed(message.c_str(), message.length(), topic, 1);
+        }
+    } else if (millis() - lastPublishTime >= batchLatencyMs) {
+        publishBatch(*batch, topic); // Nothing sent recently, so don't hold the message back
+    }
+}
+
+void DashioMQTT::publishBatch(DashMessageBatch& batch, MQTTTopicType topic) {
+    if (batch.length() > 0) {
+        if (publishBuffer(batch.c_str(), batch.length(), topic)) {
+            batchedCount += batch.messageCount();
+        } else {
+            publishFailed(batch.c_str(), batch.length(), topic, batch.messageCount());
         }
+        batch.clear();
+    }
+}
+
+// Data and alarm messages are held for replay. Anything else is lost
+void DashioMQTT::publishFailed(const char *buffer, size_t length, MQTTTopicType topic, unsigned int numMessages) {
+    if ((topic == data_topic) || (topic == alarm_topic)) {
+        storeOffline(buffer, length, topic);
+    } else {
+        droppedCount += numMessages;
+    }
+}
+
+void DashioMQTT::storeOffline(const char *message, size_t length, MQTTTopicType topic) {
+    if (length == 0) {
+        return;
+    }
+    if (!offlineQueue.fitsEmpty(length)) {
+        offlineQueue.droppedCount++;
+        return;
+    }
+    while (!offlineQueue.store(topic, message, length)) {
+        offlineQueue.dropOldest(); // Lose the oldest rather than the newest
     }
 }
 
+// Publishes one held message each MQTT_REPLAY_INTERVAL_MS, oldest first
+void DashioMQTT::replayOffline() {
+    if ((offlineQueue.depth() == 0) || (millis() - lastReplayTime < MQTT_REPLAY_INTERVAL_MS)) {
+        return;
+    }
+    lastReplayTime = millis();
+
+    if (replayBuffer == nullptr) {
+        replayBuffer = new char[MQTT_BUFFER_SIZE]; // Once, the first time there's anything to replay
+        if (replayBuffer == nullptr) {
+            return;
+        }
+    }
+    MQTTTopicType topic;
+    size_t length = offlineQueue.peek(&topic, replayBuffer, MQTT_BUFFER_SIZE - 1);
+    if (length == 0) {
+        offlineQueue.dropOldest(); // Too big for the MQTT client to publish
+        return;
+    }
+    replayBuffer[length] = '\0';
+    if (publishBuffer(replayBuffer, length, topic)) {
+        offlineQueue.remove();
+    }
+}
+
+// Holds up to size bytes of data and alarm messages while MQTT is offline. Call before begin(), as any messages
+// already held are lost
+void DashioMQTT::setOfflineQueue(unsigned int size) {
+    offlineQueue.begin(size);
+}
+
+void DashioMQTT::publishDueBatches() {
+    if (dataBatch.isDue(batchLatencyMs)) {
+        publishBatch(dataBatch, data_topic);
+    }
+    if (announceBatch.isDue(batchLatencyMs)) {
+        publishBatch(announceBatch, announce_topic);
+    }
+}
+
+void DashioMQTT::flush() {
+    publishBatch(dataBatch, data_topic);
+    publishBatch(announceBatch, announce_topic);
+}
+
 void DashioMQTT::sendAlarmMessage(const String& message) {
     sendMessage(message, alarm_topic);
 }
@@ -197,26 +473,45 @@ void DashioMQTT::sendWhoAnnounce() {
 }
 
 void DashioMQTT::processConfig() {
-    sendMessage(dashioDevice->getC64ConfigBaseMessage());
-    
-    int c64Length = strlen_P(dashioDevice->configC64Str);
-    int length = 0;
-    String message = "";
-    for (int k = 0; k < c64Length; k++) {
-        char myChar = pgm_read_byte_near(dashioDevice->configC64Str + k);
-
-        message += myChar;
-        length++;
-        if (length == (MQTT_BUFFER_SIZE / 2)) {
-            sendMessage(message);
-            message = "";
-            length = 0;
-        }
+    publishBatch(dataBatch, data_topic); // Keep message order
+    String message = dashioDevice->getC64ConfigBaseMessage();
+    publishBuffer(message.c_str(), message.length(), data_topic);
+
+    const char *chunk;
+    unsigned int offset = 0;
+    int length;
+    while ((length = dashioDevice->getC64ConfigChunk(&chunk, offset, MQTT_BUFFER_SIZE / 2)) > 0) {
+        publishBuffer(chunk, length, data_topic);
+        offset += length;
     }
-    if (message.length() > 0) {
-        sendMessage(message);
+}
+
+bool DashioMQTT::publishBuffer(const char *buffer, int length, MQTTTopicType topic) {
+    if (mqttClient.connected()) {
+        const char *publishTopic = mqttTopics.getTopic(username, dashioDevice->deviceID, topic);
+        const char *payload = buffer;
+        int payloadLength = length;
+        if (compactPeer && (topic == data_topic) && txCodec.enabled()) {
+            txCodec.reset(); // Each publish carries its deviceID, as a subscriber can join the topic at any time
+            size_t frameLength = txCodec.encode(buffer, length);
+            if (frameLength > 0) { // Otherwise send the text, which the peer can still read
+                payload = txCodec.frames();
+                payloadLength = frameLength;
+            }
+        }
+        if (mqttClient.publish(publishTopic, payload, payloadLength, false, MQTT_QOS)) {
+            publishCount++;
+            lastPublishTime = millis();
+
+            if (printMessages) {
+                Serial.print(F("---- MQTT Sent ---- Topic: "));
+                Serial.println(publishTopic);
+                Serial.println(buffer);
+            }
+            return true;
+        }
     }
-    sendMessage(String('\n'));
+    return false;
 }
 
 void DashioMQTT::addDashStore(ControlType controlType, String controlID) {
@@ -241,14 +536,14 @@ void DashioMQTT::addDashStore(ControlType controlType, String controlID) {
 void DashioMQTT::setupLWT() {
     // Setup MQTT Last Will and Testament message (Optional). Default keep alive time is 10s
 
-    String willTopic = dashioDevice->getMQTTTopic(username, will_topic);
+    const char *willTopic = mqttTopics.getTopic(username, dashioDevice->deviceID, will_topic);
     if (printMessages) {
         Serial.print(F("LWT topic: "));
         Serial.println(willTopic);
     }
 
     String offlineMessage = dashioDevice->getOfflineMessage();
-    mqttClient.setWill(willTopic.c_str(), offlineMessage.c_str(), false, MQTT_QOS);
+    mqttClient.setWill(willTopic, offlineMessage.c_str(), false, MQTT_QOS);
     if (printMessages) {
         Serial.print(F("LWT message: "));
         Serial.println(offlineMessage);
@@ -267,21 +562,37 @@ void DashioMQTT::setup(const char *_username, const char *_password) {
 
 void DashioMQTT::begin() {
     mqttClient.begin(mqttHost, mqttPort, nbsslCLient);
-    mqttClient.setOptions(10, true, 10000);  // 10s timeout
+    mqttClient.setOptions(10, true, MQTT_COMMAND_TIMEOUT_MS);
     mqttClient.onMessageAdvanced(messageReceivedMQTTCallback);
   
     setupLWT(); // Once the deviceID is known
+    if (compactFraming) {
+        txCodec.begin(MQTT_BUFFER_SIZE - MQTT_PACKET_OVERHEAD); // Frames that would be bigger go as text
+    }
     state = disconnected;
 }
 
 void DashioMQTT::onConnected() {
-    // Subscribe to private MQTT connection
-    String subscriberTopic = dashioDevice->getMQTTSubscribeTopic(username);
-    mqttClient.subscribe(subscriberTopic.c_str(), MQTT_QOS); // ... and subscribe
+    compactPeer = false; // Text until the peer sends a compact frame on this connection
+    txCodec.reset();
+    rxCodec.reset();
 
     // Send MQTT ONLINE and WHO messages to connection (Optional)
     // WHO is only required here if using the Dash server and it must be send to the ANNOUNCE topic
-    sendMessage(dashioDevice->getOnlineMessage());
+    // ONLINE and the reboot alarm are published straight away, ahead of any replay of messages held while offline
+    String message = dashioDevice->getOnlineMessage();
+    if (!publishBuffer(message.c_str(), message.length(), data_topic)) {
+        publishFailed(message.c_str(), message.length(), data_topic, 1);
+    }
+    if (reboot) {
+        reboot = false;
+        if (sendRebootAlarm) {
+            message = dashioDevice->getAlarmMessage("ALX", "System Reboot", dashioDevice->name);
+            if (!publishBuffer(message.c_str(), message.length(), alarm_topic)) {
+                publishFailed(message.c_str(), message.length(), alarm_topic, 1);
+            }
+        }
+    }
     sendMessage(dashioDevice->getWhoMessage(), announce_topic); // Update announce topic with new name
     
     if (dashStore != nullptr) {
@@ -289,58 +600,81 @@ void DashioMQTT::onConnected() {
             sendMessage(dashioDevice->getDataStoreEnableMessage(dashStore[i]), announce_topic);
         }
     }
-    
-    if (reboot) {
-        reboot = false;
-        if (sendRebootAlarm) {
-            sendAlarmMessage(dashioDevice->getAlarmMessage("ALX", "System Reboot", dashioDevice->name));
-        }
-    }
 }
 
-void DashioMQTT::hostConnect() {
-    if (printMessages) {
-        Serial.print(F("Connecting to MQTT..."));
+// Makes one step of the connect per call (TLS, CONNECT then SUBSCRIBE). The TLS step waits on the modem, which
+// resolves the host name itself and times the socket out. CONNECT and SUBSCRIBE block for at most the step timeout,
+// which starts at a few hundred ms and doubles after each failed attempt. Failed attempts are backed off
+void DashioMQTT::advanceConnect() {
+    bool stepOK = false;
+    unsigned long stepTimeoutMs = connectBackoff.getTimeoutMs(MQTT_STEP_TIMEOUT_MS, MQTT_STEP_TIMEOUT_MAX_MS);
+    switch (connectStep) {
+        case connectDNS:
+        case connectTLS:
+            nbsslCLient.stop();
+            stepOK = nbsslCLient.connect(mqttHost, mqttPort);
+            break;
+        case connectMQTT:
+            mqttClient.setTimeout(stepTimeoutMs); // Wait for CONNACK
+            stepOK = mqttClient.connect(dashioDevice->deviceID.c_str(), username, password, true); // skip = true, as the TLS connection is already up
+            break;
+        case connectSubscribe:
+            mqttClient.setTimeout(stepTimeoutMs); // Wait for SUBACK
+            stepOK = mqttClient.subscribe(mqttTopics.getTopic(username, dashioDevice->deviceID, control_topic), MQTT_QOS);
+            break;
     }
-    state = connecting;
-    if (mqttClient.connect(dashioDevice->deviceID.c_str(), username, password, false)) { // skip = false is the default. Used in order to establish and verify TLS connections manually before giving control to the MQTT client
-        if (printMessages) {
-            Serial.print(F("connected "));
-            Serial.println(String(mqttClient.returnCode()));
-        }
-        state = serverConnected;
-    } else {
+
+    if (!stepOK) {
+        connectBackoff.failed();
+        connectFailed = true;
         if (printMessages) {
-            Serial.print(F("Failed - Try again in 10 seconds. E = "));
+            Serial.print(F("MQTT connect failed at step "));
+            Serial.print(connectStep);
+            Serial.print(F(" - Try again in "));
+            Serial.print(connectBackoff.getWaitMs() / 1000);
+            Serial.print(F("s. E = "));
             Serial.println(String(mqttClient.lastError()) + "  R = " + mqttClient.returnCode());
             // Invalid URL or port => E = -3  R = 0
             // Invalid username or password => E = -10  R = 5
             // Invalid SSL record => E = -5  R = 6
         }
+        nbsslCLient.stop();
         state = disconnected;
+    } else if (connectStep == connectSubscribe) {
+        if (printMessages) {
+            Serial.print(F("MQTT connected "));
+            Serial.println(String(mqttClient.returnCode()));
+        }
+        mqttClient.setTimeout(MQTT_COMMAND_TIMEOUT_MS);
+        connectBackoff.reset();
+        state = serverConnected;
+    } else {
+        connectStep = (MQTTConnectStep)(connectStep + 1);
     }
 }
 
+// Starts a connect when MQTT is down and the backoff allows. run() then steps through it.
+// Returns false if a connect has failed since the last call
 bool DashioMQTT::checkConnection() {
-    // Check and connect MQTT as necessary
-    if (state == disconnected) {
-        if (mqttConnectCount == 0) {
-            hostConnect();
-        }
-        if (mqttConnectCount >= MQTT_RETRY_S) {
-            mqttConnectCount = 0;
-            return false;
-        } else {
-            mqttConnectCount++;
-            return true;
+    if ((state == disconnected) && connectBackoff.ready()) {
+        if (printMessages) {
+            Serial.println(F("Connecting to MQTT..."));
         }
-    } else if (state == serverConnected) {
-        mqttConnectCount = 0;
-        return true;
+        connectStep = connectTLS;
+        state = connecting;
     }
+
+    bool failed = connectFailed;
+    connectFailed = false;
+    return !failed;
 }
     
 void DashioMQTT::run() {
+    if (state == connecting) {
+        advanceConnect();
+        return;
+    }
+
     if (mqttClient.connected()) {
         mqttClient.loop();
 
@@ -349,9 +683,7 @@ void DashioMQTT::run() {
             state = subscribed;
         }
 
-        if (data.messageReceived) {
-            data.messageReceived = false;
-
+        while (data.nextMessage()) {
             if (printMessages) {
                 Serial.println(data.getReceivedMessageForPrint(dashioDevice->getControlTypeStr(data.control)));
             }
@@ -378,16 +710,25 @@ void DashioMQTT::run() {
                             }
                         }
                         break;
-                    default:
+                    case status:
+                        if (dashioDevice->hasRegisteredState()) {
+                            sendMessage(dashioDevice->getRegisteredStatusMessage());
+                        }
                         if (processMQTTmessageCallback != nullptr) {
                             processMQTTmessageCallback(&data);
                         }
                         break;
+                    default:
+                        if (!dashioDevice->dispatchMessage(&data) && (processMQTTmessageCallback != nullptr)) {
+                            processMQTTmessageCallback(&data);
+                        }
+                        break;
                 }
             }
         }
         
-        data.checkBuffer();
+        publishDueBatches();
+        replayOffline();
     } else {
         if ((state == serverConnected) or (state == subscribed)) {
             state = disconnected;
@@ -397,6 +738,7 @@ void DashioMQTT::run() {
 
 void DashioMQTT::end() {
     sendMessage(dashioDevice->getOfflineMessage());
+    flush();
     mqttClient.disconnect();
 }
 
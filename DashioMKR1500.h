@@ -40,6 +40,13 @@
 #include <arduino-timer.h>
 
 // ---------------------------------------- LTE ----------------------------------------
+enum LTEstate {
+    lteAttach,      // Check the modem answers AT, then start attaching to the network and opening the PDP context
+    lteAttaching,   // Attach in progress, one AT step per run()
+    lteConnected,   // Attached. The attach and signal strength are checked periodically
+    lteSoftReset,   // AT+CFUN=15 sent, waiting for the modem to answer AT again
+    lteHardReset    // Reset pin pulsed, waiting for the modem to answer AT again
+};
 
 class DashioLTE {
 private:
@@ -57,9 +64,26 @@ private:
     static bool oneSecond;
 
     int mqttRetry = 0;
-
-    bool connectToCellNet();
-    void resetCellModem();
+    unsigned long stateStartTime = 0;
+    unsigned long lastCheckTime = 0;
+    int checkFailures = 0;
+    bool commandPending = false;
+    const char *pendingCommand = nullptr;
+    unsigned long commandStartTime = 0;
+    String modemResponse;
+    bool resetPulse = false;
+
+    void superviseModem();
+    void checkAttach();
+    void checkAttaching();
+    void checkConnected();
+    void checkReset();
+    void onAttached();
+    void startSoftReset();
+    void startHardReset();
+    void setState(LTEstate newState);
+    void sendCommand(const char *command);
+    int commandResult(unsigned long timeoutMs);
     static bool onTimerCallback(void *argument);
     
     DashioMQTT *mqttConnection = nullptr;
@@ -67,11 +91,19 @@ private:
 public:
     bool cellConnected = false;
     bool modemIsReset = false;
+    LTEstate state = lteAttach;
+    unsigned long attachTimeMs = 0;    // How long the last successful attach took
+    unsigned int softResetCount = 0;
+    unsigned int hardResetCount = 0;
+    int signalStrength = 99;           // RSSI from the last AT+CSQ, 0 to 31, or 99 if not known
 
     DashioLTE(bool _printMessages = false);
     void attachConnection(DashioMQTT *_mqttConnection);
     String getDeviceID();
     int getSignalStrength();
+    unsigned long stateTimeMs() {return millis() - stateStartTime;}
+    // begin() restarts the modem with MODEM.begin(true), which waits for the modem to come up (several seconds), so
+    // call it from setup(). After that, run() never waits for more than one AT reply
     void begin(const char* _pin = 0);
     void begin(const char* _pin, const char* _apn);
     void begin(const char* _pin, const char* _apn, const char* _username, const char* _password);
@@ -94,16 +126,36 @@ private:
     static MessageData data;
     NBSSLClient nbsslCLient;
     MQTTClient mqttClient;
-    int mqttConnectCount = 0;
+    DashMQTTTopics mqttTopics;
+    DashMessageBatch dataBatch;
+    DashMessageBatch announceBatch;
+    unsigned long batchLatencyMs = 0;
+    unsigned long lastPublishTime = 0;
+    DashOfflineQueue offlineQueue;
+    char *replayBuffer = nullptr;
+    unsigned long lastReplayTime = 0;
+    MQTTConnectStep connectStep = connectTLS;
+    DashBackoff connectBackoff;
+    bool connectFailed = false;
+    DashCompactCodec txCodec;
+    static DashCompactCodec rxCodec;
+    static bool compactPeer;
     bool sendRebootAlarm;
     const char *username;
     const char *password;
     void (*processMQTTmessageCallback)(MessageData *messageData) = nullptr;
     void processConfig();
+    DashMessageBatch *getBatch(MQTTTopicType topic);
+    void publishBatch(DashMessageBatch& batch, MQTTTopicType topic);
+    void publishDueBatches();
+    bool publishBuffer(const char *buffer, int length, MQTTTopicType topic);
+    void publishFailed(const char *buffer, size_t length, MQTTTopicType topic, unsigned int numMessages);
+    void storeOffline(const char *message, size_t length, MQTTTopicType topic);
+    void replayOffline();
 
     static void messageReceivedMQTTCallback(MQTTClient *client, char *topic, char *payload, int payload_length);
     void onConnected();
-    void hostConnect();
+    void advanceConnect();
     void setupLWT();
 
     DashStore *dashStore = nullptr;
@@ -115,9 +167,18 @@ public:
     uint16_t mqttPort = DASH_PORT;
     bool passThrough = false;
     MQTTstate state = notReady;
+    unsigned long publishCount = 0;  // MQTT publishes, each of which may carry several batched messages
+    unsigned long batchedCount = 0;  // Messages that went out as part of a batch
+    unsigned long droppedCount = 0;  // Messages lost because the publish failed and they couldn't be held offline
+    bool compactFraming = false;     // Answer a peer that sends compact frames in compact frames. Set before begin()
 
     DashioMQTT(DashioDevice *_dashioDevice, bool _sendRebootAlarm = false, bool _printMessages = false);
     void setup(const char *_username, const char *_password);
+    void setBatching(unsigned int maxLength, unsigned long maxLatencyMs = 1000);
+    void setOfflineQueue(unsigned int size);
+    void flush();
+    unsigned int offlineDepth() {return offlineQueue.depth();}
+    unsigned long offlineDroppedCount() {return offlineQueue.droppedCount;}
     void addDashStore(ControlType controlType, String controlID = "");
     void sendMessage(const String& message, MQTTTopicType topic = data_topic);
     void sendAlarmMessage(const String& message);
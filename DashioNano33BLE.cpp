@@ -27,10 +27,14 @@
 #include "DashioNano33BLE.h"
 
 const int BLE_MAX_SEND_MESSAGE_LENGTH = 100;
+const int BLE_SEND_QUEUE_SIZE = 2048;
+const int BLE_COMPACT_BUFFER_SIZE = 256; // Each way, with compactFraming. Longer messages go as text
+const unsigned long BLE_CONFIG_INTERVAL_MS = 200; // Between notifications during a config download, or BLE peripheral can't handle it
 
 DashioBLE::DashioBLE(DashioDevice *_dashioDevice, bool _printMessages) : bleService(SERVICE_UUID),
             bleReadCharacteristic(CHARACTERISTIC_UUID, BLEWriteWithoutResponse, BLE_MAX_SEND_MESSAGE_LENGTH),
-            bleWriteCharacteristic(CHARACTERISTIC_UUID, BLENotify, BLE_MAX_SEND_MESSAGE_LENGTH) {
+            bleWriteCharacteristic(CHARACTERISTIC_UUID, BLENotify, BLE_MAX_SEND_MESSAGE_LENGTH),
+            sendQueue(BLE_SEND_QUEUE_SIZE) {
 
     dashioDevice = _dashioDevice;
     printMessages = _printMessages;
@@ -44,14 +48,17 @@ DashioBLE::DashioBLE(DashioDevice *_dashioDevice, bool _printMessages) : bleServ
 }
 
 MessageData DashioBLE::messageData(BLE_CONN);
+DashCompactCodec DashioBLE::rxCodec;
+bool DashioBLE::compactPeer = false;
 
 void DashioBLE::onReadValueUpdate(BLEDevice central, BLECharacteristic characteristic) {
-    // central wrote new value to characteristic
+    // central wrote new value to characteristic. By length, as a compact frame can hold '\0'
     int dataLength = characteristic.valueLength();
-    char* value = new char[dataLength + 1];  // one byte more, to save the '\0' character!
+    char* value = new char[dataLength];
     characteristic.readValue(value, dataLength);
-    value[dataLength] = '\0';  // make sure to null-terminate!
-    messageData.processMessage(value);
+    if (rxCodec.receive(value, dataLength, messageData)) {
+        compactPeer = true; // The central understands compact frames, so reply in them
+    }
     delete[] value;
 }
 
@@ -60,6 +67,11 @@ void DashioBLE::setCallback(void (*processIncomingMessage)(MessageData *connecti
 }
 
 void DashioBLE::begin() {
+    if (compactFraming) {
+        txCodec.begin(BLE_COMPACT_BUFFER_SIZE); // Frames that would be bigger go as text
+        rxCodec.begin(BLE_COMPACT_BUFFER_SIZE); // Holds a frame split across writes
+    }
+
     if (BLE.begin()) {
         // set advertised local name and service UUID:
         String localName = F("DashIO_");
@@ -84,26 +96,10 @@ void DashioBLE::begin() {
 
 void DashioBLE::sendMessage(const String& message) {
     if (BLE.connected()) {
-        unsigned int maxMessageLength = BLE_MAX_SEND_MESSAGE_LENGTH;
-        
-        if (message.length() <= maxMessageLength) {
-            bleWriteCharacteristic.writeValue(message.c_str());
-        } else {
-            int messageLength = message.length();
-            unsigned int numFullStrings = messageLength / maxMessageLength;
-    
-            String subStr((char *)0);
-            subStr.reserve(maxMessageLength);
-            
-            int start = 0;
-            for (unsigned int i = 0; i < numFullStrings; i++) {
-                subStr = message.substring(start, start + maxMessageLength);
-                bleWriteCharacteristic.writeValue(subStr.c_str());
-                start += maxMessageLength;
-            }
-            if (start < messageLength) {
-                subStr = message.substring(start);
-                bleWriteCharacteristic.writeValue(subStr.c_str());
+        if (!queueBlock(message.c_str(), message.length())) {
+            droppedCount++;
+            if (printMessages) {
+                Serial.println(F("BLE send queue full"));
             }
         }
     
@@ -116,36 +112,50 @@ void DashioBLE::sendMessage(const String& message) {
 
 void DashioBLE::processConfig() {
     sendMessage(dashioDevice->getC64ConfigBaseMessage());
-    
-    int c64Length = strlen_P(dashioDevice->configC64Str);
-    int length = 0;
-    String message = "";
-    for (int k = 0; k < c64Length; k++) {
-        char myChar = pgm_read_byte_near(dashioDevice->configC64Str + k);
-        
-        message += myChar;
-        length++;
-        if (length == 100) {
-            sendMessage(message);
-            delay(200); // or BLE peripheral can't handle it
-            message = "";
-            length = 0;
-        }
+
+    if (BLE.connected()) {
+        configOffset = 0; // The config itself is streamed from run()
+    }
+}
+
+bool DashioBLE::queueBlock(const char *block, size_t length) {
+    if (compactPeer && txCodec.enabled()) {
+        return txCodec.write(sendQueue, block, length); // Config chunks go as literal frames
     }
-    if (message.length() > 0) {
-        sendMessage(message);
-        delay(200); // or BLE peripheral can't handle it
+    return sendQueue.write(block, length);
+}
+
+// Sends one block from the queue per call, topping the queue up from a config download in progress. Blocks up to
+// the end of the config go one each BLE_CONFIG_INTERVAL_MS. Others go straight away, unless the stack refuses them
+void DashioBLE::sendQueued() {
+    if ((configOffset >= 0) && (sendQueue.space() >= BLE_MAX_SEND_MESSAGE_LENGTH + COMPACT_FRAME_OVERHEAD)) {
+        const char *chunk;
+        int length = dashioDevice->getC64ConfigChunk(&chunk, configOffset, BLE_MAX_SEND_MESSAGE_LENGTH);
+        if (length > 0) {
+            queueBlock(chunk, length);
+            configOffset += length;
+            configQueued = sendQueue.available();
+        } else {
+            configOffset = -1;
+        }
     }
 
-    sendMessage(String('\n'));
+    bool paced = (configOffset >= 0) || (configQueued > 0);
+    if ((sendQueue.available() > 0) && (!paced || (millis() - lastSendTime >= BLE_CONFIG_INTERVAL_MS))) {
+        char block[BLE_MAX_SEND_MESSAGE_LENGTH];
+        size_t length = sendQueue.peek(block, BLE_MAX_SEND_MESSAGE_LENGTH);
+        if (bleWriteCharacteristic.BLECharacteristic::writeValue((const uint8_t *)block, length)) {
+            sendQueue.remove(length);
+            configQueued -= min(length, configQueued);
+            lastSendTime = millis();
+        }
+    }
 }
 
 void DashioBLE::run() {
     if (BLE.connected()) {
         BLE.poll(); // Required for event handlers
-        if (messageData.messageReceived) {
-            messageData.messageReceived = false;
-    
+        while (messageData.nextMessage()) {
             if (printMessages) {
                 Serial.println(messageData.getReceivedMessageForPrint(dashioDevice->getControlTypeStr(messageData.control)));
             }
@@ -160,15 +170,30 @@ void DashioBLE::run() {
             case config:
                 processConfig();
                 break;
-            default:
+            case status:
+                if (dashioDevice->hasRegisteredState()) {
+                    sendMessage(dashioDevice->getRegisteredStatusMessage());
+                }
                 if (processBLEmessageCallback != NULL) {
                     processBLEmessageCallback(&messageData);
                 }
                 break;
+            default:
+                if (!dashioDevice->dispatchMessage(&messageData) && (processBLEmessageCallback != NULL)) {
+                    processBLEmessageCallback(&messageData);
+                }
+                break;
             }
         }
         
-        messageData.checkBuffer();
+        sendQueued();
+    } else {
+        sendQueue.clear();
+        configOffset = -1;
+        configQueued = 0;
+        compactPeer = false; // Text until the next central sends a compact frame
+        txCodec.reset();
+        rxCodec.reset();
     }
 }
 
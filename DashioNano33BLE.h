@@ -51,11 +51,23 @@ private:
 
     static void onBLEConnected(BLEDevice central);
     static void onBLEDisconnected(BLEDevice central);
+    DashSendQueue sendQueue;
+    int configOffset = -1; // Position of a C64 config download in progress
+    size_t configQueued = 0; // Bytes in the queue up to the end of the last config chunk
+    unsigned long lastSendTime = 0;
+    DashCompactCodec txCodec;
+    static DashCompactCodec rxCodec;
+    static bool compactPeer;
+
     static void onReadValueUpdate(BLEDevice central, BLECharacteristic characteristic);
     void processConfig();
+    bool queueBlock(const char *block, size_t length);
+    void sendQueued();
 
 public:
     void (*processBLEmessageCallback)(MessageData *connection) = nullptr;
+    bool compactFraming = false; // Answer a central that sends compact frames in compact frames. Set before begin()
+    unsigned long droppedCount = 0; // Messages lost because the send queue was full
 
     DashioBLE(DashioDevice *_dashioDevice, bool _printMessages = false);
     void sendMessage(const String& message);
@@ -29,16 +29,27 @@
 #include <MDNS_Generic.h>
 
 #define INCOMING_BUFFER_SIZE 512
+#define C64_MAX_LENGTH 1000
 
 // WiFi
 const int WIFI_CONNECT_TIMEOUT_MS = 5000; // 5s
 
 // MQTT
 const uint8_t MQTT_QOS     = 2;
-const int     MQTT_RETRY_S = 10; // Retry after 10 seconds
+const unsigned long MQTT_RETRY_MIN_MS = 2000;   // Backoff between connect attempts doubles from here ...
+const unsigned long MQTT_RETRY_MAX_MS = 120000; // ... up to here
+const unsigned long MQTT_STEP_TIMEOUT_MS = 500;      // Wait for CONNACK or SUBACK in a connect step starts here ...
+const unsigned long MQTT_STEP_TIMEOUT_MAX_MS = 4000; // ... and doubles after each failed attempt, for slow links, up to here
+const int MQTT_READ_BUFFER_SIZE = 128;
+
+// TCP
+const int TCP_READ_BUFFER_SIZE = 128;
 
 // BLE
 const int BLE_MAX_SEND_MESSAGE_LENGTH = 100;
+const int BLE_SEND_QUEUE_SIZE = 1024;
+const int BLE_COMPACT_BUFFER_SIZE = 256; // Each way, with compactFraming. Longer messages go as text
+const unsigned long BLE_SEND_INTERVAL_MS = 0; // Between notifications
 
 // mDNS
 WiFiUDP udp;
@@ -160,7 +171,7 @@ String DashioWiFi::ipAddress() {
 
 // ---------------------------------------- TCP ----------------------------------------
 
-DashioTCP::DashioTCP(DashioDevice *_dashioDevice, bool _printMessages, uint16_t _tcpPort) : wifiServer(_tcpPort), mdns(udp), messageData(TCP_CONN) {
+DashioTCP::DashioTCP(DashioDevice *_dashioDevice, bool _printMessages, uint16_t _tcpPort) : wifiServer(_tcpPort), clientReader(TCP_READ_BUFFER_SIZE), mdns(udp), messageData(TCP_CONN) {
     dashioDevice = _dashioDevice;
     tcpPort = _tcpPort;
     printMessages = _printMessages;
@@ -172,7 +183,7 @@ void DashioTCP::setCallback(void (*processIncomingMessage)(MessageData *connecti
 
 void DashioTCP::sendMessage(const String& message) {
     if (client.connected()) {
-        client.print(message);
+        sendBuffer(message.c_str(), message.length());
 
         if (printMessages) {
             Serial.println(F("---- TCP Sent ----"));
@@ -181,6 +192,50 @@ void DashioTCP::sendMessage(const String& message) {
     }
 }
 
+void DashioTCP::processConfig() {
+    sendMessage(dashioDevice->getC64ConfigBaseMessage());
+
+    if (client.connected()) {
+        const char *chunk;
+        unsigned int offset = 0;
+        int length;
+        while ((length = dashioDevice->getC64ConfigChunk(&chunk, offset, C64_MAX_LENGTH)) > 0) {
+            sendBuffer(chunk, length);
+            offset += length;
+        }
+    }
+}
+
+// Adds to the transmit buffer, writing it out whenever it fills
+void DashioTCP::sendBuffer(const char *buffer, size_t length) {
+    if (txLength + length > TCP_TX_BUFFER_SIZE) {
+        flush();
+    }
+    if (length >= TCP_TX_BUFFER_SIZE) { // Too big to buffer, so write straight out
+        client.write((const uint8_t *)buffer, length);
+        txByteCount += length;
+        txSegmentCount++;
+    } else {
+        if (txLength == 0) {
+            txStartTime = millis();
+        }
+        memcpy(txBuffer + txLength, buffer, length);
+        txLength += length;
+    }
+}
+
+// Writes out anything waiting in the transmit buffer now, rather than at the end of the flush window
+void DashioTCP::flush() {
+    if (txLength > 0) {
+        if (client.connected()) {
+            client.write((const uint8_t *)txBuffer, txLength);
+            txByteCount += txLength;
+            txSegmentCount++;
+        }
+        txLength = 0;
+    }
+}
+
 void DashioTCP::begin() {
     wifiServer.begin();
 
@@ -194,6 +249,44 @@ void DashioTCP::begin() {
     mdns.addServiceRecord(service.c_str(), tcpPort, MDNSServiceTCP);
 }
 
+void DashioTCP::processMessage() {
+    if (printMessages) {
+        Serial.println(messageData.getReceivedMessageForPrint(dashioDevice->getControlTypeStr(messageData.control)));
+    }
+
+    switch (messageData.control) {
+    case who:
+        sendMessage(dashioDevice->getWhoMessage());
+        break;
+    case connect:
+        sendMessage(dashioDevice->getConnectMessage());
+        break;
+    case config:
+        dashioDevice->dashboardID = messageData.idStr;
+        if (dashioDevice->configC64Str != NULL) {
+            processConfig();
+        } else {
+            if (processTCPmessageCallback != NULL) {
+                processTCPmessageCallback(&messageData);
+            }
+        }
+        break;
+    case status:
+        if (dashioDevice->hasRegisteredState()) {
+            sendMessage(dashioDevice->getRegisteredStatusMessage());
+        }
+        if (processTCPmessageCallback != NULL) {
+            processTCPmessageCallback(&messageData);
+        }
+        break;
+    default:
+        if (!dashioDevice->dispatchMessage(&messageData) && (processTCPmessageCallback != NULL)) {
+            processTCPmessageCallback(&messageData);
+        }
+        break;
+    }
+}
+
 void DashioTCP::run() {
     mdns.run();
 
@@ -202,39 +295,15 @@ void DashioTCP::run() {
         client.setTimeout(2000);
     } else {
        if (client.connected()) {
-            while (client.available()>0) {
-                char c = client.read();
-                if (messageData.processChar(c)) {
-                    if (printMessages) {
-                        Serial.println(messageData.getReceivedMessageForPrint(dashioDevice->getControlTypeStr(messageData.control)));
-                    }
-      
-                    switch (messageData.control) {
-                    case who:
-                        sendMessage(dashioDevice->getWhoMessage());
-                        break;
-                    case connect:
-                        sendMessage(dashioDevice->getConnectMessage());
-                        break;
-                    case config:
-                        dashioDevice->dashboardID = messageData.idStr;
-                        if (dashioDevice->configC64Str != NULL) {
-                            sendMessage(dashioDevice->getC64ConfigMessage());
-                        } else {
-                            if (processTCPmessageCallback != NULL) {
-                                processTCPmessageCallback(&messageData);
-                            }
-                        }
-                        break;
-                    default:
-                        if (processTCPmessageCallback != NULL) {
-                            processTCPmessageCallback(&messageData);
-                        }
-                        break;
-                    }
-                }
+            while (clientReader.nextMessage(client, messageData)) { // Each read is an SPI transfer to the NINA module, so read in blocks
+                processMessage();
+            }
+
+            if ((txLength > 0) && (millis() - txStartTime >= flushWindowMs)) {
+                flush();
             }
         } else {
+            txLength = 0;
             client.stop();
             client = wifiServer.available();
             client.setTimeout(2000);
@@ -252,24 +321,29 @@ MessageData DashioMQTT::messageData(MQTT_CONN, INCOMING_BUFFER_SIZE);
 WiFiSSLClient DashioMQTT::wifiClient;
 MqttClient DashioMQTT::mqttClient(wifiClient);
 
-DashioMQTT::DashioMQTT(DashioDevice *_dashioDevice, bool _sendRebootAlarm, bool _printMessages) {
+DashioMQTT::DashioMQTT(DashioDevice *_dashioDevice, bool _sendRebootAlarm, bool _printMessages) : connectBackoff(MQTT_RETRY_MIN_MS, MQTT_RETRY_MAX_MS) {
     dashioDevice = _dashioDevice;
     sendRebootAlarm  = _sendRebootAlarm;
     printMessages = _printMessages;
 }
 
 void DashioMQTT::messageReceivedMQTTCallback(int messageSize) {
-    String message;
-    for (int i = 0; i < messageSize; i++) {
-        message += (char)mqttClient.read();
+    // Read in blocks, which the message data reassembles, rather than building a String a byte at a time
+    uint8_t readBuffer[MQTT_READ_BUFFER_SIZE];
+    while (messageSize > 0) {
+        int length = mqttClient.read(readBuffer, min(messageSize, MQTT_READ_BUFFER_SIZE));
+        if (length <= 0) {
+            break;
+        }
+        messageData.processMessage((const char *)readBuffer, length); // The message components are stored within the connection where the messageReceived flag is set
+        messageSize -= length;
     }
-    messageData.processMessage(message); // The message components are stored within the connection where the messageReceived flag is set
 }
 
 
 void DashioMQTT::sendMessage(const String& message, MQTTTopicType topic) {
     if (mqttClient.connected()) {
-        String publishTopic = dashioDevice->getMQTTTopic(username, topic);
+        const char *publishTopic = mqttTopics.getTopic(username, dashioDevice->deviceID, topic);
         mqttClient.beginMessage(publishTopic, message.length(), false, MQTT_QOS, false); // reatined = false, duplicate = false
         mqttClient.print(message);
         mqttClient.endMessage();
@@ -282,6 +356,23 @@ void DashioMQTT::sendMessage(const String& message, MQTTTopicType topic) {
     }
 }
 
+void DashioMQTT::processConfig() {
+    sendMessage(dashioDevice->getC64ConfigBaseMessage());
+
+    if (mqttClient.connected()) {
+        const char *publishTopic = mqttTopics.getTopic(username, dashioDevice->deviceID, data_topic);
+        const char *chunk;
+        unsigned int offset = 0;
+        int length;
+        while ((length = dashioDevice->getC64ConfigChunk(&chunk, offset, C64_MAX_LENGTH)) > 0) {
+            mqttClient.beginMessage(publishTopic, length, false, MQTT_QOS, false); // reatined = false, duplicate = false
+            mqttClient.write((const uint8_t *)chunk, length);
+            mqttClient.endMessage();
+            offset += length;
+        }
+    }
+}
+
 void DashioMQTT::sendAlarmMessage(const String& message) {
     sendMessage(message, alarm_topic);
 }
@@ -291,11 +382,14 @@ void DashioMQTT::sendWhoAnnounce() {
 }
 
 void DashioMQTT::run() {
+    if (connecting) {
+        advanceConnect();
+        return;
+    }
+
     mqttClient.poll();
     if (mqttClient.connected()) {
-        if (messageData.messageReceived) {
-            messageData.messageReceived = false;
-
+        while (messageData.nextMessage()) {
             if (printMessages) {
                 Serial.println(messageData.getReceivedMessageForPrint(dashioDevice->getControlTypeStr(messageData.control)));
             }
@@ -310,71 +404,109 @@ void DashioMQTT::run() {
             case config:
                 dashioDevice->dashboardID = messageData.idStr;
                 if (dashioDevice->configC64Str != NULL) {
-                    sendMessage(dashioDevice->getC64ConfigMessage());
+                    processConfig();
                 } else {
                     if (processMQTTmessageCallback != NULL) {
                         processMQTTmessageCallback(&messageData);
                     }
                 }
                 break;
-            default:
+            case status:
+                if (dashioDevice->hasRegisteredState()) {
+                    sendMessage(dashioDevice->getRegisteredStatusMessage());
+                }
                 if (processMQTTmessageCallback != NULL) {
                     processMQTTmessageCallback(&messageData);
                 }
                 break;
+            default:
+                if (!dashioDevice->dispatchMessage(&messageData) && (processMQTTmessageCallback != NULL)) {
+                    processMQTTmessageCallback(&messageData);
+                }
+                break;
             }
         }
-        
-        messageData.checkBuffer();
     }
 }
 
-void DashioMQTT::hostConnect() { // Non-blocking
-    // Setup MQTT Last Will and Testament message (Optional).
-    String willTopic = dashioDevice->getMQTTTopic(username, will_topic);
-    Serial.print(F("LWT topic: "));
-    Serial.println(willTopic);
-
-    String offlineMessage = dashioDevice->getOfflineMessage();
-    mqttClient.beginWill(willTopic, offlineMessage.length(), true, MQTT_QOS);
-    mqttClient.print(offlineMessage);
-    mqttClient.endWill();
-    Serial.print(F("LWT message: "));
-    Serial.println(offlineMessage);
-    
-    mqttClient.setKeepAliveInterval(10000);
-    mqttClient.setConnectionTimeout(10000);
-    mqttClient.onMessage(messageReceivedMQTTCallback);
-
-    Serial.print(F("Connecting to MQTT..."));
-    mqttClient.setUsernamePassword(username, password);
-    if (mqttClient.connect(mqttHost, mqttPort)) {
-        Serial.println(F("connected"));
-
-        // Subscribe to private MQTT connection
-        String subscriberTopic = dashioDevice->getMQTTSubscribeTopic(username);
-        mqttClient.subscribe(subscriberTopic, MQTT_QOS);
-    
-        // Send MQTT ONLINE and WHO messages to connection (Optional)
-        // WHO is only required here if using the Dash server and it must be send to the ANNOUNCE topic
-        sendMessage(dashioDevice->getOnlineMessage());
-        sendMessage(dashioDevice->getWhoMessage(), announce_topic); // Update announce topic with new name
-
-        if (dashStore != nullptr) {
-            for (int i=0; i<dashStoreSize; i++) { // Announce control for data store on dash server
-                sendMessage(dashioDevice->getDataStoreEnableMessage(dashStore[i]), announce_topic);
-            }
+// Makes one step of the connect per call (DNS, then TLS and CONNECT, then SUBSCRIBE). MqttClient opens the TLS
+// connection itself as part of CONNECT, bounded by the NINA module's socket timeout. The waits for CONNACK and SUBACK
+// start at a few hundred ms and double after each failed attempt. Failed attempts are backed off
+void DashioMQTT::advanceConnect() {
+    bool stepOK = false;
+    unsigned long stepTimeoutMs = connectBackoff.getTimeoutMs(MQTT_STEP_TIMEOUT_MS, MQTT_STEP_TIMEOUT_MAX_MS);
+    MQTTConnectStep nextStep = connectStep;
+    switch (connectStep) {
+        case connectDNS: {
+            IPAddress hostIP;
+            stepOK = (WiFi.hostByName(mqttHost, hostIP) == 1); // Leaves the address in the DNS cache for the connect
+            nextStep = connectMQTT;
+            break;
         }
-        
-        if (reboot) {
-            reboot = false;
-            if (sendRebootAlarm) {
-                sendAlarmMessage(dashioDevice->getAlarmMessage("ALX", "System Reboot", dashioDevice->name));
+        case connectTLS:
+        case connectMQTT: {
+            // Setup MQTT Last Will and Testament message (Optional).
+            const char *willTopic = mqttTopics.getTopic(username, dashioDevice->deviceID, will_topic);
+            String offlineMessage = dashioDevice->getOfflineMessage();
+            mqttClient.beginWill(willTopic, offlineMessage.length(), true, MQTT_QOS);
+            mqttClient.print(offlineMessage);
+            mqttClient.endWill();
+            if (printMessages) {
+                Serial.print(F("LWT topic: "));
+                Serial.println(willTopic);
+                Serial.print(F("LWT message: "));
+                Serial.println(offlineMessage);
             }
+
+            mqttClient.setKeepAliveInterval(10000);
+            mqttClient.setConnectionTimeout(stepTimeoutMs); // Wait for CONNACK, and for SUBACK in the next step
+            mqttClient.onMessage(messageReceivedMQTTCallback);
+            mqttClient.setUsernamePassword(username, password);
+            stepOK = mqttClient.connect(mqttHost, mqttPort);
+            nextStep = connectSubscribe;
+            break;
         }
-    } else {
-        Serial.print(F("Failed - Try again in 10 seconds: "));
+        case connectSubscribe:
+            stepOK = mqttClient.subscribe(mqttTopics.getTopic(username, dashioDevice->deviceID, control_topic), MQTT_QOS);
+            break;
+    }
+
+    if (!stepOK) {
+        connectBackoff.failed();
+        connecting = false;
+        Serial.print(F("MQTT connect failed at step "));
+        Serial.print(connectStep);
+        Serial.print(F(" - Try again in "));
+        Serial.print(connectBackoff.getWaitMs() / 1000);
+        Serial.print(F("s: "));
         Serial.println(mqttClient.connectError());
+    } else if (connectStep == connectSubscribe) {
+        Serial.println(F("MQTT connected"));
+        connectBackoff.reset();
+        connecting = false;
+        onConnected();
+    } else {
+        connectStep = nextStep;
+    }
+}
+
+void DashioMQTT::onConnected() {
+    // Send MQTT ONLINE and WHO messages to connection (Optional)
+    // WHO is only required here if using the Dash server and it must be send to the ANNOUNCE topic
+    sendMessage(dashioDevice->getOnlineMessage());
+    sendMessage(dashioDevice->getWhoMessage(), announce_topic); // Update announce topic with new name
+
+    if (dashStore != nullptr) {
+        for (int i=0; i<dashStoreSize; i++) { // Announce control for data store on dash server
+            sendMessage(dashioDevice->getDataStoreEnableMessage(dashStore[i]), announce_topic);
+        }
+    }
+    
+    if (reboot) {
+        reboot = false;
+        if (sendRebootAlarm) {
+            sendAlarmMessage(dashioDevice->getAlarmMessage("ALX", "System Reboot", dashioDevice->name));
+        }
     }
 }
 
@@ -406,17 +538,12 @@ void DashioMQTT::setup(char *_username, char *_password) {
     password = _password;
 }
 
+// Starts a connect when MQTT is down and the backoff allows. run() then steps through it
 void DashioMQTT::checkConnection() {
-    // Check and connect MQTT as necessary
-    if (!mqttClient.connected()) {
-        if (mqttConnectCount == 0) {
-            hostConnect();
-        }
-        if (mqttConnectCount >= MQTT_RETRY_S) {
-            mqttConnectCount = 0;
-        } else {
-            mqttConnectCount++;
-        }
+    if (!connecting && !mqttClient.connected() && connectBackoff.ready()) {
+        Serial.println(F("Connecting to MQTT..."));
+        connectStep = connectDNS;
+        connecting = true;
     }
 }
 
@@ -430,7 +557,8 @@ void DashioMQTT::end() {
 
 DashioBLE::DashioBLE(DashioDevice *_dashioDevice, bool _printMessages) : bleService(SERVICE_UUID),
             bleReadCharacteristic(CHARACTERISTIC_UUID, BLEWriteWithoutResponse, BLE_MAX_SEND_MESSAGE_LENGTH),
-            bleWriteCharacteristic(CHARACTERISTIC_UUID, BLENotify, BLE_MAX_SEND_MESSAGE_LENGTH) {
+            bleWriteCharacteristic(CHARACTERISTIC_UUID, BLENotify, BLE_MAX_SEND_MESSAGE_LENGTH),
+            sendQueue(BLE_SEND_QUEUE_SIZE) {
                                 
     dashioDevice = _dashioDevice;
     printMessages = _printMessages;
@@ -444,14 +572,17 @@ DashioBLE::DashioBLE(DashioDevice *_dashioDevice, bool _printMessages) : bleServ
 }
 
 MessageData DashioBLE::messageData(BLE_CONN, INCOMING_BUFFER_SIZE);
+DashCompactCodec DashioBLE::rxCodec;
+bool DashioBLE::compactPeer = false;
 
 void DashioBLE::onReadValueUpdate(BLEDevice central, BLECharacteristic characteristic) {
-    // central wrote new value to characteristic
+    // central wrote new value to characteristic. By length, as a compact frame can hold '\0'
     int dataLength = characteristic.valueLength();
-    char value[dataLength + 1];  // one byte more, to save the '\0' character!
+    char value[dataLength + 1]; // Never zero length
     characteristic.readValue(value, dataLength);
-    value[dataLength] = '\0';  // make sure to null-terminate!
-    messageData.processMessage(value);
+    if (rxCodec.receive(value, dataLength, messageData)) {
+        compactPeer = true; // The central understands compact frames, so reply in them
+    }
 }
 
 void DashioBLE::setCallback(void (*processIncomingMessage)(MessageData *connection)) {
@@ -459,6 +590,11 @@ void DashioBLE::setCallback(void (*processIncomingMessage)(MessageData *connecti
 }
 
 void DashioBLE::begin() {
+    if (compactFraming) {
+        txCodec.begin(BLE_COMPACT_BUFFER_SIZE); // Frames that would be bigger go as text
+        rxCodec.begin(BLE_COMPACT_BUFFER_SIZE); // Holds a frame split across writes
+    }
+
     if (BLE.begin()) {
         // set advertised local name and service UUID:
         String localName = F("DashIO_");
@@ -483,26 +619,10 @@ void DashioBLE::begin() {
 
 void DashioBLE::sendMessage(const String& message) {
     if (BLE.connected()) {
-        int maxMessageLength = BLE_MAX_SEND_MESSAGE_LENGTH;
-        
-        if (message.length() <= maxMessageLength) {
-            bleWriteCharacteristic.writeValue(message.c_str());
-        } else {
-            int messageLength = message.length();
-            int numFullStrings = messageLength / maxMessageLength;
-    
-            String subStr((char *)0);
-            subStr.reserve(maxMessageLength);
-            
-            int start = 0;
-            for (unsigned int i = 0; i < numFullStrings; i++) {
-                subStr = message.substring(start, start + maxMessageLength);
-                bleWriteCharacteristic.writeValue(subStr.c_str());
-                start += maxMessageLength;
-            }
-            if (start < messageLength) {
-                subStr = message.substring(start);
-                bleWriteCharacteristic.writeValue(subStr.c_str());
+        if (!queueBlock(message.c_str(), message.length())) {
+            droppedCount++;
+            if (printMessages) {
+                Serial.println(F("BLE send queue full"));
             }
         }
     
@@ -513,12 +633,48 @@ void DashioBLE::sendMessage(const String& message) {
     }
 }
 
+void DashioBLE::processConfig() {
+    sendMessage(dashioDevice->getC64ConfigBaseMessage());
+
+    if (BLE.connected()) {
+        configOffset = 0; // The config itself is streamed from run()
+    }
+}
+
+bool DashioBLE::queueBlock(const char *block, size_t length) {
+    if (compactPeer && txCodec.enabled()) {
+        return txCodec.write(sendQueue, block, length); // Config chunks go as literal frames
+    }
+    return sendQueue.write(block, length);
+}
+
+// Sends one block from the queue each BLE_SEND_INTERVAL_MS, topping the queue up from a config download in progress
+void DashioBLE::sendQueued() {
+    if ((configOffset >= 0) && (sendQueue.space() >= BLE_MAX_SEND_MESSAGE_LENGTH + COMPACT_FRAME_OVERHEAD)) {
+        const char *chunk;
+        int length = dashioDevice->getC64ConfigChunk(&chunk, configOffset, BLE_MAX_SEND_MESSAGE_LENGTH);
+        if (length > 0) {
+            queueBlock(chunk, length);
+            configOffset += length;
+        } else {
+            configOffset = -1;
+        }
+    }
+
+    if ((sendQueue.available() > 0) && (millis() - lastSendTime >= BLE_SEND_INTERVAL_MS)) {
+        char block[BLE_MAX_SEND_MESSAGE_LENGTH];
+        size_t length = sendQueue.peek(block, BLE_MAX_SEND_MESSAGE_LENGTH);
+        if (bleWriteCharacteristic.BLECharacteristic::writeValue((const uint8_t *)block, length)) { // Otherwise the stack is busy, so try again next run()
+            sendQueue.remove(length);
+            lastSendTime = millis();
+        }
+    }
+}
+
 void DashioBLE::run() {
     if (BLE.connected()) {
         BLE.poll(); // Required for event handlers
-        if (messageData.messageReceived) {
-            messageData.messageReceived = false;
-    
+        while (messageData.nextMessage()) {
             if (printMessages) {
                 Serial.println(messageData.getReceivedMessageForPrint(dashioDevice->getControlTypeStr(messageData.control)));
             }
@@ -533,22 +689,36 @@ void DashioBLE::run() {
             case config:
                 dashioDevice->dashboardID = messageData.idStr;
                 if (dashioDevice->configC64Str != NULL) {
-                    sendMessage(dashioDevice->getC64ConfigMessage());
+                    processConfig();
                 } else {
                     if (processBLEmessageCallback != NULL) {
                         processBLEmessageCallback(&messageData);
                     }
                 }
                 break;
-            default:
+            case status:
+                if (dashioDevice->hasRegisteredState()) {
+                    sendMessage(dashioDevice->getRegisteredStatusMessage());
+                }
                 if (processBLEmessageCallback != NULL) {
                     processBLEmessageCallback(&messageData);
                 }
                 break;
+            default:
+                if (!dashioDevice->dispatchMessage(&messageData) && (processBLEmessageCallback != NULL)) {
+                    processBLEmessageCallback(&messageData);
+                }
+                break;
             }
         }
         
-        messageData.checkBuffer();
+        sendQueued();
+    } else {
+        sendQueue.clear();
+        configOffset = -1;
+        compactPeer = false; // Text until the next central sends a compact frame
+        txCodec.reset();
+        rxCodec.reset();
     }
 }
 
@@ -566,6 +736,36 @@ String DashioBLE::macAddress() {
 }
 
 #endif
+// -------------------------------------- Broadcast ------------------------------------
+
+void DashioBroadcast::attachConnection(DashioTCP *_tcpConnection) {
+    tcpConnection = _tcpConnection;
+}
+
+void DashioBroadcast::attachConnection(DashioMQTT *_mqttConnection) {
+    mqttConnection = _mqttConnection;
+}
+
+#if defined ARDUINO_SAMD_NANO_33_IOT || defined ARDUINO_SAMD_MKRWIFI1010
+void DashioBroadcast::attachConnection(DashioBLE *_bleConnection) {
+    bleConnection = _bleConnection;
+}
+#endif
+
+void DashioBroadcast::sendMessage(const String& message) {
+    if (tcpConnection != nullptr) {
+        tcpConnection->sendMessage(message);
+    }
+    if (mqttConnection != nullptr) {
+        mqttConnection->sendMessage(message);
+    }
+#if defined ARDUINO_SAMD_NANO_33_IOT || defined ARDUINO_SAMD_MKRWIFI1010
+    if (bleConnection != nullptr) {
+        bleConnection->sendMessage(message);
+    }
+#endif
+}
+
 // -------------------------------------------------------------------------------------
 
 #endif
@@ -60,6 +60,8 @@
 
 // ---------------------------------------- TCP ----------------------------------------
 
+#define TCP_TX_BUFFER_SIZE 512
+
 class DashioTCP {
 private:
     bool printMessages;
@@ -68,16 +70,28 @@ private:
     uint16_t tcpPort = 5650;
     WiFiClient client;
     WiFiServer wifiServer;
+    DashClientReader clientReader;
+    char txBuffer[TCP_TX_BUFFER_SIZE]; // Messages are coalesced here, as every write is an SPI transfer and a TCP segment
+    uint16_t txLength = 0;
+    unsigned long txStartTime = 0;
 
     WiFiUDP udp;
     MDNS mdns;
 
     void (*processTCPmessageCallback)(MessageData *connection) = nullptr;
+    void processConfig();
+    void processMessage();
+    void sendBuffer(const char *buffer, size_t length);
 
 public:
+    uint16_t flushWindowMs = 0; // 0 writes everything sent during a run() cycle at the end of the next run()
+    unsigned long txByteCount = 0;
+    unsigned long txSegmentCount = 0; // Writes to the client
+
     DashioTCP(DashioDevice *_dashioDevice, bool _printMessages = false, uint16_t _tcpPort = 5650);
     void setCallback(void (*processIncomingMessage)(MessageData *connection));
     void sendMessage(const String& message);
+    void flush();
     void begin();
     void end();
     void run();
@@ -93,7 +107,10 @@ private:
     static MessageData messageData;
     static WiFiSSLClient wifiClient;
     static MqttClient mqttClient;
-    int mqttConnectCount = 0;
+    DashMQTTTopics mqttTopics;
+    bool connecting = false;
+    MQTTConnectStep connectStep = connectDNS;
+    DashBackoff connectBackoff;
     bool sendRebootAlarm;
     char *username;
     char *password;
@@ -103,7 +120,9 @@ private:
     int dashStoreSize = 0;
 
     static void messageReceivedMQTTCallback(int messageSize);
-    void hostConnect();
+    void advanceConnect();
+    void onConnected();
+    void processConfig();
 
 public:
     char *mqttHost = DASH_SERVER;
@@ -158,10 +177,22 @@ private:
 
     static void onBLEConnected(BLEDevice central);
     static void onBLEDisconnected(BLEDevice central);
+    DashSendQueue sendQueue;
+    int configOffset = -1; // Position of a C64 config download in progress
+    unsigned long lastSendTime = 0;
+    DashCompactCodec txCodec;
+    static DashCompactCodec rxCodec;
+    static bool compactPeer;
+
     static void onReadValueUpdate(BLEDevice central, BLECharacteristic characteristic);
+    void processConfig();
+    bool queueBlock(const char *block, size_t length);
+    void sendQueued();
 
 public:
     void (*processBLEmessageCallback)(MessageData *connection) = nullptr;
+    bool compactFraming = false; // Answer a central that sends compact frames in compact frames. Set before begin()
+    unsigned long droppedCount = 0; // Messages lost because the send queue was full
 
     DashioBLE(DashioDevice *_dashioDevice, bool _printMessages = false);
     void sendMessage(const String& message);
@@ -174,6 +205,27 @@ public:
 };
 
 #endif
+// -------------------------------------- Broadcast ------------------------------------
+
+// Sends one message to every attached connection: the TCP client, the MQTT data topic and the BLE central.
+// The message is built once by the sketch and passed by reference, so each connection only adds its own framing
+class DashioBroadcast {
+private:
+    DashioTCP *tcpConnection = nullptr;
+    DashioMQTT *mqttConnection = nullptr;
+#if defined ARDUINO_SAMD_NANO_33_IOT || defined ARDUINO_SAMD_MKRWIFI1010
+    DashioBLE *bleConnection = nullptr;
+#endif
+
+public:
+    void attachConnection(DashioTCP *_tcpConnection);
+    void attachConnection(DashioMQTT *_mqttConnection);
+#if defined ARDUINO_SAMD_NANO_33_IOT || defined ARDUINO_SAMD_MKRWIFI1010
+    void attachConnection(DashioBLE *_bleConnection);
+#endif
+    void sendMessage(const String& message);
+};
+
 // -------------------------------------------------------------------------------------
 #endif
 #endif
@@ -39,23 +39,14 @@ void DashSerial::setCallbacksRxTx(void(*processIncomingMessage)(MessageData *mes
 
 void DashSerial::processConfig() {
     txMessageCallback(dashDevice->getC64ConfigBaseMessage());
-    
-    int c64Length = strlen_P(dashDevice->configC64Str);
-    int length = 0;
-    String message = "";
-    for (int k = 0; k < c64Length; k++) {
-        char myChar = pgm_read_byte_near(dashDevice->configC64Str + k);
-
-        message += myChar;
-        length++;
-        if (length == C64_MAX_LENGHT) {
-            txMessageCallback(message);
-            message = "";
-            length = 0;
-        }
+
+    const char *chunk;
+    unsigned int offset = 0;
+    int length;
+    while ((length = dashDevice->getC64ConfigChunk(&chunk, offset, C64_MAX_LENGHT)) > 0) {
+        txMessageCallback(chunk); // chunk is NUL terminated
+        offset += length;
     }
-    message += "\n";
-    txMessageCallback(message);
 }
 
 void DashSerial::actOnMessage() {
@@ -86,11 +77,19 @@ void DashSerial::actOnMessage() {
                 txMessageCallback(responseMessage);
             }
             break;
-        default:
+        case status:
+            if (dashDevice->hasRegisteredState() && (txMessageCallback != nullptr)) {
+                txMessageCallback(dashDevice->getRegisteredStatusMessage());
+            }
             if(processRxMessageCallback != nullptr) {
                 processRxMessageCallback(&data);
             }
             break;
+        default:
+            if (!dashDevice->dispatchMessage(&data) && (processRxMessageCallback != nullptr)) {
+                processRxMessageCallback(&data);
+            }
+            break;
     }
 }
 
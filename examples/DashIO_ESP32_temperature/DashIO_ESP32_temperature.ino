@@ -29,6 +29,8 @@
 
 #define PREFS_NAME "dashio"
 #define GRAPH_UPDATE_SECONDS (60 * 10) // Every 10 mins
+#define GRAPH_HISTORY_POINTS 144 // 24 hours of 10 minute averages, kept for dashboards connecting over BLE
+#define GRAPH_BATCH_LENGTH 240 // Max length of each time graph history message
 
 const char configC64Str[] PROGMEM =
 "zZbbbuM2EIZfJdC1GFCijrkjRdIJ1odUUbILLHqhWLQtRJYCWd44G+Sd+gx9sg4lOfFp0W6RFnsRgxwOx5xvZn7nxRiyoXHx9cV4"
@@ -53,6 +55,7 @@ DashDevice dashDevice(DEVICE_TYPE, configC64Str, 2);
 DashBLE  ble_con(&dashDevice, true);
 DashMQTT mqtt_con(&dashDevice, true, true);
 DashWiFi wifi;
+DashBroadcast broadcast; // For messages that go to every connection
 DashProvision dashProvision(&dashDevice);
 
 // Create Control IDs
@@ -66,6 +69,8 @@ const char *GRAPH_ID = "IDTG";
 OneWire oneWire(13); // Temperature sensor connected to pin 13
 DallasTemperature tempSensor(&oneWire);
 
+DashTimeSeries temperatureHistory(GRAPH_ID, "L1", GRAPH_HISTORY_POINTS);
+
 int graphSecondsCounter = 0;
 float temperatureC;
 float tempSum = 0;
@@ -86,9 +91,8 @@ void sendMessage(ConnectionType connectionType, String message) {
     }
 }
 
-void sendMessageAll(String message) {
-    mqtt_con.sendMessage(message);
-    ble_con.sendMessage(message);
+void sendMessageAll(const String& message) {
+    broadcast.sendMessage(message);
 }
 
 void onProvisionCallback(ConnectionType connectionType, const String& message, bool commsChanged) {
@@ -116,48 +120,55 @@ String getButtonMessages() {
     return message;
 }
 
-void processStatus(MessageData *messageData) {
+void processStatus(MessageData *messageData) { // The alarm text boxes are registered with their state, so are sent automatically
     String message = getButtonMessages();
 
-    message += dashDevice.getTextBoxMessage(ALARMTB_LOW_ID, String(minTemp));
-    message += dashDevice.getTextBoxMessage(ALARMTB_HIGH_ID, String(maxTemp));
-
     message += dashDevice.getTextBoxMessage(TEMPTB_ID, String(temperatureC));
 
     message += dashDevice.getTimeGraphLine(GRAPH_ID, "L1", "Avge Temp", line, "red", yLeft);
 
     sendMessage(messageData->connectionType, message);
+
+    if (messageData->connectionType == BLE_CONN) { // The dash server keeps the history for MQTT
+        sendGraphHistory();
+    }
 }
 
-void processButton(MessageData *messageData) {
-    dashProvision.preferences.begin(PREFS_NAME, false);
-    if (messageData->idStr == AEB_LOW_ID) {
-        if (alarmEnableLow == on) {
-            alarmEnableLow = off;
-        } else {
-            alarmEnableLow = on;
-        }
-        dashProvision.preferences.putBool("AlmEnLow", alarmEnableLow);
-    } else if (messageData->idStr == AEB_HIGH_ID) {
-        if (alarmEnableHigh == on) {
-            alarmEnableHigh = off;
-        } else {
-            alarmEnableHigh = on;
-        }
-        dashProvision.preferences.putBool("AlmEnHigh", alarmEnableHigh);
+void sendGraphHistory() {
+    String message((char *)0);
+    uint16_t offset = 0;
+    uint16_t numSamples;
+    while ((numSamples = dashDevice.addTimeGraphLineSeries(message, temperatureHistory, offset, GRAPH_BATCH_LENGTH)) > 0) {
+        ble_con.sendMessage(message);
+        message = "";
+        offset += numSamples;
     }
+}
+
+// Handlers for the controls registered with dashDevice in setup()
+void processAlarmLowButton(MessageData *messageData) {
+    alarmEnableLow = !alarmEnableLow;
+    dashProvision.preferences.begin(PREFS_NAME, false);
+    dashProvision.preferences.putBool("AlmEnLow", alarmEnableLow);
     dashProvision.preferences.end();
 }
 
-void processTextBox(MessageData *messageData) {
+void processAlarmHighButton(MessageData *messageData) {
+    alarmEnableHigh = !alarmEnableHigh;
     dashProvision.preferences.begin(PREFS_NAME, false);
-    if (messageData->idStr == ALARMTB_LOW_ID) {
-        minTemp = (messageData->payloadStr).toFloat();
-        dashProvision.preferences.putFloat("MinTemp", minTemp);
-    } else if (messageData->idStr == ALARMTB_HIGH_ID) {
-        maxTemp = (messageData->payloadStr).toFloat();
-        dashProvision.preferences.putFloat("MaxTemp", maxTemp);
-    }
+    dashProvision.preferences.putBool("AlmEnHigh", alarmEnableHigh);
+    dashProvision.preferences.end();
+}
+
+void saveMinTemp(MessageData *messageData) { // minTemp has already been updated from the message
+    dashProvision.preferences.begin(PREFS_NAME, false);
+    dashProvision.preferences.putFloat("MinTemp", minTemp);
+    dashProvision.preferences.end();
+}
+
+void saveMaxTemp(MessageData *messageData) {
+    dashProvision.preferences.begin(PREFS_NAME, false);
+    dashProvision.preferences.putFloat("MaxTemp", maxTemp);
     dashProvision.preferences.end();
 }
 
@@ -166,11 +177,10 @@ void processIncomingMessage(MessageData *messageData) {
     case status:
         processStatus(messageData);
         break;
-    case textBox:
-        processTextBox(messageData);
-        break;
-    case button:
-        processButton(messageData);
+    case timeGraph:
+        if (messageData->connectionType == BLE_CONN) {
+            sendGraphHistory();
+        }
         break;
     default:
         dashProvision.processMessage(messageData);
@@ -192,6 +202,11 @@ void setTemperatureEverySecond(float temperature) {
             float tempFiltered = tempSum / GRAPH_UPDATE_SECONDS;
             messageToSend += dashDevice.getTimeGraphPoint(GRAPH_ID, "L1", tempFiltered);
 
+            time_t now = time(nullptr);
+            if (now > 1600000000) { // Only keep history once the clock has been set from NTP
+                temperatureHistory.addSample(now, tempFiltered);
+            }
+
             String text = "The temperature is " + String(tempFiltered) + "°C";
             if (alarmEnableLow == on) {
                 if (tempFiltered < minTemp) {
@@ -216,7 +231,10 @@ void setTemperatureEverySecond(float temperature) {
     messageToSend += getButtonMessages();
     messageToSend += dashDevice.getTextBoxMessage(ALARMTB_LOW_ID, String(minTemp));
     messageToSend += dashDevice.getTextBoxMessage(ALARMTB_HIGH_ID, String(maxTemp));
-    sendMessageAll(messageToSend);
+    messageToSend = dashDevice.getChangedMessages(messageToSend);
+    if (messageToSend.length() > 0) {
+        sendMessageAll(messageToSend);
+    }
 }
 
 void oneSecondTimerTask(void *parameters) {
@@ -258,6 +276,11 @@ void setup() {
     dashProvision.load(&defaultDeviceData, &onProvisionCallback);
 
     dashDevice.setup(wifi.macAddress()); // unique deviceID
+    dashDevice.enableDeltaCache(8); // Only send controls that have changed, or haven't been sent for a minute
+    dashDevice.registerControl(button, AEB_LOW_ID, processAlarmLowButton);
+    dashDevice.registerControl(button, AEB_HIGH_ID, processAlarmHighButton);
+    dashDevice.registerControl(textBox, ALARMTB_LOW_ID, saveMinTemp, &minTemp);
+    dashDevice.registerControl(textBox, ALARMTB_HIGH_ID, saveMaxTemp, &maxTemp);
     
     ble_con.setCallback(&processIncomingMessage);
     ble_con.begin();
@@ -265,11 +288,16 @@ void setup() {
     mqtt_con.setup(dashProvision.dashUserName, dashProvision.dashPassword);
     mqtt_con.setCallback(&processIncomingMessage);
     mqtt_con.addDashStore(timeGraph, GRAPH_ID);
+
+    broadcast.attachConnection(&ble_con);
+    broadcast.attachConnection(&mqtt_con);
         
     wifi.attachConnection(&mqtt_con);
     wifi.begin(dashProvision.wifiSSID, dashProvision.wifiPassword);
 
     generalSetup();
+    temperatureHistory.setLine("Avge Temp", line, "red", yLeft);
+    configTime(0, 0, "pool.ntp.org"); // UTC, for the time graph history
 
     // Setup 1 second timer task for measuring the temperature (overkill)
     xTaskCreate(
@@ -23,26 +23,17 @@ void DashioBluefruit_BLE::sendMessage(const String& writeStr) {
 
 void DashioBluefruit_BLE::processConfig() {
     sendMessage(dashioDevice->getC64ConfigBaseMessage());
-    
-    int c64Length = strlen_P(dashioDevice->configC64Str);
-    int length = 0;
-    String message = "";
-    for (int k = 0; k < c64Length; k++) {
-        char myChar = pgm_read_byte_near(dashioDevice->configC64Str + k);
 
-        message += myChar;
-        length++;
-        if (length == 100) {
-            sendMessage(message);
-            message = "";
-            length = 0;
+    if (bluefruit.isConnected()) {
+        const char *chunk;
+        unsigned int offset = 0;
+        int length;
+        while ((length = dashioDevice->getC64ConfigChunk(&chunk, offset, 100)) > 0) {
+            bluefruit.write((const uint8_t *)chunk, length);
+            bluefruit.flush();
+            offset += length;
         }
     }
-    if (message.length() > 0) {
-        sendMessage(message);
-    }
-
-    sendMessage(String('\n'));
 }
 
 void DashioBluefruit_BLE::run() {
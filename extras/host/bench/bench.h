@@ -0,0 +1,31 @@
+/*
+ Minimal benchmark harness for the host build. Each benchmark runs its body state.iterations times; the runner
+ picks the iteration count, times the run and reads the allocation counters from the shim around it.
+*/
+
+#ifndef DashioBench_h
+#define DashioBench_h
+
+#include "Arduino.h"
+
+struct BenchState {
+    unsigned long iterations;
+};
+
+typedef void (*BenchFunction)(BenchState& state);
+
+struct BenchRegistration {
+    BenchRegistration(const char *name, BenchFunction function);
+};
+
+#define BENCH(fn) \
+    static void fn(BenchState& state); \
+    static BenchRegistration fn##Registration(#fn, fn); \
+    static void fn(BenchState& state)
+
+// Stops the compiler optimising away a result that is otherwise unused
+template<typename T> inline void benchKeep(const T& value) {
+    asm volatile("" : : "g"(&value) : "memory");
+}
+
+#endif
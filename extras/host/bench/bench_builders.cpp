@@ -0,0 +1,246 @@
+/*
+ Outgoing message builders: every DashioDevice get* and add* function, each building a fresh String per op as an
+ application's loop() does.
+*/
+
+#include "bench.h"
+#include "Dashio.h"
+
+static const char benchConfigC64[] PROGMEM =
+    "lVTLbtswEPwVQ2fVsB07bXSzHScxbMuGrKQtih4YaWMTphiBohoHgf+9S1JPyylcQEC0nNnl7OzSn46/8L1vP7r2uWpMuo5re7Ml/gn9e2IFtl/aCtCwHvEo6DXu/PfQUn9Wfr9whMLq0qpOm5OmdS6PYt9lbXiS7ANNDXk6Mv0lq3OKpS7GxwArHxDtIhkSuyE1MbLM31CNHCllMtJ7fiLBuC9K2Bpp6m9fa4FCNTQ8J4bt0HQWZ96ZSrmLsc+VIMKxwhCNS8DQDGo4skqW4NGfWjkSrqXlxHYFO0HeU4UEX2jeazvMDtHDY7d+1PSbc1Fx4KKqb0kjXTXYxqphaW0mU0cHtuQrO9Xj6M/pHK0ZIFfWWCk1LUP6hQtXyvG+P/G/YbzbkE+G1o+7T66Mgl7dFjWNHYgSNAI8pSlP+v2+17XoNtH1pkndDN4sNsHrgkSmYHTd+x4P2ka08H3Wc5o2VYxtZMfpKbxsqL84mkRGGpXjbSo/WXnvMcfVk9DwmMs7XeWEafJvyDLyaDrTerRotFNcqhcW9xRLUFeIXqRUwVA4pe3I87dNnHQ7k+UtwmP6XDtr4JexYtEtQeMsRjlNwrnq6a+n9ijpGwgWbO/1XXTRGHe/d92Nvkz+C6XVYvHLFqU/bPGxc52Yz6ZgYrXy7SLnrzu++FvWkcfNa/3ORAcWv8PdpZHT4jbXT7uHDFtx0qymkLfH3X8NT/lkWDzpkq+Yn+d04E++1yx4TnTJtS8GD+uQ9EbjCHnlBPCCQ2/b0hhOWtWxk7ZU8E8N3YqY+FDQgKsN4y7uHuVvavpS/c6vKWVqJPh4UaXF4NwdBpcCoxBuUsgAgwMyMbpdaOgM3vLk5vBtpkkdl8Z0Q1P4xK1L/gIegzNfoNGi0mxaWUFGqAowfRdR5X98rCeg6F1z1KCkrsdGdqjm9L2+aX0IszN6XBbkr3a/dbr0k5mBr1K5zFwLanMncM6Q+aOv4dFLJQQC7oK8zGS6RyHqX+vxLuk4DScqTW7BbJcqlaiC6ZgEt3iY8/8UXSBPumWrr4G6fn+MHA6CJ/Ib3vzaGJP8D";
+
+
+#define GET_BENCH(fn, expression) \
+    BENCH(fn) { \
+        DashioDevice& device = benchDevice(); \
+        for (unsigned long i = 0; i < state.iterations; i++) { \
+            String message = expression; \
+            benchKeep(message); \
+        } \
+    }
+
+#define ADD_BENCH(fn, statement) \
+    BENCH(fn) { \
+        DashioDevice& device = benchDevice(); \
+        for (unsigned long i = 0; i < state.iterations; i++) { \
+            String message((char *)0); \
+            statement; \
+            benchKeep(message); \
+        } \
+    }
+
+static String selectionItems[] = {"Off", "Low", "Medium", "High", "Turbo"};
+static String eventLines[] = {"Door opened", "Front entrance"};
+static Event events[] = {{"2024-06-01T10:00:00Z", "red", eventLines, 2}, {"2024-06-01T10:05:00Z", "blue", eventLines, 1}};
+static Waypoint waypoints[] = {
+    {"2024-06-01T10:00:00Z", "-43.53", "172.63", "1.5", "2.0", "90", "12", "100"},
+    {"2024-06-01T10:01:00Z", "-43.54", "172.64", "1.6", "2.1", "92", "13", "180"}
+};
+static const Notification alarm = {"alarm1", "Over temperature", "Boiler is running hot"};
+static const DashStore dashStore = {timeGraph, "graph1"};
+
+static int intData[32];
+static float floatData[32];
+static bool boolData[32];
+static time_t timeData[32];
+static String timeStrings[32];
+static float arrData[4] = {1.5f, 2.25f, -3.125f, 400.5f};
+static float *lineDataArr[32];
+
+static void initData() {
+    for (int i = 0; i < 32; i++) {
+        intData[i] = i * 37 - 500;
+        floatData[i] = i * 3.7f - 50.25f;
+        boolData[i] = i & 1;
+        timeData[i] = 1717236000 + i * 60;
+        timeStrings[i] = "2024-06-01T10:00:00Z";
+        lineDataArr[i] = arrData;
+    }
+}
+
+static DashioDevice& benchDevice() {
+    static DashioDevice device("BENCH", benchConfigC64, 1);
+    static bool setupDone = false;
+    if (!setupDone) {
+        device.setup("ABC123", "Bench Device");
+        initData();
+        setupDone = true;
+    }
+    return device;
+}
+
+// Device messages
+GET_BENCH(getWhoMessage, device.getWhoMessage())
+GET_BENCH(getConnectMessage, device.getConnectMessage())
+GET_BENCH(getClockMessage, device.getClockMessage())
+GET_BENCH(getDeviceNameMessage, device.getDeviceNameMessage())
+GET_BENCH(getWifiUpdateAckMessage, device.getWifiUpdateAckMessage())
+GET_BENCH(getTCPUpdateAckMessage, device.getTCPUpdateAckMessage())
+GET_BENCH(getDashioUpdateAckMessage, device.getDashioUpdateAckMessage())
+GET_BENCH(getMQTTUpdateAckMessage, device.getMQTTUpdateAckMessage())
+GET_BENCH(getResetDeviceMessage, device.getResetDeviceMessage())
+GET_BENCH(getOnlineMessage, device.getOnlineMessage())
+GET_BENCH(getOfflineMessage, device.getOfflineMessage())
+GET_BENCH(getDataStoreEnableMessage, device.getDataStoreEnableMessage(dashStore))
+GET_BENCH(getAlarmMessage, device.getAlarmMessage("alarm1", "Over temperature", "Boiler is running hot"))
+GET_BENCH(getAlarmMessageNotification, device.getAlarmMessage(alarm))
+GET_BENCH(getRegisteredStatusMessage, device.getRegisteredStatusMessage())
+GET_BENCH(getControlTypeStr, device.getControlTypeStr(timeGraph))
+GET_BENCH(getMQTTSubscribeTopic, device.getMQTTSubscribeTopic("user"))
+GET_BENCH(getMQTTTopic, device.getMQTTTopic("user", data_topic))
+GET_BENCH(getC64ConfigBaseMessage, device.getC64ConfigBaseMessage())
+GET_BENCH(getC64ConfigMessage, device.getC64ConfigMessage())
+
+// Control messages
+GET_BENCH(getButtonMessage, device.getButtonMessage("button1"))
+GET_BENCH(getButtonMessageState, device.getButtonMessage("button1", true, "lightbulb", "On"))
+GET_BENCH(getTextBoxMessage, device.getTextBoxMessage("text1", "Hello world", "red"))
+GET_BENCH(getTextBoxCaptionMessage, device.getTextBoxCaptionMessage("text1", "Caption", "red"))
+GET_BENCH(getSelectorMessage, device.getSelectorMessage("selector1"))
+GET_BENCH(getSelectorMessageIndex, device.getSelectorMessage("selector1", 2))
+GET_BENCH(getSelectorMessageItems, device.getSelectorMessage("selector1", 2, selectionItems, 5))
+GET_BENCH(getSelectorMessageString, device.getSelectorMessage("selector1", 2, "Off\tLow\tHigh"))
+GET_BENCH(getSliderMessageInt, device.getSliderMessage("slider1", 42))
+GET_BENCH(getSliderMessageFloat, device.getSliderMessage("slider1", 42.5f))
+GET_BENCH(getSliderMessage, device.getSliderMessage("slider1"))
+GET_BENCH(getSingleBarMessageInt, device.getSingleBarMessage("bar1", 42))
+GET_BENCH(getSingleBarMessageFloat, device.getSingleBarMessage("bar1", 42.5f))
+GET_BENCH(getSingleBarMessage, device.getSingleBarMessage("bar1"))
+GET_BENCH(getDoubleBarMessageInt, device.getDoubleBarMessage("bar2", 42, 17))
+GET_BENCH(getDoubleBarMessageFloat, device.getDoubleBarMessage("bar2", 42.5f, 17.25f))
+GET_BENCH(getDoubleBarMessage, device.getDoubleBarMessage("bar2"))
+GET_BENCH(getKnobMessageInt, device.getKnobMessage("knob1", 42))
+GET_BENCH(getKnobMessageFloat, device.getKnobMessage("knob1", 0.75f))
+GET_BENCH(getKnobMessage, device.getKnobMessage("knob1"))
+GET_BENCH(getKnobDialMessageInt, device.getKnobDialMessage("knob1", 42))
+GET_BENCH(getKnobDialMessageFloat, device.getKnobDialMessage("knob1", 0.75f))
+GET_BENCH(getKnobDialMessage, device.getKnobDialMessage("knob1"))
+GET_BENCH(getDialMessageInt, device.getDialMessage("dial1", 42))
+GET_BENCH(getDialMessageFloat, device.getDialMessage("dial1", 1013.25f))
+GET_BENCH(getDialMessage, device.getDialMessage("dial1"))
+GET_BENCH(getDirectionMessageInt, device.getDirectionMessage("dir1", 270, 12.5f))
+GET_BENCH(getDirectionMessageFloat, device.getDirectionMessage("dir1", 270.5f, 12.5f))
+GET_BENCH(getDirectionMessage, device.getDirectionMessage("dir1"))
+GET_BENCH(getMapWaypointMessageString, device.getMapWaypointMessage("map1", "track1", "-43.53", "172.63"))
+GET_BENCH(getMapWaypointMessageFloat, device.getMapWaypointMessage("map1", "track1", -43.53f, 172.63f))
+GET_BENCH(getMapTrackMessage, device.getMapTrackMessage("map1", "track1", "Run", "blue", waypoints, 2))
+GET_BENCH(getColorMessage, device.getColorMessage("color1", "#FF8000"))
+GET_BENCH(getAudioVisualMessage, device.getAudioVisualMessage("av1", "https://example.com/stream"))
+GET_BENCH(getTimeGraphLine, device.getTimeGraphLine("graph1", "line1", "Temperature", line, "red", yLeft))
+GET_BENCH(getTimeGraphPoint, device.getTimeGraphPoint("graph1", "line1", 21.5f))
+GET_BENCH(getTimeGraphPointTime, device.getTimeGraphPoint("graph1", "line1", "2024-06-01T10:00:00Z", 21.5f))
+
+// Appending builders
+ADD_BENCH(addEventLogMessageRows, device.addEventLogMessage(message, "log1", "red", eventLines, 2))
+ADD_BENCH(addEventLogMessageTimeRows, device.addEventLogMessage(message, "log1", "2024-06-01T10:00:00Z", "red", eventLines, 2))
+ADD_BENCH(addEventLogMessageEvents, device.addEventLogMessage(message, "log1", events, 2))
+ADD_BENCH(addChartLineInts32, device.addChartLineInts(message, "chart1", "line1", "Counts", bar, "blue", yLeft, intData, 32))
+ADD_BENCH(addChartLineFloats32, device.addChartLineFloats(message, "chart1", "line1", "Values", line, "blue", yLeft, floatData, 32))
+ADD_BENCH(addTimeGraphLineFloatsStrings32, device.addTimeGraphLineFloats(message, "graph1", "line1", "Temp", line, "red", yLeft, timeStrings, floatData, 32))
+ADD_BENCH(addTimeGraphLineFloatsTimes32, device.addTimeGraphLineFloats(message, "graph1", "line1", "Temp", line, "red", yLeft, timeData, floatData, 32))
+ADD_BENCH(addTimeGraphLineFloatsArr32, device.addTimeGraphLineFloatsArr(message, "graph1", "line1", "Temp", line, "red", yLeft, timeData, lineDataArr, 32, 4))
+ADD_BENCH(addTimeGraphLineBools32, device.addTimeGraphLineBools(message, "graph1", "line1", "State", bln, "red", timeStrings, boolData, 32))
+ADD_BENCH(addTimeGraphPointArr, device.addTimeGraphPointArr(message, "graph1", "line1", arrData, 4))
+ADD_BENCH(addTimeGraphPointArrTime, device.addTimeGraphPointArr(message, "graph1", "line1", "2024-06-01T10:00:00Z", arrData, 4))
+
+BENCH(addTimeGraphLineSeries64) {
+    DashioDevice& device = benchDevice();
+    DashTimeSeries series("graph1", "line1", 64);
+    series.setLine("Temperature", line, "red");
+    for (int i = 0; i < 64; i++) {
+        series.addSample(1717236000 + i * 60, i * 0.5f);
+    }
+    for (unsigned long i = 0; i < state.iterations; i++) {
+        String message((char *)0);
+        device.addTimeGraphLineSeries(message, series);
+        benchKeep(message);
+    }
+}
+
+BENCH(addMapTrackSeries64) {
+    DashioDevice& device = benchDevice();
+    DashGPSTrack track("map1", "track1", 64);
+    for (int i = 0; i < 64; i++) {
+        track.addPoint(1717236000 + i * 60, -43.53 + i * 0.001, 172.63 + i * 0.001, 1.5f, 90);
+    }
+    for (unsigned long i = 0; i < state.iterations; i++) {
+        String message((char *)0);
+        device.addMapTrackSeries(message, track);
+        benchKeep(message);
+    }
+}
+
+// Print based writers into a fixed buffer, as a transport with its own send buffer uses them. The arguments are
+// Strings the sketch already holds, so any allocation counted here is the writer's own
+static String controlID("control1");
+static String lineID("line1");
+static String trackID("track1");
+static String text("Hello world");
+static String color("red");
+static String iconName("lightbulb");
+static String latitude("-43.53");
+static String longitude("172.63");
+static String url("https://example.com/stream");
+static String timeStr("2024-06-01T10:00:00Z");
+static String selectionStr("Off\tLow\tHigh");
+
+#define WRITE_BENCH(fn, statement) \
+    BENCH(fn) { \
+        DashioDevice& device = benchDevice(); \
+        char buffer[2048]; \
+        for (unsigned long i = 0; i < state.iterations; i++) { \
+            DashBufferPrint out(buffer, sizeof(buffer)); \
+            statement; \
+            benchKeep(buffer); \
+        } \
+    }
+
+WRITE_BENCH(writeWhoMessage, device.writeWhoMessage(out))
+WRITE_BENCH(writeConnectMessage, device.writeConnectMessage(out))
+WRITE_BENCH(writeOnlineMessage, device.writeOnlineMessage(out))
+WRITE_BENCH(writeDataStoreEnableMessage, device.writeDataStoreEnableMessage(out, dashStore))
+WRITE_BENCH(writeAlarmMessage, device.writeAlarmMessage(out, alarm))
+WRITE_BENCH(writeC64ConfigBaseMessage, device.writeC64ConfigBaseMessage(out))
+WRITE_BENCH(writeButtonMessage, device.writeButtonMessage(out, controlID))
+WRITE_BENCH(writeButtonMessageState, device.writeButtonMessage(out, controlID, true, iconName, text))
+WRITE_BENCH(writeTextBoxMessage, device.writeTextBoxMessage(out, controlID, text, color))
+WRITE_BENCH(writeTextBoxCaptionMessage, device.writeTextBoxCaptionMessage(out, controlID, text, color))
+WRITE_BENCH(writeSelectorMessageIndex, device.writeSelectorMessage(out, controlID, 2))
+WRITE_BENCH(writeSelectorMessageItems, device.writeSelectorMessage(out, controlID, 2, selectionItems, 5))
+WRITE_BENCH(writeSelectorMessageString, device.writeSelectorMessage(out, controlID, 2, selectionStr))
+WRITE_BENCH(writeSliderMessageInt, device.writeSliderMessage(out, controlID, 42))
+WRITE_BENCH(writeSliderMessageFloat, device.writeSliderMessage(out, controlID, 42.5f))
+WRITE_BENCH(writeSingleBarMessageFloat, device.writeSingleBarMessage(out, controlID, 42.5f))
+WRITE_BENCH(writeDoubleBarMessageFloat, device.writeDoubleBarMessage(out, controlID, 42.5f, 17.25f))
+WRITE_BENCH(writeKnobMessageFloat, device.writeKnobMessage(out, controlID, 0.75f))
+WRITE_BENCH(writeKnobDialMessageFloat, device.writeKnobDialMessage(out, controlID, 0.75f))
+WRITE_BENCH(writeDialMessageFloat, device.writeDialMessage(out, controlID, 1013.25f))
+WRITE_BENCH(writeDirectionMessageFloat, device.writeDirectionMessage(out, controlID, 270.5f, 12.5f))
+WRITE_BENCH(writeMapWaypointMessageString, device.writeMapWaypointMessage(out, controlID, trackID, latitude, longitude))
+WRITE_BENCH(writeMapWaypointMessageFloat, device.writeMapWaypointMessage(out, controlID, trackID, -43.53f, 172.63f))
+WRITE_BENCH(writeMapTrackMessage, device.writeMapTrackMessage(out, controlID, trackID, text, color, waypoints, 2))
+WRITE_BENCH(writeColorMessage, device.writeColorMessage(out, controlID, color))
+WRITE_BENCH(writeAudioVisualMessage, device.writeAudioVisualMessage(out, controlID, url))
+WRITE_BENCH(writeEventLogMessageRows, device.writeEventLogMessage(out, controlID, color, eventLines, 2))
+WRITE_BENCH(writeEventLogMessageEvents, device.writeEventLogMessage(out, controlID, events, 2))
+WRITE_BENCH(writeChartLineInts32, device.writeChartLineInts(out, controlID, lineID, text, bar, color, yLeft, intData, 32))
+WRITE_BENCH(writeChartLineFloats32, device.writeChartLineFloats(out, controlID, lineID, text, line, color, yLeft, floatData, 32))
+WRITE_BENCH(writeTimeGraphLine, device.writeTimeGraphLine(out, controlID, lineID, text, line, color, yLeft))
+WRITE_BENCH(writeTimeGraphLineFloatsStrings32, device.writeTimeGraphLineFloats(out, controlID, lineID, text, line, color, yLeft, timeStrings, floatData, 32))
+WRITE_BENCH(writeTimeGraphLineFloatsTimes32, device.writeTimeGraphLineFloats(out, controlID, lineID, text, line, color, yLeft, timeData, floatData, 32))
+WRITE_BENCH(writeTimeGraphLineBools32, device.writeTimeGraphLineBools(out, controlID, lineID, text, bln, color, timeStrings, boolData, 32))
+WRITE_BENCH(writeTimeGraphPoint, device.writeTimeGraphPoint(out, controlID, lineID, 21.5f))
+WRITE_BENCH(writeTimeGraphPointTime, device.writeTimeGraphPoint(out, controlID, lineID, timeStr, 21.5f))
+WRITE_BENCH(writeTimeGraphPointArr, device.writeTimeGraphPointArr(out, controlID, lineID, arrData, 4))
+
+// Delta cache filtering of a periodic update
+BENCH(getChangedMessages) {
+    static DashioDevice device("BENCH");
+    device.setup("ABC123");
+    device.enableDeltaCache(8);
+    String update = device.getSliderMessage("slider1", 42) + device.getDialMessage("dial1", 10) + device.getTextBoxMessage("text1", "Hi");
+    for (unsigned long i = 0; i < state.iterations; i++) {
+        String message = device.getChangedMessages(update);
+        benchKeep(message);
+    }
+}
@@ -0,0 +1,42 @@
+/*
+ formatFloat() against the sprintf version it replaced, over a spread of values in both formatting ranges.
+*/
+
+#include "bench.h"
+#include "sprintf_reference.h"
+
+String formatFloat(float value);
+
+static const int NUM_VALUES = 1024;
+static float values[NUM_VALUES];
+
+static bool makeValues() {
+    randomSeed(42);
+    for (int i = 0; i < NUM_VALUES; i++) {
+        float value = random(-10000000, 10000000) / 100.0f;
+        if (i % 4 == 0) {
+            value /= 1000000.0f; // Exponent range below 1
+        }
+        values[i] = value;
+    }
+    return true;
+}
+
+static const bool valuesReady = makeValues();
+
+BENCH(formatFloat) {
+    for (unsigned long i = 0; i < state.iterations; i++) {
+        String text = formatFloat(values[i % NUM_VALUES]);
+        benchKeep(text);
+    }
+}
+
+BENCH(formatFloatSprintf) {
+    for (unsigned long i = 0; i < state.iterations; i++) {
+        char buffer[32];
+        formatFloatSprintf(buffer, values[i % NUM_VALUES]);
+        String text = buffer;
+        benchKeep(text);
+    }
+    benchKeep(valuesReady);
+}
@@ -0,0 +1,59 @@
+/*
+ JSON building: the String based DashJSON and the streaming DashJSONWriter producing the same object.
+*/
+
+#include "bench.h"
+#include "Dashio.h"
+#include "DashioJSON.h"
+
+static String wifiItems[] = {"HomeNetwork", "Office", "Guest \"5G\""};
+
+BENCH(dashJSONSettings) {
+    for (unsigned long i = 0; i < state.iterations; i++) {
+        DashJSON json;
+        json.start();
+        json.addKeyString("deviceName", "Bench Device");
+        json.addKeyFloat("temperature", 21.375f);
+        json.addKeyInt("count", 1234);
+        json.addKeyBool("enabled", true);
+        json.addKeyStringAsNumber("rssi", "-67");
+        json.addKeyStringArray("networks", wifiItems, 3, true);
+        benchKeep(json.jsonStr);
+    }
+}
+
+BENCH(dashJSONWriterSettings) {
+    for (unsigned long i = 0; i < state.iterations; i++) {
+        String message((char *)0);
+        DashStringPrint out(message);
+        DashJSONWriter json(out);
+        json.startObject();
+        json.addKeyString("deviceName", "Bench Device");
+        json.addKeyFloat("temperature", 21.375f);
+        json.addKeyInt("count", 1234);
+        json.addKeyBool("enabled", true);
+        json.addKeyInt("rssi", -67);
+        json.key("networks");
+        json.startArray();
+        for (int j = 0; j < 3; j++) {
+            json.addString(wifiItems[j]);
+        }
+        json.endArray();
+        json.endObject();
+        benchKeep(message);
+    }
+}
+
+BENCH(dashJSONWriterToBuffer) {
+    char buffer[256];
+    for (unsigned long i = 0; i < state.iterations; i++) {
+        DashBufferPrint out(buffer, sizeof(buffer));
+        DashJSONWriter json(out);
+        json.startObject();
+        json.addKeyString("deviceName", "Bench Device");
+        json.addKeyFloat("temperature", 21.375f);
+        json.addKeyInt("count", 1234);
+        json.endObject();
+        benchKeep(buffer);
+    }
+}
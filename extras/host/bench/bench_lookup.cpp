@@ -0,0 +1,55 @@
+/*
+ Control type lookup: the perfect hash behind getControlType() against the strcmp chain it replaced, cycling through
+ every control type ID and two unknown ones.
+*/
+
+#include "bench.h"
+#include "Dashio.h"
+
+static String idStrs[unknown];
+static const char *lookupIDs[unknown + 2];
+static unsigned int numLookupIDs = 0;
+
+// The IDs are private to Dashio.cpp, so collect them through getControlTypeStr()
+static void makeLookupIDs(DashioDevice& device) {
+    if (numLookupIDs == 0) {
+        for (int type = who; type < unknown; type++) {
+            idStrs[type] = device.getControlTypeStr((ControlType)type);
+            if (idStrs[type].length() > 0) {
+                lookupIDs[numLookupIDs++] = idStrs[type].c_str();
+            }
+        }
+        lookupIDs[numLookupIDs++] = "NOPE";
+        lookupIDs[numLookupIDs++] = "BTTNX";
+    }
+}
+
+// The strcmp chain, in enum order
+static ControlType linearControlType(const char *idStr) {
+    for (int type = who; type < unknown; type++) {
+        if ((idStrs[type].length() > 0) && (strcmp(idStrs[type].c_str(), idStr) == 0)) {
+            return (ControlType)type;
+        }
+    }
+    return unknown;
+}
+
+BENCH(controlTypeLookupHash) {
+    DashioDevice device("BENCH");
+    makeLookupIDs(device);
+    unsigned long sum = 0;
+    for (unsigned long i = 0; i < state.iterations; i++) {
+        sum += device.getControlType(lookupIDs[i % numLookupIDs]);
+    }
+    benchKeep(sum);
+}
+
+BENCH(controlTypeLookupLinear) {
+    DashioDevice device("BENCH");
+    makeLookupIDs(device);
+    unsigned long sum = 0;
+    for (unsigned long i = 0; i < state.iterations; i++) {
+        sum += linearControlType(lookupIDs[i % numLookupIDs]);
+    }
+    benchKeep(sum);
+}
@@ -0,0 +1,85 @@
+/*
+ Runs the registered benchmarks and prints one JSON object per line:
+ {"name":...,"iterations":...,"ns_per_op":...,"bytes_per_op":...,"allocs_per_op":...}
+ bytes_per_op and allocs_per_op are heap bytes requested and heap calls made (operator new, String malloc/realloc).
+
+ Options: --quick (short runs, for ctest), --filter <text> (only names containing text), --min-ms <ms>
+*/
+
+#include "bench.h"
+
+#include <chrono>
+#include <vector>
+
+struct BenchEntry {
+    const char *name;
+    BenchFunction function;
+};
+
+static std::vector<BenchEntry>& benchRegistry() {
+    static std::vector<BenchEntry> registry;
+    return registry;
+}
+
+BenchRegistration::BenchRegistration(const char *name, BenchFunction function) {
+    benchRegistry().push_back({name, function});
+}
+
+static double runOnce(BenchFunction function, unsigned long iterations) {
+    BenchState state;
+    state.iterations = iterations;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    function(state);
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char **argv) {
+    double minNs = 200e6;
+    const char *filter = nullptr;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--quick") == 0) {
+            minNs = 2e6;
+        } else if ((strcmp(argv[i], "--filter") == 0) && (i + 1 < argc)) {
+            filter = argv[++i];
+        } else if ((strcmp(argv[i], "--min-ms") == 0) && (i + 1 < argc)) {
+            minNs = atof(argv[++i]) * 1e6;
+        } else {
+            fprintf(stderr, "usage: %s [--quick] [--filter text] [--min-ms ms]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    Serial.muted = true;
+    for (const BenchEntry& entry : benchRegistry()) {
+        if (filter && !strstr(entry.name, filter)) {
+            continue;
+        }
+
+        // Grow the iteration count until one run takes at least minNs
+        unsigned long iterations = 1;
+        double elapsed = runOnce(entry.function, iterations);
+        while (elapsed < minNs) {
+            double scale = (elapsed > 0) ? (minNs * 1.2 / elapsed) : 100;
+            if (scale > 100) {
+                scale = 100;
+            }
+            if (scale < 2) {
+                scale = 2;
+            }
+            iterations = (unsigned long)(iterations * scale);
+            elapsed = runOnce(entry.function, iterations);
+        }
+
+        // Counted run, separate from the timed one so that the counters' reads don't skew it
+        HostAllocStats before = hostAllocStats();
+        runOnce(entry.function, iterations);
+        HostAllocStats after = hostAllocStats();
+
+        printf("{\"name\":\"%s\",\"iterations\":%lu,\"ns_per_op\":%.2f,\"bytes_per_op\":%.2f,\"allocs_per_op\":%.2f}\n",
+               entry.name, iterations, elapsed / iterations,
+               (double)(after.bytes - before.bytes) / iterations,
+               (double)(after.allocs - before.allocs) / iterations);
+        fflush(stdout);
+    }
+    return 0;
+}
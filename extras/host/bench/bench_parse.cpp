@@ -0,0 +1,53 @@
+/*
+ Character at a time parsing, as the serial path sees it: MessageData::processChar with short fields and with a
+ long text field, and DashSerial::processChar through to the receive callback.
+*/
+
+#include "bench.h"
+#include "DashioSerial.h"
+
+static const char shortFields[] = "\tABC123\tSLDR\tslider1\t42.5\n";
+static const char longField[] =
+    "\tABC123\tTEXT\ttext1\t"
+    "The quick brown fox jumps over the lazy dog. The quick brown fox jumps over the lazy dog. "
+    "The quick brown fox jumps over the lazy dog. The quick brown fox jumps over the lazy dog.\n";
+
+static void parseChars(BenchState& state, const char *message, size_t length) {
+    MessageData data(SERIAL_CONN);
+    unsigned long count = 0;
+    for (unsigned long i = 0; i < state.iterations; i++) {
+        for (size_t j = 0; j < length; j++) {
+            if (data.processChar(message[j])) {
+                count++;
+            }
+        }
+    }
+    benchKeep(count);
+}
+
+BENCH(processCharShortFields) {
+    parseChars(state, shortFields, sizeof(shortFields) - 1);
+}
+
+BENCH(processCharLongField) {
+    parseChars(state, longField, sizeof(longField) - 1);
+}
+
+static unsigned long rxCount = 0;
+
+static void rxMessage(MessageData *messageData) {
+    rxCount += messageData->payloadStr.length();
+}
+
+BENCH(dashSerialProcessChar) {
+    DashioDevice device("BENCH");
+    device.setup("ABC123");
+    DashSerial dashSerial(&device);
+    dashSerial.setCallbacksRxTx(rxMessage, nullptr);
+    for (unsigned long i = 0; i < state.iterations; i++) {
+        for (size_t j = 0; j < sizeof(shortFields) - 1; j++) {
+            dashSerial.processChar(shortFields[j]);
+        }
+    }
+    benchKeep(rxCount);
+}
@@ -0,0 +1,75 @@
+/*
+ Incoming message parsing: MessageData::processMessage, with and without an incoming buffer.
+*/
+
+#include "bench.h"
+#include "Dashio.h"
+
+static const char buttonMessage[] = "\tABC123\tBTTN\tbutton1\n";
+static const char sliderMessage[] = "\tABC123\tSLDR\tslider1\t42.5\n";
+static const char statusMessage[] = "\tABC123\tSTATUS\n";
+static const char burstMessages[] =
+    "\tABC123\tBTTN\tbutton1\n"
+    "\tABC123\tSLDR\tslider1\t42.5\n"
+    "\tABC123\tTEXT\ttext1\tHello world\n"
+    "\tABC123\tSLCTR\tselector1\t3\n"
+    "\tABC123\tKNOB\tknob1\t0.75\n";
+
+static void parseDirect(BenchState& state, const char *message, size_t length) {
+    MessageData data(TCP_CONN);
+    unsigned long count = 0;
+    for (unsigned long i = 0; i < state.iterations; i++) {
+        data.processMessage(message, length);
+        if (data.messageReceived) {
+            data.messageReceived = false;
+            count++;
+        }
+    }
+    benchKeep(count);
+}
+
+static void parseBuffered(BenchState& state, const char *message, size_t length) {
+    MessageData data(BLE_CONN, 1024);
+    unsigned long count = 0;
+    for (unsigned long i = 0; i < state.iterations; i++) {
+        data.processMessage(message, length);
+        while (data.nextMessage()) {
+            count++;
+        }
+    }
+    benchKeep(count);
+}
+
+BENCH(processMessageButton) {
+    parseDirect(state, buttonMessage, sizeof(buttonMessage) - 1);
+}
+
+BENCH(processMessageSlider) {
+    parseDirect(state, sliderMessage, sizeof(sliderMessage) - 1);
+}
+
+BENCH(processMessageStatus) {
+    parseDirect(state, statusMessage, sizeof(statusMessage) - 1);
+}
+
+BENCH(processMessageBurst) {
+    parseDirect(state, burstMessages, sizeof(burstMessages) - 1);
+}
+
+BENCH(processMessageStringArg) {
+    MessageData data(TCP_CONN);
+    String message(sliderMessage);
+    for (unsigned long i = 0; i < state.iterations; i++) {
+        data.processMessage(message);
+        data.messageReceived = false;
+    }
+    benchKeep(data.payloadStr);
+}
+
+BENCH(processMessageBufferedSlider) {
+    parseBuffered(state, sliderMessage, sizeof(sliderMessage) - 1);
+}
+
+BENCH(processMessageBufferedBurst) {
+    parseBuffered(state, burstMessages, sizeof(burstMessages) - 1);
+}
@@ -0,0 +1,76 @@
+/*
+ DashSerial::sendCtrl, through to the transmit callback.
+*/
+
+#include "bench.h"
+#include "DashioSerial.h"
+
+static unsigned long txBytes = 0;
+
+static void txMessage(const String& outgoingMessage) {
+    txBytes += outgoingMessage.length();
+}
+
+static DashSerial& benchSerial() {
+    static DashioDevice device("BENCH");
+    static DashSerial dashSerial(&device);
+    static bool setupDone = false;
+    if (!setupDone) {
+        device.setup("ABC123", "Bench Device");
+        dashSerial.setCallbacksRxTx(nullptr, txMessage);
+        setupDone = true;
+    }
+    return dashSerial;
+}
+
+BENCH(sendCtrlCtrl) {
+    DashSerial& dashSerial = benchSerial();
+    for (unsigned long i = 0; i < state.iterations; i++) {
+        dashSerial.sendCtrl(ctrl);
+    }
+    benchKeep(txBytes);
+}
+
+BENCH(sendCtrl) {
+    DashSerial& dashSerial = benchSerial();
+    for (unsigned long i = 0; i < state.iterations; i++) {
+        dashSerial.sendCtrl(status);
+    }
+    benchKeep(txBytes);
+}
+
+BENCH(sendCtrlInt) {
+    DashSerial& dashSerial = benchSerial();
+    for (unsigned long i = 0; i < state.iterations; i++) {
+        dashSerial.sendCtrl(tcpConn, 5650);
+    }
+    benchKeep(txBytes);
+}
+
+BENCH(sendCtrlString) {
+    DashSerial& dashSerial = benchSerial();
+    String name("Bench Device");
+    for (unsigned long i = 0; i < state.iterations; i++) {
+        dashSerial.sendCtrl(deviceName, name);
+    }
+    benchKeep(txBytes);
+}
+
+BENCH(sendCtrlStringInt) {
+    DashSerial& dashSerial = benchSerial();
+    String configC64("lVTLbtswEPwVQ2fVsB07bXSzHScxbMuGrKQtih4YaWMTphiBohoHgf");
+    for (unsigned long i = 0; i < state.iterations; i++) {
+        dashSerial.sendCtrl(config, configC64, 3);
+    }
+    benchKeep(txBytes);
+}
+
+BENCH(sendCtrlStringString) {
+    DashSerial& dashSerial = benchSerial();
+    String ssid("HomeNetwork");
+    String password("correct horse battery");
+    for (unsigned long i = 0; i < state.iterations; i++) {
+        dashSerial.sendCtrl(wifiSetup, ssid, password);
+    }
+    benchKeep(txBytes);
+}
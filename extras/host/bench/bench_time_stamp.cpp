@@ -0,0 +1,50 @@
+/*
+ Time graph timestamps: DashTimeStamp against gmtime/strftime for a run of consecutive samples, and a 1,000 point
+ backfill through addTimeGraphLineFloats. Each op is one point, so points/s is 1e9 / ns_per_op.
+*/
+
+#include "bench.h"
+#include "Dashio.h"
+
+static const time_t BACKFILL_START = 1717236000; // 2024-06-01T10:00:00Z
+static const int BACKFILL_POINTS = 1000;
+
+BENCH(timeStampEncode) {
+    DashTimeStamp timeStamp;
+    for (unsigned long i = 0; i < state.iterations; i++) {
+        const char *text = timeStamp.encode(BACKFILL_START + (time_t)i * 60);
+        benchKeep(text);
+    }
+}
+
+BENCH(timeStampStrftime) {
+    char buffer[32];
+    for (unsigned long i = 0; i < state.iterations; i++) {
+        time_t time = BACKFILL_START + (time_t)i * 60;
+        struct tm tmTime;
+        gmtime_r(&time, &tmTime);
+        strftime(buffer, sizeof(buffer), "%Y-%m-%dT%H:%M:%SZ", &tmTime);
+        benchKeep(buffer);
+    }
+}
+
+BENCH(timeGraphBackfillPerPoint) {
+    static time_t times[BACKFILL_POINTS];
+    static float values[BACKFILL_POINTS];
+    for (int i = 0; i < BACKFILL_POINTS; i++) {
+        times[i] = BACKFILL_START + i * 60;
+        values[i] = 20.0f + (i % 50) * 0.1f;
+    }
+    DashioDevice device("BENCH");
+    device.setup("ABC123");
+    String message((char *)0);
+    message.reserve(BACKFILL_POINTS * 40);
+    unsigned long remaining = state.iterations;
+    while (remaining > 0) {
+        int points = (remaining < BACKFILL_POINTS) ? remaining : BACKFILL_POINTS;
+        message = "";
+        device.addTimeGraphLineFloats(message, "graph1", "line1", "Temperature", line, "red", yLeft, times, values, points);
+        remaining -= points;
+    }
+    benchKeep(message);
+}
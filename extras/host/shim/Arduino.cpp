@@ -0,0 +1,730 @@
+/*
+ Host shim for the DashIO core. String follows the Arduino WString.cpp growth policy.
+*/
+
+#include "Arduino.h"
+
+#include <atomic>
+#include <chrono>
+#include <new>
+#include <thread>
+
+HardwareSerial Serial;
+
+/* ---------------------------------------------------------------------------------------------------------- */
+// Heap accounting
+
+static std::atomic<unsigned long> allocCount(0);
+static std::atomic<unsigned long> allocBytes(0);
+
+HostAllocStats hostAllocStats() {
+    HostAllocStats stats;
+    stats.allocs = allocCount.load(std::memory_order_relaxed);
+    stats.bytes = allocBytes.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void *hostMalloc(size_t size) {
+    allocCount.fetch_add(1, std::memory_order_relaxed);
+    allocBytes.fetch_add(size, std::memory_order_relaxed);
+    return malloc(size);
+}
+
+void *hostRealloc(void *ptr, size_t size) {
+    allocCount.fetch_add(1, std::memory_order_relaxed);
+    allocBytes.fetch_add(size, std::memory_order_relaxed);
+    return realloc(ptr, size);
+}
+
+static void *countedNew(size_t size) {
+    void *ptr = hostMalloc(size ? size : 1);
+    if (!ptr) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void *operator new(size_t size) {return countedNew(size);}
+void *operator new[](size_t size) {return countedNew(size);}
+void *operator new(size_t size, const std::nothrow_t &) noexcept {return hostMalloc(size ? size : 1);}
+void *operator new[](size_t size, const std::nothrow_t &) noexcept {return hostMalloc(size ? size : 1);}
+void operator delete(void *ptr) noexcept {free(ptr);}
+void operator delete[](void *ptr) noexcept {free(ptr);}
+void operator delete(void *ptr, size_t) noexcept {free(ptr);}
+void operator delete[](void *ptr, size_t) noexcept {free(ptr);}
+
+/* ---------------------------------------------------------------------------------------------------------- */
+// Clock
+
+static bool manualClock = false;
+static unsigned long manualMillis = 0;
+static const std::chrono::steady_clock::time_point clockStart = std::chrono::steady_clock::now();
+
+unsigned long millis() {
+    if (manualClock) {
+        return manualMillis;
+    }
+    return (unsigned long)std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - clockStart).count();
+}
+
+unsigned long micros() {
+    if (manualClock) {
+        return manualMillis * 1000UL;
+    }
+    return (unsigned long)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - clockStart).count();
+}
+
+void delay(unsigned long ms) {
+    if (manualClock) {
+        manualMillis += ms;
+    } else {
+        std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+    }
+}
+
+void yield() {}
+
+void hostSetMillis(unsigned long ms) {
+    manualClock = true;
+    manualMillis = ms;
+}
+
+void hostAdvanceMillis(unsigned long ms) {
+    manualMillis += ms;
+}
+
+void hostUseRealClock() {
+    manualClock = false;
+}
+
+static unsigned long randomState = 1;
+
+void randomSeed(unsigned long seed) {
+    if (seed != 0) {
+        randomState = seed;
+    }
+}
+
+long random(long howBig) {
+    if (howBig <= 0) {
+        return 0;
+    }
+    randomState = randomState * 1103515245UL + 12345UL;
+    return (long)((randomState >> 1) % (unsigned long)howBig);
+}
+
+long random(long howSmall, long howBig) {
+    if (howSmall >= howBig) {
+        return howSmall;
+    }
+    return random(howBig - howSmall) + howSmall;
+}
+
+static uint8_t pinLevels[256];
+
+void pinMode(uint8_t, uint8_t) {}
+void digitalWrite(uint8_t pin, uint8_t val) {pinLevels[pin] = val;}
+int digitalRead(uint8_t pin) {return pinLevels[pin];}
+
+/* ---------------------------------------------------------------------------------------------------------- */
+// String
+
+static unsigned int toBase(char *buf, unsigned long value, unsigned char base) {
+    char digits[sizeof(unsigned long) * 8 + 1];
+    unsigned int count = 0;
+    if (base < 2) {
+        base = 10;
+    }
+    do {
+        unsigned int digit = value % base;
+        digits[count++] = digit < 10 ? '0' + digit : 'a' + digit - 10;
+        value /= base;
+    } while (value);
+    for (unsigned int i = 0; i < count; i++) {
+        buf[i] = digits[count - 1 - i];
+    }
+    buf[count] = 0;
+    return count;
+}
+
+static unsigned int signedToBase(char *buf, long value, unsigned char base) {
+    if (value < 0 && base == DEC) {
+        buf[0] = '-';
+        return toBase(buf + 1, 0UL - (unsigned long)value, base) + 1;
+    }
+    return toBase(buf, (unsigned long)value, base);
+}
+
+void String::init() {
+    buffer = nullptr;
+    capacity = 0;
+    len = 0;
+}
+
+void String::invalidate() {
+    free(buffer);
+    init();
+}
+
+bool String::reserve(unsigned int size) {
+    if (buffer && capacity >= size) {
+        return true;
+    }
+    if (changeBuffer(size)) {
+        if (len == 0) {
+            buffer[0] = 0;
+        }
+        return true;
+    }
+    return false;
+}
+
+bool String::changeBuffer(unsigned int maxStrLen) {
+    char *newbuffer = (char *)hostRealloc(buffer, maxStrLen + 1);
+    if (newbuffer) {
+        buffer = newbuffer;
+        capacity = maxStrLen;
+        return true;
+    }
+    return false;
+}
+
+String &String::copy(const char *cstr, unsigned int length) {
+    if (!reserve(length)) {
+        invalidate();
+        return *this;
+    }
+    len = length;
+    memcpy(buffer, cstr, length);
+    buffer[len] = 0;
+    return *this;
+}
+
+void String::move(String &rhs) {
+    free(buffer);
+    buffer = rhs.buffer;
+    capacity = rhs.capacity;
+    len = rhs.len;
+    rhs.init();
+}
+
+String::String(const char *cstr) {
+    init();
+    if (cstr) {
+        copy(cstr, strlen(cstr));
+    }
+}
+
+String::String(const char *cstr, unsigned int length) {
+    init();
+    if (cstr) {
+        copy(cstr, length);
+    }
+}
+
+String::String(const String &value) {
+    init();
+    *this = value;
+}
+
+String::String(const __FlashStringHelper *str) {
+    init();
+    *this = str;
+}
+
+String::String(String &&rval) {
+    init();
+    move(rval);
+}
+
+String::String(char c) {
+    init();
+    char buf[2] = {c, 0};
+    *this = buf;
+}
+
+String::String(unsigned char value, unsigned char base) {
+    init();
+    char buf[1 + 8 * sizeof(unsigned char)];
+    copy(buf, toBase(buf, value, base));
+}
+
+String::String(int value, unsigned char base) {
+    init();
+    char buf[2 + 8 * sizeof(int)];
+    copy(buf, signedToBase(buf, value, base));
+}
+
+String::String(unsigned int value, unsigned char base) {
+    init();
+    char buf[1 + 8 * sizeof(unsigned int)];
+    copy(buf, toBase(buf, value, base));
+}
+
+String::String(long value, unsigned char base) {
+    init();
+    char buf[2 + 8 * sizeof(long)];
+    copy(buf, signedToBase(buf, value, base));
+}
+
+String::String(unsigned long value, unsigned char base) {
+    init();
+    char buf[1 + 8 * sizeof(unsigned long)];
+    copy(buf, toBase(buf, value, base));
+}
+
+String::String(float value, unsigned char decimalPlaces) {
+    init();
+    char buf[64];
+    copy(buf, snprintf(buf, sizeof(buf), "%*.*f", decimalPlaces + 2, decimalPlaces, value));
+}
+
+String::String(double value, unsigned char decimalPlaces) {
+    init();
+    char buf[64];
+    copy(buf, snprintf(buf, sizeof(buf), "%*.*f", decimalPlaces + 2, decimalPlaces, value));
+}
+
+String::~String() {
+    free(buffer);
+}
+
+String &String::operator=(const String &rhs) {
+    if (this == &rhs) {
+        return *this;
+    }
+    if (rhs.buffer) {
+        copy(rhs.buffer, rhs.len);
+    } else {
+        invalidate();
+    }
+    return *this;
+}
+
+String &String::operator=(const char *cstr) {
+    if (cstr) {
+        copy(cstr, strlen(cstr));
+    } else {
+        invalidate();
+    }
+    return *this;
+}
+
+String &String::operator=(const __FlashStringHelper *str) {
+    return *this = reinterpret_cast<const char *>(str);
+}
+
+String &String::operator=(String &&rval) {
+    if (this != &rval) {
+        move(rval);
+    }
+    return *this;
+}
+
+bool String::concat(const char *cstr, unsigned int length) {
+    unsigned int newlen = len + length;
+    if (!cstr) {
+        return false;
+    }
+    if (length == 0) {
+        return true;
+    }
+    if (!reserve(newlen)) {
+        return false;
+    }
+    memmove(buffer + len, cstr, length);
+    len = newlen;
+    buffer[len] = 0;
+    return true;
+}
+
+bool String::concat(const String &s) {
+    return concat(s.buffer, s.len);
+}
+
+bool String::concat(const char *cstr) {
+    return cstr ? concat(cstr, strlen(cstr)) : false;
+}
+
+bool String::concat(char c) {
+    return concat(&c, 1);
+}
+
+bool String::concat(unsigned char num) {
+    char buf[1 + 3 * sizeof(unsigned char)];
+    return concat(buf, toBase(buf, num, DEC));
+}
+
+bool String::concat(int num) {
+    char buf[2 + 3 * sizeof(int)];
+    return concat(buf, signedToBase(buf, num, DEC));
+}
+
+bool String::concat(unsigned int num) {
+    char buf[1 + 3 * sizeof(unsigned int)];
+    return concat(buf, toBase(buf, num, DEC));
+}
+
+bool String::concat(long num) {
+    char buf[2 + 3 * sizeof(long)];
+    return concat(buf, signedToBase(buf, num, DEC));
+}
+
+bool String::concat(unsigned long num) {
+    char buf[1 + 3 * sizeof(unsigned long)];
+    return concat(buf, toBase(buf, num, DEC));
+}
+
+bool String::concat(float num) {
+    char buf[64];
+    return concat(buf, snprintf(buf, sizeof(buf), "%4.2f", num));
+}
+
+bool String::concat(double num) {
+    char buf[64];
+    return concat(buf, snprintf(buf, sizeof(buf), "%4.2f", num));
+}
+
+bool String::concat(const __FlashStringHelper *str) {
+    return concat(reinterpret_cast<const char *>(str));
+}
+
+int String::compareTo(const String &s) const {
+    return strcmp(c_str(), s.c_str());
+}
+
+bool String::equals(const String &s) const {
+    return len == s.len && compareTo(s) == 0;
+}
+
+bool String::equals(const char *cstr) const {
+    return strcmp(c_str(), cstr ? cstr : "") == 0;
+}
+
+bool String::equalsIgnoreCase(const String &s) const {
+    if (len != s.len) {
+        return false;
+    }
+    for (unsigned int i = 0; i < len; i++) {
+        if (tolower((unsigned char)buffer[i]) != tolower((unsigned char)s.buffer[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool String::startsWith(const String &prefix) const {
+    return len >= prefix.len && startsWith(prefix, 0);
+}
+
+bool String::startsWith(const String &prefix, unsigned int offset) const {
+    if (offset > len - prefix.len || !buffer || !prefix.buffer) {
+        return false;
+    }
+    return strncmp(&buffer[offset], prefix.buffer, prefix.len) == 0;
+}
+
+bool String::endsWith(const String &suffix) const {
+    if (len < suffix.len || !buffer || !suffix.buffer) {
+        return false;
+    }
+    return strcmp(&buffer[len - suffix.len], suffix.buffer) == 0;
+}
+
+char String::charAt(unsigned int index) const {
+    return operator[](index);
+}
+
+void String::setCharAt(unsigned int index, char c) {
+    if (index < len) {
+        buffer[index] = c;
+    }
+}
+
+char String::operator[](unsigned int index) const {
+    if (index >= len || !buffer) {
+        return 0;
+    }
+    return buffer[index];
+}
+
+char &String::operator[](unsigned int index) {
+    static char dummy_writable_char;
+    if (index >= len || !buffer) {
+        dummy_writable_char = 0;
+        return dummy_writable_char;
+    }
+    return buffer[index];
+}
+
+void String::getBytes(unsigned char *buf, unsigned int bufsize, unsigned int index) const {
+    if (!bufsize || !buf) {
+        return;
+    }
+    if (index >= len) {
+        buf[0] = 0;
+        return;
+    }
+    unsigned int n = bufsize - 1;
+    if (n > len - index) {
+        n = len - index;
+    }
+    strncpy((char *)buf, buffer + index, n);
+    buf[n] = 0;
+}
+
+int String::indexOf(char ch, unsigned int fromIndex) const {
+    if (fromIndex >= len) {
+        return -1;
+    }
+    const char *temp = strchr(buffer + fromIndex, ch);
+    return temp ? temp - buffer : -1;
+}
+
+int String::indexOf(const String &s2, unsigned int fromIndex) const {
+    if (fromIndex >= len) {
+        return -1;
+    }
+    const char *found = strstr(buffer + fromIndex, s2.c_str());
+    return found ? found - buffer : -1;
+}
+
+int String::lastIndexOf(char ch) const {
+    if (!len) {
+        return -1;
+    }
+    const char *temp = strrchr(buffer, ch);
+    return temp ? temp - buffer : -1;
+}
+
+int String::lastIndexOf(const String &s2) const {
+    int found = -1;
+    for (int i = indexOf(s2); i >= 0; i = indexOf(s2, i + 1)) {
+        found = i;
+    }
+    return found;
+}
+
+String String::substring(unsigned int left, unsigned int right) const {
+    if (left > right) {
+        unsigned int temp = right;
+        right = left;
+        left = temp;
+    }
+    String out;
+    if (left >= len) {
+        return out;
+    }
+    if (right > len) {
+        right = len;
+    }
+    out.copy(buffer + left, right - left);
+    return out;
+}
+
+void String::replace(char find, char replace) {
+    for (unsigned int i = 0; i < len; i++) {
+        if (buffer[i] == find) {
+            buffer[i] = replace;
+        }
+    }
+}
+
+void String::replace(const String &find, const String &replace) {
+    if (len == 0 || find.len == 0) {
+        return;
+    }
+    String out;
+    int from = 0;
+    for (int i = indexOf(find); i >= 0; i = indexOf(find, from)) {
+        out.concat(buffer + from, i - from);
+        out.concat(replace);
+        from = i + find.len;
+    }
+    out.concat(buffer + from, len - from);
+    *this = out;
+}
+
+void String::remove(unsigned int index) {
+    remove(index, (unsigned int)-1);
+}
+
+void String::remove(unsigned int index, unsigned int count) {
+    if (index >= len || count == 0) {
+        return;
+    }
+    if (count > len - index) {
+        count = len - index;
+    }
+    memmove(buffer + index, buffer + index + count, len - index - count);
+    len -= count;
+    buffer[len] = 0;
+}
+
+void String::toLowerCase() {
+    for (unsigned int i = 0; i < len; i++) {
+        buffer[i] = tolower((unsigned char)buffer[i]);
+    }
+}
+
+void String::toUpperCase() {
+    for (unsigned int i = 0; i < len; i++) {
+        buffer[i] = toupper((unsigned char)buffer[i]);
+    }
+}
+
+void String::trim() {
+    if (!buffer || len == 0) {
+        return;
+    }
+    unsigned int begin = 0;
+    while (begin < len && isspace((unsigned char)buffer[begin])) {
+        begin++;
+    }
+    unsigned int end = len;
+    while (end > begin && isspace((unsigned char)buffer[end - 1])) {
+        end--;
+    }
+    len = end - begin;
+    if (begin > 0) {
+        memmove(buffer, buffer + begin, len);
+    }
+    buffer[len] = 0;
+}
+
+long String::toInt() const {
+    return buffer ? atol(buffer) : 0;
+}
+
+float String::toFloat() const {
+    return (float)toDouble();
+}
+
+double String::toDouble() const {
+    return buffer ? atof(buffer) : 0;
+}
+
+String operator+(const String &lhs, const String &rhs) {String out(lhs); out.concat(rhs); return out;}
+String operator+(const String &lhs, const char *rhs) {String out(lhs); out.concat(rhs); return out;}
+String operator+(const char *lhs, const String &rhs) {String out(lhs); out.concat(rhs); return out;}
+String operator+(const String &lhs, char c) {String out(lhs); out.concat(c); return out;}
+String operator+(const String &lhs, int num) {String out(lhs); out.concat(num); return out;}
+String operator+(const String &lhs, unsigned int num) {String out(lhs); out.concat(num); return out;}
+String operator+(const String &lhs, long num) {String out(lhs); out.concat(num); return out;}
+String operator+(const String &lhs, unsigned long num) {String out(lhs); out.concat(num); return out;}
+String operator+(const String &lhs, float num) {String out(lhs); out.concat(num); return out;}
+String operator+(const String &lhs, double num) {String out(lhs); out.concat(num); return out;}
+String operator+(const String &lhs, const __FlashStringHelper *rhs) {String out(lhs); out.concat(rhs); return out;}
+
+/* ---------------------------------------------------------------------------------------------------------- */
+// Print
+
+size_t Print::write(const uint8_t *buffer, size_t size) {
+    size_t n = 0;
+    while (size--) {
+        if (write(*buffer++)) {
+            n++;
+        } else {
+            break;
+        }
+    }
+    return n;
+}
+
+size_t Print::print(const __FlashStringHelper *str) {return write(reinterpret_cast<const char *>(str));}
+size_t Print::print(const String &s) {return write(s.c_str(), s.length());}
+size_t Print::print(const char str[]) {return write(str);}
+size_t Print::print(char c) {return write((uint8_t)c);}
+size_t Print::print(unsigned char b, int base) {return print((unsigned long)b, base);}
+size_t Print::print(int n, int base) {return print((long)n, base);}
+size_t Print::print(unsigned int n, int base) {return print((unsigned long)n, base);}
+
+size_t Print::print(long n, int base) {
+    if (base == 0) {
+        return write((uint8_t)n);
+    }
+    if (base == 10 && n < 0) {
+        size_t t = print('-');
+        return printNumber(0UL - (unsigned long)n, 10) + t;
+    }
+    return printNumber(n, base);
+}
+
+size_t Print::print(unsigned long n, int base) {
+    if (base == 0) {
+        return write((uint8_t)n);
+    }
+    return printNumber(n, base);
+}
+
+size_t Print::print(double n, int digits) {return printFloat(n, digits);}
+
+size_t Print::println(const __FlashStringHelper *str) {size_t n = print(str); return n + println();}
+size_t Print::println(const String &s) {size_t n = print(s); return n + println();}
+size_t Print::println(const char c[]) {size_t n = print(c); return n + println();}
+size_t Print::println(char c) {size_t n = print(c); return n + println();}
+size_t Print::println(unsigned char b, int base) {size_t n = print(b, base); return n + println();}
+size_t Print::println(int num, int base) {size_t n = print(num, base); return n + println();}
+size_t Print::println(unsigned int num, int base) {size_t n = print(num, base); return n + println();}
+size_t Print::println(long num, int base) {size_t n = print(num, base); return n + println();}
+size_t Print::println(unsigned long num, int base) {size_t n = print(num, base); return n + println();}
+size_t Print::println(double num, int digits) {size_t n = print(num, digits); return n + println();}
+size_t Print::println() {return write("\r\n");}
+
+size_t Print::printNumber(unsigned long n, uint8_t base) {
+    char buf[8 * sizeof(long) + 1];
+    unsigned int length = toBase(buf, n, base);
+    return write(buf, length);
+}
+
+size_t Print::printFloat(double number, uint8_t digits) {
+    size_t n = 0;
+
+    if (std::isnan(number)) return print("nan");
+    if (std::isinf(number)) return print("inf");
+    if (number > 4294967040.0) return print("ovf");
+    if (number < -4294967040.0) return print("ovf");
+
+    if (number < 0.0) {
+        n += print('-');
+        number = -number;
+    }
+
+    double rounding = 0.5;
+    for (uint8_t i = 0; i < digits; ++i) {
+        rounding /= 10.0;
+    }
+    number += rounding;
+
+    unsigned long int_part = (unsigned long)number;
+    double remainder = number - (double)int_part;
+    n += print(int_part);
+
+    if (digits > 0) {
+        n += print('.');
+    }
+
+    while (digits-- > 0) {
+        remainder *= 10.0;
+        unsigned int toPrint = (unsigned int)(remainder);
+        n += print(toPrint);
+        remainder -= toPrint;
+    }
+    return n;
+}
+
+/* ---------------------------------------------------------------------------------------------------------- */
+
+size_t HardwareSerial::write(uint8_t c) {
+    if (!muted) {
+        putchar(c);
+    }
+    return 1;
+}
+
+size_t HardwareSerial::write(const uint8_t *buffer, size_t size) {
+    if (!muted) {
+        fwrite(buffer, 1, size, stdout);
+    }
+    return size;
+}
@@ -0,0 +1,271 @@
+/*
+ Host shim for the DashIO core (Dashio.cpp, DashioJSON.cpp, DashioSerial.cpp).
+
+ Provides just enough of the Arduino core to build the library sources unmodified on a desktop compiler for tests and
+ benchmarks. String follows WString.cpp (exact-size realloc growth, no small-string buffer) so that allocation counts
+ measured here track what an AVR/SAMD/ESP core does. This directory is under extras/ so the Arduino IDE never compiles it.
+*/
+
+#ifndef HostArduino_h
+#define HostArduino_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+#include <ctype.h>
+#include <cmath>
+#include <type_traits>
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HIGH 0x1
+#define LOW  0x0
+#define INPUT 0x0
+#define OUTPUT 0x1
+
+#define DEC 10
+#define HEX 16
+#define OCT 8
+#define BIN 2
+
+#define PI 3.1415926535897932384626433832795
+#define DEG_TO_RAD 0.017453292519943295769236907684886
+#define RAD_TO_DEG 57.295779513082320876798154814105
+
+using std::abs;
+
+template<class A, class B> inline typename std::common_type<A, B>::type min(A a, B b) {return (b < a) ? b : a;}
+template<class A, class B> inline typename std::common_type<A, B>::type max(A a, B b) {return (a < b) ? b : a;}
+
+/* ---------------------------------------------------------------------------------------------------------- */
+// Program memory is ordinary memory on the host
+
+#define PROGMEM
+#define PGM_P const char *
+#define pgm_read_byte(addr) (*(const uint8_t *)(addr))
+#define pgm_read_byte_near(addr) (*(const uint8_t *)(addr))
+#define strlen_P(s) strlen(s)
+#define strcmp_P(s1, s2) strcmp(s1, s2)
+#define strcpy_P(dest, src) strcpy(dest, src)
+#define memcpy_P(dest, src, n) memcpy(dest, src, n)
+
+class __FlashStringHelper;
+#define F(string_literal) (reinterpret_cast<const __FlashStringHelper *>(string_literal))
+
+/* ---------------------------------------------------------------------------------------------------------- */
+// Clock. Runs off the host's steady clock unless a test takes manual control with hostSetMillis().
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void yield();
+
+void hostSetMillis(unsigned long ms); // switches to the manual clock
+void hostAdvanceMillis(unsigned long ms);
+void hostUseRealClock();
+
+long random(long howBig);
+long random(long howSmall, long howBig);
+void randomSeed(unsigned long seed);
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int digitalRead(uint8_t pin);
+
+/* ---------------------------------------------------------------------------------------------------------- */
+// Heap accounting. Every operator new and every String malloc/realloc is counted.
+
+struct HostAllocStats {
+    unsigned long allocs;
+    unsigned long bytes;
+};
+
+HostAllocStats hostAllocStats();
+void *hostMalloc(size_t size);
+void *hostRealloc(void *ptr, size_t size);
+
+/* ---------------------------------------------------------------------------------------------------------- */
+
+class String {
+public:
+    String(const char *cstr = "");
+    String(const char *cstr, unsigned int length);
+    String(const String &str);
+    String(const __FlashStringHelper *str);
+    String(String &&rval);
+    explicit String(char c);
+    explicit String(unsigned char value, unsigned char base = DEC);
+    explicit String(int value, unsigned char base = DEC);
+    explicit String(unsigned int value, unsigned char base = DEC);
+    explicit String(long value, unsigned char base = DEC);
+    explicit String(unsigned long value, unsigned char base = DEC);
+    explicit String(float value, unsigned char decimalPlaces = 2);
+    explicit String(double value, unsigned char decimalPlaces = 2);
+    ~String();
+
+    bool reserve(unsigned int size);
+    inline unsigned int length() const {return len;}
+    inline const char *c_str() const {return buffer ? buffer : "";}
+    inline char *begin() {return buffer;}
+    inline char *end() {return buffer + len;}
+
+    String &operator=(const String &rhs);
+    String &operator=(const char *cstr);
+    String &operator=(const __FlashStringHelper *str);
+    String &operator=(String &&rval);
+
+    bool concat(const String &str);
+    bool concat(const char *cstr);
+    bool concat(const char *cstr, unsigned int length);
+    bool concat(const uint8_t *cstr, unsigned int length) {return concat((const char *)cstr, length);}
+    bool concat(char c);
+    bool concat(unsigned char num);
+    bool concat(int num);
+    bool concat(unsigned int num);
+    bool concat(long num);
+    bool concat(unsigned long num);
+    bool concat(float num);
+    bool concat(double num);
+    bool concat(const __FlashStringHelper *str);
+
+    template<class T> String &operator+=(const T &rhs) {concat(rhs); return *this;}
+    String &operator+=(const char *cstr) {concat(cstr); return *this;}
+
+    int compareTo(const String &s) const;
+    bool equals(const String &s) const;
+    bool equals(const char *cstr) const;
+    bool equalsIgnoreCase(const String &s) const;
+    bool operator==(const String &rhs) const {return equals(rhs);}
+    bool operator==(const char *cstr) const {return equals(cstr);}
+    bool operator!=(const String &rhs) const {return !equals(rhs);}
+    bool operator!=(const char *cstr) const {return !equals(cstr);}
+    bool operator<(const String &rhs) const {return compareTo(rhs) < 0;}
+    bool operator>(const String &rhs) const {return compareTo(rhs) > 0;}
+    bool startsWith(const String &prefix) const;
+    bool startsWith(const String &prefix, unsigned int offset) const;
+    bool endsWith(const String &suffix) const;
+
+    char charAt(unsigned int index) const;
+    void setCharAt(unsigned int index, char c);
+    char operator[](unsigned int index) const;
+    char &operator[](unsigned int index);
+    void getBytes(unsigned char *buf, unsigned int bufsize, unsigned int index = 0) const;
+    void toCharArray(char *buf, unsigned int bufsize, unsigned int index = 0) const {getBytes((unsigned char *)buf, bufsize, index);}
+
+    int indexOf(char ch, unsigned int fromIndex = 0) const;
+    int indexOf(const String &str, unsigned int fromIndex = 0) const;
+    int lastIndexOf(char ch) const;
+    int lastIndexOf(const String &str) const;
+    String substring(unsigned int beginIndex) const {return substring(beginIndex, len);}
+    String substring(unsigned int beginIndex, unsigned int endIndex) const;
+
+    void replace(char find, char replace);
+    void replace(const String &find, const String &replace);
+    void remove(unsigned int index);
+    void remove(unsigned int index, unsigned int count);
+    void toLowerCase();
+    void toUpperCase();
+    void trim();
+
+    long toInt() const;
+    float toFloat() const;
+    double toDouble() const;
+
+protected:
+    char *buffer;
+    unsigned int capacity;
+    unsigned int len;
+
+    void init();
+    void invalidate();
+    bool changeBuffer(unsigned int maxStrLen);
+    String &copy(const char *cstr, unsigned int length);
+    void move(String &rhs);
+};
+
+String operator+(const String &lhs, const String &rhs);
+String operator+(const String &lhs, const char *rhs);
+String operator+(const char *lhs, const String &rhs);
+String operator+(const String &lhs, char c);
+String operator+(const String &lhs, int num);
+String operator+(const String &lhs, unsigned int num);
+String operator+(const String &lhs, long num);
+String operator+(const String &lhs, unsigned long num);
+String operator+(const String &lhs, float num);
+String operator+(const String &lhs, double num);
+String operator+(const String &lhs, const __FlashStringHelper *rhs);
+
+/* ---------------------------------------------------------------------------------------------------------- */
+
+class Print {
+public:
+    virtual ~Print() {}
+
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t *buffer, size_t size);
+    size_t write(const char *str) {return str ? write((const uint8_t *)str, strlen(str)) : 0;}
+    size_t write(const char *buffer, size_t size) {return write((const uint8_t *)buffer, size);}
+    virtual int availableForWrite() {return 0;}
+    virtual void flush() {}
+
+    size_t print(const __FlashStringHelper *str);
+    size_t print(const String &str);
+    size_t print(const char str[]);
+    size_t print(char c);
+    size_t print(unsigned char num, int base = DEC);
+    size_t print(int num, int base = DEC);
+    size_t print(unsigned int num, int base = DEC);
+    size_t print(long num, int base = DEC);
+    size_t print(unsigned long num, int base = DEC);
+    size_t print(double num, int digits = 2);
+
+    size_t println(const __FlashStringHelper *str);
+    size_t println(const String &str);
+    size_t println(const char str[]);
+    size_t println(char c);
+    size_t println(unsigned char num, int base = DEC);
+    size_t println(int num, int base = DEC);
+    size_t println(unsigned int num, int base = DEC);
+    size_t println(long num, int base = DEC);
+    size_t println(unsigned long num, int base = DEC);
+    size_t println(double num, int digits = 2);
+    size_t println();
+
+private:
+    size_t printNumber(unsigned long num, uint8_t base);
+    size_t printFloat(double number, uint8_t digits);
+};
+
+class Stream : public Print {
+public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+    void setTimeout(unsigned long timeout) {streamTimeout = timeout;}
+
+protected:
+    unsigned long streamTimeout = 1000;
+};
+
+// Serial output goes to stdout unless muted (benchmarks mute it)
+class HardwareSerial : public Stream {
+public:
+    bool muted = false;
+
+    void begin(unsigned long) {}
+    int available() {return 0;}
+    int read() {return -1;}
+    int peek() {return -1;}
+    size_t write(uint8_t c);
+    size_t write(const uint8_t *buffer, size_t size);
+    using Print::write;
+    operator bool() {return true;}
+};
+
+extern HardwareSerial Serial;
+
+#endif
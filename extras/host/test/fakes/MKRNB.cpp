@@ -0,0 +1,4 @@
+#include "MKRNB.h"
+
+FakeModem MODEM;
+FakeNetwork fakeNetwork;
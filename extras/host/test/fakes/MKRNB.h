@@ -0,0 +1,129 @@
+/*
+ Scripted stand-in for the MKRNB library, so DashioMKR1500.cpp builds on the host and its modem supervisor can be driven
+ through attach, check failures and resets. Each AT command is answered from the script in FakeModem; nothing waits.
+*/
+
+#ifndef HostMKRNB_h
+#define HostMKRNB_h
+
+#include "Arduino.h"
+#include "Client.h"
+
+#define SARA_RESETN 7
+
+enum NB_NetworkStatus_t {NB_ERROR, IDLE, CONNECTING, NB_READY, GPRS_READY, TRANSPARENT_CONNECTED, NB_OFF};
+
+class FakeModem {
+public:
+    bool answering = true;        // false: commands are never answered, as with a hung modem
+    bool attached = true;         // The answer to AT+CGATT?
+    int csq = 17;
+    String lastCommand;
+    unsigned int commandCount = 0;
+    unsigned int beginCount = 0;
+    unsigned int hardResetCount = 0;
+
+    int begin(bool restart = false) {(void)restart; beginCount++; return 1;}
+    void send(const char *command) {lastCommand = command; commandCount++; replied = false;}
+    void send(const String& command) {send(command.c_str());}
+    void setResponseDataStorage(String *responseDataStorage) {response = responseDataStorage;}
+    void hardReset() {hardResetCount++;} // The real one holds the reset pin with delay(1000)
+
+    int ready() {
+        if (!answering) {
+            return 0;
+        }
+        if (!replied) {
+            replied = true;
+            if (response != nullptr) {
+                if (lastCommand == "AT+CGATT?") {
+                    *response = attached ? "+CGATT: 1" : "+CGATT: 0";
+                } else if (lastCommand == "AT+CSQ") {
+                    *response = "+CSQ: " + String(csq) + ",99";
+                }
+            }
+        }
+        return 1;
+    }
+
+private:
+    String *response = nullptr;
+    bool replied = true;
+};
+
+extern FakeModem MODEM;
+
+// The script for the network attach, shared by every NB
+struct FakeNetwork {
+    unsigned long attachMs = 2000; // From NB::begin() until NB::ready() reports the attach
+    bool attachFails = false;
+    unsigned int beginCount = 0;
+    unsigned int beginWhileUnanswered = 0; // NB::begin() calls that would have sat in MODEM.begin()'s autosense
+};
+
+extern FakeNetwork fakeNetwork;
+
+class NB {
+public:
+    NB_NetworkStatus_t begin(const char *pin = 0, const char *apn = "", const char *username = "", const char *password = "", bool restart = false, bool synchronous = true) {
+        (void)pin; (void)apn; (void)username; (void)password; (void)restart; (void)synchronous;
+        fakeNetwork.beginCount++;
+        if (!MODEM.answering) {
+            fakeNetwork.beginWhileUnanswered++;
+            networkStatus = NB_ERROR;
+            return NB_ERROR;
+        }
+        beginTime = millis();
+        networkStatus = CONNECTING;
+        return IDLE;
+    }
+
+    int ready() {
+        if (networkStatus != CONNECTING) {
+            return (networkStatus == NB_ERROR) ? 2 : 1;
+        }
+        if (!MODEM.answering) {
+            return 0;
+        }
+        if (millis() - beginTime < fakeNetwork.attachMs) {
+            return 0;
+        }
+        networkStatus = fakeNetwork.attachFails ? NB_ERROR : NB_READY;
+        return fakeNetwork.attachFails ? 2 : 1;
+    }
+
+    NB_NetworkStatus_t status() {return networkStatus;}
+    void setTimeout(unsigned long timeout) {(void)timeout;}
+
+private:
+    NB_NetworkStatus_t networkStatus = IDLE;
+    unsigned long beginTime = 0;
+};
+
+class NBModem {
+public:
+    String getIMEI() {return "352753090000001";}
+};
+
+class NBScanner {
+public:
+    NB_NetworkStatus_t begin() {return NB_READY;}
+};
+
+class NBSSLClient : public Client {
+public:
+    int connect(const char *host, uint16_t port) {(void)host; (void)port; return 0;}
+    size_t write(uint8_t c) {(void)c; return 0;}
+    size_t write(const uint8_t *buf, size_t size) {(void)buf; (void)size; return 0;}
+    int available() {return 0;}
+    int read() {return -1;}
+    int read(uint8_t *buf, size_t size) {(void)buf; (void)size; return -1;}
+    int peek() {return -1;}
+    void flush() {}
+    void stop() {}
+    uint8_t connected() {return 0;}
+    operator bool() {return false;}
+    using Print::write;
+};
+
+#endif
@@ -0,0 +1,39 @@
+/*
+ Stand-in for the arduino-mqtt MQTTClient, never connected, so the MQTT side of DashioMKR1500.cpp builds on the host.
+*/
+
+#ifndef HostMQTT_h
+#define HostMQTT_h
+
+#include "Arduino.h"
+#include "Client.h"
+
+class MQTTClient;
+typedef void (*MQTTClientCallbackAdvanced)(MQTTClient *client, char *topic, char *bytes, int length);
+
+class MQTTClient {
+public:
+    explicit MQTTClient(int bufSize = 128) {(void)bufSize;}
+
+    void begin(const char *hostname, int port, Client& client) {(void)hostname; (void)port; (void)client;}
+    void setOptions(int keepAlive, bool cleanSession, int timeout) {(void)keepAlive; (void)cleanSession; (void)timeout;}
+    void setTimeout(int timeout) {(void)timeout;}
+    void onMessageAdvanced(MQTTClientCallbackAdvanced callback) {(void)callback;}
+    void setWill(const char *topic, const char *payload, bool retained, int qos) {(void)topic; (void)payload; (void)retained; (void)qos;}
+    bool connect(const char *clientID, const char *username, const char *password, bool skip = false) {
+        (void)clientID; (void)username; (void)password; (void)skip;
+        return false;
+    }
+    bool subscribe(const char *topic, int qos) {(void)topic; (void)qos; return false;}
+    bool publish(const char *topic, const char *payload, int length, bool retained, int qos) {
+        (void)topic; (void)payload; (void)length; (void)retained; (void)qos;
+        return false;
+    }
+    bool connected() {return false;}
+    bool loop() {return false;}
+    bool disconnect() {return true;}
+    int lastError() {return 0;}
+    int returnCode() {return 0;}
+};
+
+#endif
@@ -0,0 +1,47 @@
+/*
+ Stand-in for arduino-timer's Timer<>, running its tasks off millis().
+*/
+
+#ifndef HostArduinoTimer_h
+#define HostArduinoTimer_h
+
+#include "Arduino.h"
+
+template<size_t maxTasks = 16, unsigned long (*timeFunction)() = millis, typename T = void *>
+class Timer {
+public:
+    typedef bool (*handler_t)(T opaque);
+
+    bool every(unsigned long interval, handler_t handler, T opaque = T()) {
+        for (size_t i = 0; i < maxTasks; i++) {
+            if (tasks[i].handler == nullptr) {
+                tasks[i] = {handler, opaque, timeFunction(), interval};
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void tick() {
+        for (size_t i = 0; i < maxTasks; i++) {
+            Task& task = tasks[i];
+            if ((task.handler != nullptr) && (timeFunction() - task.start >= task.interval)) {
+                task.start += task.interval;
+                if (!task.handler(task.opaque)) {
+                    task.handler = nullptr;
+                }
+            }
+        }
+    }
+
+private:
+    struct Task {
+        handler_t handler;
+        T opaque;
+        unsigned long start;
+        unsigned long interval;
+    };
+    Task tasks[maxTasks] = {};
+};
+
+#endif
@@ -0,0 +1,42 @@
+/*
+ Checks for the host tests. Each test is its own executable; main() returns hostTestExit() so ctest sees failures.
+*/
+
+#ifndef HostTest_h
+#define HostTest_h
+
+#include "Arduino.h"
+
+static unsigned long hostTestChecks = 0;
+static unsigned long hostTestFailures = 0;
+
+#define CHECK(condition) \
+    do { \
+        hostTestChecks++; \
+        if (!(condition)) { \
+            hostTestFailures++; \
+            if (hostTestFailures <= 20) { \
+                printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+            } \
+        } \
+    } while (0)
+
+#define CHECK_STR(actual, expected) \
+    do { \
+        hostTestChecks++; \
+        const char *actualStr = (actual); \
+        const char *expectedStr = (expected); \
+        if (strcmp(actualStr, expectedStr) != 0) { \
+            hostTestFailures++; \
+            if (hostTestFailures <= 20) { \
+                printf("%s:%d: got \"%s\", expected \"%s\"\n", __FILE__, __LINE__, actualStr, expectedStr); \
+            } \
+        } \
+    } while (0)
+
+static inline int hostTestExit() {
+    printf("%lu checks, %lu failed\n", hostTestChecks, hostTestFailures);
+    return hostTestFailures ? 1 : 0;
+}
+
+#endif
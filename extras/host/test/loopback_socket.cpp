@@ -0,0 +1,61 @@
+#include "loopback_socket.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+bool loopbackSocketPair(int& writeFd, int& readFd) {
+    int listenFd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = 0; // Any free port
+    socklen_t addressLength = sizeof(address);
+    if ((listenFd < 0) || (bind(listenFd, (struct sockaddr *)&address, sizeof(address)) != 0) || (listen(listenFd, 1) != 0) ||
+        (getsockname(listenFd, (struct sockaddr *)&address, &addressLength) != 0)) {
+        return false;
+    }
+
+    writeFd = socket(AF_INET, SOCK_STREAM, 0);
+    if ((writeFd < 0) || (connect(writeFd, (struct sockaddr *)&address, sizeof(address)) != 0)) {
+        close(listenFd);
+        return false;
+    }
+    readFd = accept(listenFd, nullptr, nullptr);
+    close(listenFd);
+    return readFd >= 0;
+}
+
+int socketAvailable(int fd) {
+    int count = 0;
+    if (ioctl(fd, FIONREAD, &count) != 0) {
+        return 0;
+    }
+    return count;
+}
+
+int socketRead(int fd, void *buffer, size_t size) {
+    return recv(fd, buffer, size, 0);
+}
+
+int socketWrite(int fd, const void *buffer, size_t size) {
+    return send(fd, buffer, size, 0);
+}
+
+bool socketWait(int fd, int timeoutMs) {
+    struct pollfd pollFd = {fd, POLLIN, 0};
+    return poll(&pollFd, 1, timeoutMs) > 0;
+}
+
+void socketShutdownWrite(int fd) {
+    shutdown(fd, SHUT_WR);
+}
+
+void socketClose(int fd) {
+    close(fd);
+}
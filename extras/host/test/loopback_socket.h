@@ -0,0 +1,19 @@
+/*
+ Loopback TCP sockets for the host tests. Kept apart from Dashio.h, whose connect control type clashes with the
+ socket connect().
+*/
+
+#ifndef LoopbackSocket_h
+#define LoopbackSocket_h
+
+#include <stddef.h>
+
+bool loopbackSocketPair(int& writeFd, int& readFd);
+int socketAvailable(int fd);
+int socketRead(int fd, void *buffer, size_t size);
+int socketWrite(int fd, const void *buffer, size_t size);
+bool socketWait(int fd, int timeoutMs); // True when the socket is readable, or closed by the other end
+void socketShutdownWrite(int fd);
+void socketClose(int fd);
+
+#endif
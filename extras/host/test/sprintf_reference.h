@@ -0,0 +1,23 @@
+/*
+ The sprintf based formatting that the hand written formatters in the core have to match.
+*/
+
+#ifndef SprintfReference_h
+#define SprintfReference_h
+
+#include "Dashio.h"
+
+// formatFloat() before it stopped calling sprintf
+static inline void formatFloatSprintf(char *buffer, float value) {
+    if (value == INVALID_FLOAT_VALUE) {
+        strcpy(buffer, "nan");
+    } else if (abs(value) < SMALLEST_FLOAT_VALUE) {
+        strcpy(buffer, "0");
+    } else if ((abs(value) < 1.0) || (abs(value) >= 100000)) {
+        sprintf(buffer, "%5.2e", value);
+    } else {
+        sprintf(buffer, "%5.2f", value);
+    }
+}
+
+#endif
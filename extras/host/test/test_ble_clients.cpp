@@ -0,0 +1,158 @@
+/*
+ Two BLE centrals, each with its own MessageData as DashioBLE gives them on ESP32, writing interleaved blocks that
+ split messages at random points or carry several messages at once. Every message must come out of its own
+ client's parser whole, in order, with its connection handle. Runs once on one thread and once with the writes on
+ a second thread, as the NimBLE host task makes them.
+*/
+
+#include "host_test.h"
+#include "Dashio.h"
+
+#include <atomic>
+#include <random>
+#include <thread>
+#include <vector>
+
+static const int INCOMING_BUFFER_SIZE = 512; // As DashioESP.cpp
+static const int NUM_CLIENTS = 2;
+static const int MESSAGES_PER_CLIENT = 5000;
+
+struct SentMessage {
+    String text;
+    String idStr;
+    String payloadStr;
+};
+
+struct Client {
+    uint16_t connectionHandle;
+    MessageData *data;
+    std::vector<SentMessage> sent;
+    String stream;
+    std::atomic<size_t> streamPos{0}; // Moved by the writer, read by the reader to know when it's done
+    size_t received = 0;
+    bool failed = false;
+};
+
+static void makeMessages(Client& client, int clientIndex) {
+    client.stream.reserve(MESSAGES_PER_CLIENT * 40);
+    for (int i = 0; i < MESSAGES_PER_CLIENT; i++) {
+        SentMessage message;
+        message.idStr = String("c") + clientIndex + "_" + i;
+        message.payloadStr = (i % 3 == 0) ? String("text from client ") + clientIndex : String(i * 7 + clientIndex);
+        const char *type = (i % 3 == 0) ? "TEXT" : "SLDR";
+        message.text = String("\tDEV") + clientIndex + "\t" + type + "\t" + message.idStr + "\t" + message.payloadStr + "\n";
+        client.stream += message.text;
+        client.sent.push_back(message);
+    }
+}
+
+static void checkReceived(Client& client) {
+    MessageData *data = client.data;
+    if (client.received >= client.sent.size()) {
+        client.failed = true;
+        return;
+    }
+    const SentMessage& expected = client.sent[client.received++];
+    if ((data->connectionHandle != client.connectionHandle) || (data->idStr != expected.idStr) || (data->payloadStr != expected.payloadStr)) {
+        if (!client.failed) {
+            printf("client %u message %u: got handle %u id \"%s\" payload \"%s\", expected id \"%s\" payload \"%s\"\n",
+                   client.connectionHandle, (unsigned)client.received - 1, data->connectionHandle, data->idStr.c_str(),
+                   data->payloadStr.c_str(), expected.idStr.c_str(), expected.payloadStr.c_str());
+        }
+        client.failed = true;
+    }
+}
+
+// Up to a BLE write's worth, so blocks end mid field, mid message or after several messages
+static size_t nextBlockLength(std::mt19937& rng, const Client& client) {
+    size_t length = (rng() % 4 == 0) ? 1 + rng() % 120 : 1 + rng() % 20;
+    size_t remaining = client.stream.length() - client.streamPos;
+    return (length < remaining) ? length : remaining;
+}
+
+// Returns false if the parser dropped the block because its buffer was full, so it has to be written again
+static bool writeBlock(Client& client, size_t length) {
+    unsigned long overflows = client.data->overflowCount;
+    client.data->processMessage(client.stream.c_str() + client.streamPos.load(), length, client.connectionHandle);
+    if (client.data->overflowCount != overflows) {
+        return false;
+    }
+    client.streamPos += length;
+    return true;
+}
+
+static void drain(Client *clients) {
+    for (int i = 0; i < NUM_CLIENTS; i++) {
+        while (clients[i].data->nextMessage()) {
+            checkReceived(clients[i]);
+        }
+    }
+}
+
+static bool allWritten(Client *clients) {
+    for (int i = 0; i < NUM_CLIENTS; i++) {
+        if (clients[i].streamPos < clients[i].stream.length()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void runClients(bool threaded, unsigned int seed) {
+    Client clients[NUM_CLIENTS];
+    for (int i = 0; i < NUM_CLIENTS; i++) {
+        clients[i].connectionHandle = 10 + i;
+        clients[i].data = new MessageData(BLE_CONN, INCOMING_BUFFER_SIZE);
+        makeMessages(clients[i], i);
+    }
+
+    std::mt19937 rng(seed);
+    if (threaded) {
+        std::thread writer([&clients, seed]() {
+            std::mt19937 writerRng(seed + 1);
+            while (!allWritten(clients)) {
+                Client& client = clients[writerRng() % NUM_CLIENTS];
+                if (client.streamPos < client.stream.length()) {
+                    size_t length = nextBlockLength(writerRng, client);
+                    while (!writeBlock(client, length)) {
+                        std::this_thread::yield();
+                    }
+                }
+            }
+        });
+        while (!allWritten(clients)) {
+            drain(clients);
+            std::this_thread::yield(); // Let the writer in on a single core machine
+        }
+        writer.join();
+    } else {
+        while (!allWritten(clients)) {
+            Client& client = clients[rng() % NUM_CLIENTS];
+            if (client.streamPos < client.stream.length()) {
+                size_t length = nextBlockLength(rng, client);
+                while (!writeBlock(client, length)) {
+                    drain(clients);
+                }
+            }
+            if (rng() % 3 == 0) { // run() doesn't come round after every write
+                drain(clients);
+            }
+        }
+    }
+    drain(clients);
+
+    for (int i = 0; i < NUM_CLIENTS; i++) {
+        CHECK(!clients[i].failed);
+        CHECK(clients[i].received == clients[i].sent.size());
+        delete clients[i].data;
+    }
+}
+
+int main() {
+    Serial.muted = true; // Overflow reports
+    for (unsigned int seed = 1; seed <= 5; seed++) {
+        runClients(false, seed);
+        runClients(true, seed);
+    }
+    return hostTestExit();
+}
@@ -0,0 +1,185 @@
+/*
+ Round trips DashioDevice messages through DashCompactCodec: encode()/decode() must give back the text exactly, and
+ frames queued with write() and split into BLE sized blocks must parse into the same MessageData fields as the text.
+*/
+
+#include "Dashio.h"
+#include "host_test.h"
+
+static DashioDevice dashDevice("TEST");
+
+static void checkRoundTrip(DashCompactCodec& tx, DashCompactCodec& rx, const String& text) {
+    size_t frameLength = tx.encode(text.c_str(), text.length());
+    CHECK(frameLength > 0);
+    String decoded((char *)0);
+    CHECK(rx.decode(tx.frames(), frameLength, decoded));
+    CHECK_STR(decoded.c_str(), text.c_str());
+}
+
+static String messagesText(MessageData& data) {
+    String fields;
+    while (data.nextMessage()) {
+        fields += data.deviceID + "|" + dashDevice.getControlTypeStr(data.control) + "|" + data.idStr + "|" + data.payloadStr + "|" + data.payloadStr2 + "\n";
+    }
+    return fields;
+}
+
+// Sends the messages from tx to rx through a DashSendQueue in blockSize writes, as the BLE paths do
+static void checkStream(const String *messages, int numMessages, size_t blockSize, bool compact) {
+    DashCompactCodec tx;
+    DashCompactCodec rx;
+    tx.begin(compact ? 512 : 0);
+    rx.begin(512);
+    DashSendQueue queue(4096);
+    MessageData streamData(BLE_CONN, 1024);
+    MessageData textData(BLE_CONN, 1024);
+
+    for (int i = 0; i < numMessages; i++) {
+        if (compact) {
+            CHECK(tx.write(queue, messages[i].c_str(), messages[i].length()));
+        } else {
+            CHECK(queue.write(messages[i]));
+        }
+        textData.processMessage(messages[i]);
+    }
+
+    bool framed = false;
+    char block[512];
+    size_t length;
+    while ((length = queue.peek(block, blockSize)) > 0) {
+        framed |= rx.receive(block, length, streamData);
+        queue.remove(length);
+    }
+    CHECK(framed == compact);
+    CHECK(!rx.receiving());
+    CHECK(rx.errorCount == 0);
+    String streamFields = messagesText(streamData);
+    String textFields = messagesText(textData);
+    CHECK_STR(streamFields.c_str(), textFields.c_str());
+}
+
+int main() {
+    dashDevice.setup("a1b2c3d4e5f6", "Test Device");
+
+    DashCompactCodec tx;
+    DashCompactCodec rx;
+    tx.begin(2048);
+    checkRoundTrip(tx, rx, dashDevice.getConnectMessage());
+    checkRoundTrip(tx, rx, dashDevice.getWhoMessage());
+    checkRoundTrip(tx, rx, String("\tWHO\n"));
+    checkRoundTrip(tx, rx, dashDevice.getButtonMessage("B1", true));
+    checkRoundTrip(tx, rx, dashDevice.getSliderMessage("S1", 7.25f));
+    checkRoundTrip(tx, rx, dashDevice.getSliderMessage("S1", 123456.0f));
+    checkRoundTrip(tx, rx, dashDevice.getSliderMessage("S1", -0.00321f));
+    checkRoundTrip(tx, rx, dashDevice.getTextBoxMessage("T1", "hello world"));
+    checkRoundTrip(tx, rx, dashDevice.getTimeGraphPoint("G1", "L1", 3.14159f));
+    checkRoundTrip(tx, rx, String("\ta1b2c3d4e5f6\tTEXT\tT\t\t12345\t 1.5e3\n"));
+    checkRoundTrip(tx, rx, String("\tother\tBTTN\tX\tON\n")); // A different deviceID goes in the frame again
+    checkRoundTrip(tx, rx, String("\ta1b2c3d4e5f6\tNOPE\tX\n"));
+    checkRoundTrip(tx, rx, String("partial chunk no newline"));
+    checkRoundTrip(tx, rx, dashDevice.getButtonMessage("B1", false) + dashDevice.getSliderMessage("S2", 55.5f) + dashDevice.getWhoMessage());
+
+    randomSeed(1);
+    for (int i = 0; i < 20000; i++) {
+        float value = (random(-1000000, 1000000) / (float)random(1, 10000)) * powf(10, random(-6, 6));
+        checkRoundTrip(tx, rx, dashDevice.getSliderMessage("S", value));
+    }
+    CHECK(tx.frameBytes < tx.textBytes);
+
+    // The deviceID is only sent in the first frame
+    DashCompactCodec once;
+    once.begin(256);
+    String slider = dashDevice.getSliderMessage("S1", 7.25f);
+    size_t first = once.encode(slider.c_str(), slider.length());
+    size_t next = once.encode(slider.c_str(), slider.length());
+    CHECK(next + dashDevice.deviceID.length() < first);
+
+    // MQTT resets before each publish, so a subscriber that joins mid-stream decodes every payload from then on,
+    // including after a publish the broker never got
+    DashCompactCodec publisher;
+    DashCompactCodec subscriber;
+    DashCompactCodec lateSubscriber;
+    publisher.begin(256);
+    for (int i = 0; i < 10; i++) {
+        String payload = dashDevice.getSliderMessage("S1", i * 1.5f) + dashDevice.getButtonMessage("B1", i & 1);
+        publisher.reset();
+        size_t payloadLength = publisher.encode(payload.c_str(), payload.length());
+        CHECK(payloadLength > 0);
+        if (i == 4) {
+            continue; // Publish failed
+        }
+        String decoded((char *)0);
+        CHECK(subscriber.decode(publisher.frames(), payloadLength, decoded));
+        CHECK_STR(decoded.c_str(), payload.c_str());
+        if (i >= 6) {
+            String lateDecoded((char *)0);
+            CHECK(lateSubscriber.decode(publisher.frames(), payloadLength, lateDecoded));
+            CHECK_STR(lateDecoded.c_str(), payload.c_str());
+        }
+    }
+
+    // Too big for the encode buffer: write() queues the text instead
+    DashCompactCodec small;
+    small.begin(8);
+    DashSendQueue queue(256);
+    CHECK(small.write(queue, slider.c_str(), slider.length()));
+    char queued[256];
+    size_t queuedLength = queue.peek(queued, sizeof(queued));
+    CHECK((queuedLength == slider.length()) && (memcmp(queued, slider.c_str(), queuedLength) == 0));
+
+    String junk;
+    CHECK(!rx.decode("\xC1\x05\x01", 3, junk));
+
+    // Frames split across writes, for each block size a BLE link might use, against the same messages as text
+    String messages[] = {
+        dashDevice.getConnectMessage(),
+        dashDevice.getWhoMessage(),
+        dashDevice.getButtonMessage("B1", true),
+        dashDevice.getSliderMessage("S1", 7.25f),
+        dashDevice.getSliderMessage("S2", -0.00321f),
+        dashDevice.getTextBoxMessage("T1", "hello world"),
+        dashDevice.getKnobMessage("K1", 42.5f),
+        String("\ta1b2c3d4e5f6\tSTATUS\n")
+    };
+    int numMessages = sizeof(messages) / sizeof(messages[0]);
+    for (size_t blockSize = 1; blockSize <= 100; blockSize++) {
+        checkStream(messages, numMessages, blockSize, true);
+    }
+    checkStream(messages, numMessages, 20, false);
+
+    // Text before the peer switches, in the same write as the first frame
+    DashCompactCodec mixedTx;
+    DashCompactCodec mixedRx;
+    mixedTx.begin(256);
+    mixedRx.begin(256);
+    String button = dashDevice.getButtonMessage("B1", true);
+    size_t frameLength = mixedTx.encode(slider.c_str(), slider.length());
+    String mixed = button;
+    mixed.concat(mixedTx.frames(), frameLength);
+    String mixedText((char *)0);
+    CHECK(mixedRx.receive(mixed.c_str(), mixed.length(), mixedText));
+    String expected = button + slider;
+    CHECK_STR(mixedText.c_str(), expected.c_str());
+
+    // A frame bigger than the receive buffer is skipped, and the next one still decodes
+    DashCompactCodec bigTx;
+    DashCompactCodec bigRx;
+    bigTx.begin(512);
+    bigRx.begin(32);
+    String big = dashDevice.getTextBoxMessage("T1", "a long text box message that won't fit in the receive buffer");
+    String bigFrames((char *)0);
+    size_t bigLength = bigTx.encode(big.c_str(), big.length());
+    bigFrames.concat(bigTx.frames(), bigLength);
+    String shortMessage = String("\tother\tWHO\n"); // Carries its deviceID, which the big frame would have set
+    size_t shortLength = bigTx.encode(shortMessage.c_str(), shortMessage.length());
+    bigFrames.concat(bigTx.frames(), shortLength);
+    String received((char *)0);
+    for (unsigned int i = 0; i < bigFrames.length(); i += 20) {
+        bigRx.receive(bigFrames.c_str() + i, min(20U, bigFrames.length() - i), received);
+    }
+    CHECK(bigRx.errorCount == 1);
+    CHECK(!bigRx.receiving());
+    CHECK_STR(received.c_str(), shortMessage.c_str());
+
+    return hostTestExit();
+}
@@ -0,0 +1,80 @@
+/*
+ formatFloat() against the sprintf "%5.2f"/"%5.2e" it replaced, over random bit patterns (every exponent, plus NaN
+ and infinity), random values in each formatting range, and values on or next to a rounding tie.
+ Usage: test_format_float [count], count random values of each kind (default 2000000)
+*/
+
+#include "host_test.h"
+#include "sprintf_reference.h"
+
+#include <random>
+
+String formatFloat(float value);
+
+static unsigned long mismatches = 0;
+
+static void checkValue(float value) {
+    char expected[32];
+    formatFloatSprintf(expected, value);
+    String actual = formatFloat(value);
+    hostTestChecks++;
+    if (strcmp(actual.c_str(), expected) != 0) {
+        hostTestFailures++;
+        if (++mismatches <= 20) {
+            printf("formatFloat(%.9g) gave \"%s\", sprintf gives \"%s\"\n", value, actual.c_str(), expected);
+        }
+    }
+}
+
+static void checkAround(float value) {
+    checkValue(nextafterf(value, -INFINITY));
+    checkValue(value);
+    checkValue(nextafterf(value, INFINITY));
+    checkValue(-value);
+}
+
+int main(int argc, char **argv) {
+    unsigned long count = (argc > 1) ? strtoul(argv[1], nullptr, 10) : 2000000;
+    std::mt19937 rng(12345);
+
+    // Any bit pattern
+    for (unsigned long i = 0; i < count; i++) {
+        uint32_t bits = rng();
+        float value;
+        memcpy(&value, &bits, sizeof(value));
+        checkValue(value);
+    }
+
+    // Uniform over each range: small exponent, fixed point, large exponent
+    std::uniform_real_distribution<float> small(-1.0f, 1.0f);
+    std::uniform_real_distribution<float> fixed(-100000.0f, 100000.0f);
+    std::uniform_real_distribution<float> logScale(-12.0f, 38.0f);
+    for (unsigned long i = 0; i < count; i++) {
+        checkValue(small(rng));
+        checkValue(fixed(rng));
+        checkValue(powf(10.0f, logScale(rng)) * ((i & 1) ? 1 : -1));
+    }
+
+    // Exact ties, which printf rounds half to even: x.xx5 for "%5.2f", and a 4th significant digit of 5 for "%5.2e"
+    for (int hundredths = 100; hundredths < 10000000; hundredths += 7) {
+        checkAround((hundredths + 0.5f) / 100.0f);
+    }
+    for (int exponent = -20; exponent <= 20; exponent++) {
+        checkAround(ldexpf(1.125f, exponent));
+        checkAround(ldexpf(1.375f, exponent));
+        checkAround(ldexpf(1.0f, exponent));
+    }
+    const float ties[] = {0.03125f, 0.015625f, 1125.0f, 100125.0f, 1.125e6f, 9.995e5f, 99999.995f, 99999.99f, 0.9995f, 0.99951f};
+    for (float value : ties) {
+        checkAround(value);
+    }
+
+    // Range edges and the special values
+    const float edges[] = {1.0f, 100000.0f, 1e-11f, 1e-10f, 1.1e-11f, 3.4028235e38f, 1.17549435e-38f, 1e-45f, 0.0f,
+                           4294967296.0f, INFINITY, NAN};
+    for (float value : edges) {
+        checkAround(value);
+    }
+
+    return hostTestExit();
+}
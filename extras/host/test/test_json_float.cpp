@@ -0,0 +1,80 @@
+/*
+ DashJSONWriter::addFloat() against snprintf("%.3f") over the range it formats itself (below 2e6): random values at
+ every scale, every float that's an exact tie at three decimal places, small negatives and the values either side.
+ Usage: test_json_float [count], count random values of each kind (default 1000000)
+*/
+
+#include "Dashio.h"
+#include "DashioJSON.h"
+#include "host_test.h"
+
+#include <random>
+
+static unsigned long mismatches = 0;
+
+static void checkValue(float value) {
+    if (!(fabsf(value) < 2000000.0f)) {
+        return;
+    }
+    char expected[32];
+    snprintf(expected, sizeof(expected), "%.3f", value);
+    String actual;
+    DashStringPrint out(actual);
+    DashJSONWriter json(out);
+    json.addFloat(value);
+    hostTestChecks++;
+    if (strcmp(actual.c_str(), expected) != 0) {
+        hostTestFailures++;
+        if (++mismatches <= 20) {
+            printf("addFloat(%.9g) gave \"%s\", snprintf gives \"%s\"\n", value, actual.c_str(), expected);
+        }
+    }
+}
+
+static void checkAround(float value) {
+    checkValue(nextafterf(value, -INFINITY));
+    checkValue(value);
+    checkValue(nextafterf(value, INFINITY));
+    checkValue(-value);
+}
+
+int main(int argc, char **argv) {
+    unsigned long count = (argc > 1) ? strtoul(argv[1], nullptr, 10) : 1000000;
+    std::mt19937 rng(24);
+
+    checkAround(0.0f);
+    checkAround(0.0004f);
+    checkAround(0.0005f);
+    checkAround(0.0625f); // Exact ties, which printf rounds to even
+    checkAround(0.1875f);
+    checkAround(1.0625f);
+    checkAround(1999999.875f);
+
+    // A float is exactly halfway between two thousandths when it's an odd multiple of 1/16, 1/32, 1/64 and so on
+    for (int sixteenths = 1; sixteenths < 2048 * 16; sixteenths += 2) {
+        checkAround(sixteenths / 16.0f);
+    }
+    for (int scale = 32; scale <= 1024; scale *= 2) {
+        for (int n = 1; n < 4096; n += 2) {
+            checkAround((float)n / scale);
+        }
+    }
+
+    // Random values at every scale from 1e-4 to 2e6
+    std::uniform_real_distribution<float> exponent(-4.0f, 6.3f);
+    std::uniform_real_distribution<float> mantissa(1.0f, 10.0f);
+    for (unsigned long i = 0; i < count; i++) {
+        checkAround(mantissa(rng) * powf(10.0f, floorf(exponent(rng))));
+    }
+
+    // Random bit patterns below 2e6
+    std::uniform_int_distribution<uint32_t> bits(0, 0x49F42400); // 2e6
+    for (unsigned long i = 0; i < count; i++) {
+        uint32_t pattern = bits(rng);
+        float value;
+        memcpy(&value, &pattern, sizeof(value));
+        checkAround(value);
+    }
+
+    return hostTestExit();
+}
@@ -0,0 +1,116 @@
+/*
+ Drives DashioLTE::superviseModem() against the scripted MODEM in fakes/MKRNB.h on the manual clock: attach, periodic
+ checks, check failures leading to a soft reset, a soft reset that doesn't come back leading to a hard reset, and
+ recovery. run() is called every 10ms and must never move the clock itself, i.e. never wait on the modem.
+*/
+
+#include "DashioMKR1500.h"
+#include "host_test.h"
+
+static DashioLTE lte;
+static unsigned long stalls = 0;
+
+static void runFor(unsigned long ms) {
+    for (unsigned long elapsed = 0; elapsed < ms; elapsed += 10) {
+        unsigned long before = millis();
+        lte.run();
+        if (millis() != before) {
+            stalls++;
+        }
+        hostAdvanceMillis(10);
+    }
+}
+
+// Runs until the supervisor reaches the state, for up to limitMs. Returns how long that took
+static unsigned long runUntil(LTEstate state, unsigned long limitMs) {
+    unsigned long start = millis();
+    while ((lte.state != state) && (millis() - start < limitMs)) {
+        runFor(10);
+    }
+    return millis() - start;
+}
+
+int main() {
+    hostSetMillis(1000);
+
+    lte.begin();
+    CHECK(MODEM.beginCount == 1); // The one restart in setup
+    CHECK(lte.state == lteAttach);
+
+    // Attach: AT probe, then NB::begin, then the fake's 2s attach
+    runUntil(lteConnected, 10000);
+    CHECK(lte.state == lteConnected);
+    CHECK(lte.cellConnected);
+    CHECK(fakeNetwork.beginCount == 1);
+    CHECK((lte.attachTimeMs >= 2000) && (lte.attachTimeMs < 2100));
+
+    // The first check runs straight away: AT+CGATT? then AT+CSQ
+    runFor(100);
+    CHECK(lte.signalStrength == 17);
+    MODEM.csq = 25;
+    runFor(10000);
+    CHECK(lte.signalStrength == 25);
+    CHECK(lte.softResetCount == 0);
+
+    // Modem stops answering: three timed out checks, then a soft reset
+    MODEM.answering = false;
+    unsigned long resetAfter = runUntil(lteSoftReset, 60000);
+    CHECK(lte.state == lteSoftReset);
+    CHECK(lte.softResetCount == 1);
+    CHECK(!lte.cellConnected);
+    CHECK(MODEM.lastCommand == "AT+CFUN=15");
+    CHECK((resetAfter > 2 * 10000) && (resetAfter <= 3 * 10000 + 5000 + 100));
+
+    // Modem comes back during the soft reset: probed with AT after LTE_RESET_WAIT_MS, then attached again
+    runFor(3000);
+    MODEM.answering = true;
+    runUntil(lteAttach, 10000);
+    CHECK(lte.modemIsReset);
+    CHECK(lte.hardResetCount == 0);
+    runUntil(lteConnected, 10000);
+    CHECK(lte.state == lteConnected);
+    CHECK(fakeNetwork.beginCount == 2);
+
+    // Modem hangs and stays hung through the soft reset: hard reset pulse on SARA_RESETN, without MODEM.hardReset()
+    MODEM.answering = false;
+    runUntil(lteSoftReset, 60000);
+    CHECK(lte.softResetCount == 2);
+    unsigned long hardAfter = runUntil(lteHardReset, 60000);
+    CHECK(lte.state == lteHardReset);
+    CHECK((hardAfter > 25000) && (hardAfter <= 25000 + 1000 + 100)); // Once the last AT probe has timed out
+    CHECK(lte.hardResetCount == 1);
+    CHECK(MODEM.hardResetCount == 0);
+    CHECK(digitalRead(SARA_RESETN) == HIGH);
+    runFor(500);
+    CHECK(digitalRead(SARA_RESETN) == HIGH);
+    runFor(600);
+    CHECK(digitalRead(SARA_RESETN) == LOW);
+
+    // Modem is up again after the hard reset
+    MODEM.answering = true;
+    runUntil(lteConnected, 20000);
+    CHECK(lte.state == lteConnected);
+    CHECK(fakeNetwork.beginCount == 3);
+
+    // Lost attach is re-attached without a reset
+    MODEM.attached = false;
+    runUntil(lteAttach, 20000);
+    CHECK(lte.state == lteAttach);
+    CHECK(!lte.cellConnected);
+    MODEM.attached = true;
+    runUntil(lteConnected, 10000);
+    CHECK(lte.state == lteConnected);
+    CHECK(lte.softResetCount == 2);
+
+    // Modem not answering the probe before an attach: soft reset, and NB::begin isn't left to its autosense
+    MODEM.attached = false;
+    runUntil(lteAttach, 20000);
+    MODEM.answering = false;
+    runUntil(lteSoftReset, 10000);
+    CHECK(lte.state == lteSoftReset);
+    CHECK(lte.softResetCount == 3);
+
+    CHECK(fakeNetwork.beginWhileUnanswered == 0);
+    CHECK(stalls == 0);
+    return hostTestExit();
+}
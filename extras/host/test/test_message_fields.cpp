@@ -0,0 +1,46 @@
+/*
+ MessageData field limits: a field longer than MAX_MESSAGE_FIELD_LEN is truncated, counted, and the message is still
+ delivered, with the messages either side of it unaffected.
+*/
+
+#include "Dashio.h"
+#include "host_test.h"
+
+int main() {
+    MessageData data(TCP_CONN);
+
+    String longText;
+    for (int i = 0; i < MAX_MESSAGE_FIELD_LEN + 50; i++) {
+        longText += (char)('a' + i % 26);
+    }
+    String expected = longText.substring(0, MAX_MESSAGE_FIELD_LEN);
+
+    data.processMessage(String("\tDEV1\tTEXT\tT1\t") + longText + "\n");
+    CHECK(data.messageReceived);
+    CHECK(data.control == textBox);
+    String deviceID = data.deviceID;
+    String idStr = data.idStr;
+    CHECK_STR(deviceID.c_str(), "DEV1");
+    CHECK_STR(idStr.c_str(), "T1");
+    CHECK(data.payloadStr.length() == MAX_MESSAGE_FIELD_LEN);
+    CHECK_STR(data.payloadStr.c_str(), expected.c_str());
+    CHECK(data.truncatedCount == 1);
+
+    // A field that just fits isn't truncated, and the field after a truncated one is read in full
+    data.messageReceived = false;
+    data.processMessage(String("\tDEV1\tSLCTR\tS1\t") + longText + "\t" + expected + "\n");
+    CHECK(data.messageReceived);
+    CHECK_STR(data.payloadStr.c_str(), expected.c_str());
+    CHECK_STR(data.payloadStr2.c_str(), expected.c_str());
+    CHECK(data.truncatedCount == 2);
+
+    data.messageReceived = false;
+    data.processMessage("\tDEV1\tBTTN\tB1\n");
+    CHECK(data.messageReceived);
+    CHECK(data.control == button);
+    idStr = data.idStr;
+    CHECK_STR(idStr.c_str(), "B1");
+    CHECK(data.truncatedCount == 2);
+
+    return hostTestExit();
+}
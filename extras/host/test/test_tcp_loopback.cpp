@@ -0,0 +1,128 @@
+/*
+ TCP loopback: a second thread writes 20,000 messages to a real socket in random sized writes, and the reading side
+ goes through DashClientReader, as DashioTCP does, with a Client over the socket. Every message must arrive whole and
+ in order, in far fewer reads than bytes. Prints the throughput against reading a byte at a time.
+*/
+
+#include "host_test.h"
+#include "Client.h"
+#include "Dashio.h"
+#include "loopback_socket.h"
+
+#include <chrono>
+#include <random>
+#include <thread>
+
+static const int NUM_MESSAGES = 20000;
+static const unsigned int TCP_READ_BUFFER_SIZE = 256; // As DashioESP.cpp
+
+// The parts of WiFiClient that DashioTCP reads with
+class SocketClient : public Client {
+public:
+    unsigned long readCalls = 0;
+
+    SocketClient(int _fd) : fd(_fd) {}
+    int connect(const char *, uint16_t) {return 0;}
+    size_t write(uint8_t c) {return write(&c, 1);}
+    size_t write(const uint8_t *buf, size_t size) {return socketWrite(fd, buf, size);}
+    int available() {return socketAvailable(fd);}
+    int read() {
+        uint8_t c;
+        return (read(&c, 1) == 1) ? c : -1;
+    }
+    int read(uint8_t *buf, size_t size) {
+        readCalls++;
+        return socketRead(fd, buf, size);
+    }
+    int peek() {return -1;}
+    void flush() {}
+    void stop() {socketClose(fd);}
+    uint8_t connected() {return 1;}
+    operator bool() {return true;}
+
+private:
+    int fd;
+};
+
+static String makeStream() {
+    String stream;
+    stream.reserve(NUM_MESSAGES * 40);
+    for (int i = 0; i < NUM_MESSAGES; i++) {
+        stream += String("\tABC123\tSLDR\ts") + i + "\t" + (i * 3) + "\n";
+    }
+    return stream;
+}
+
+// Returns the seconds taken to receive everything
+static double runLoopback(const String& stream, unsigned int blockSize, unsigned long& reads) {
+    int writeFd, readFd;
+    if (!loopbackSocketPair(writeFd, readFd)) {
+        CHECK(!"loopback socket pair");
+        return 1;
+    }
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::thread writer([&stream, writeFd]() {
+        std::mt19937 rng(7);
+        size_t pos = 0;
+        while (pos < stream.length()) {
+            size_t length = 1 + rng() % 1400;
+            if (length > stream.length() - pos) {
+                length = stream.length() - pos;
+            }
+            int sent = socketWrite(writeFd, stream.c_str() + pos, length);
+            if (sent <= 0) {
+                break;
+            }
+            pos += sent;
+        }
+        socketShutdownWrite(writeFd);
+    });
+
+    SocketClient client(readFd);
+    MessageData data(TCP_CONN);
+    DashClientReader reader(blockSize);
+    int received = 0;
+    bool inOrder = true;
+    while (received < NUM_MESSAGES) {
+        while (reader.nextMessage(client, data)) {
+            if ((data.idStr != String("s") + received) || (data.payloadStr != String(received * 3))) {
+                inOrder = false;
+            }
+            received++;
+        }
+        if (!socketWait(readFd, 1000)) {
+            break; // Stalled
+        }
+        if (client.available() == 0) {
+            break; // Readable with nothing to read, so the writer has finished
+        }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    writer.join();
+    socketClose(writeFd);
+    socketClose(readFd);
+
+    CHECK(received == NUM_MESSAGES);
+    CHECK(inOrder);
+    CHECK(reader.readCount == client.readCalls);
+    reads = reader.readCount;
+    return seconds;
+}
+
+int main() {
+    String stream = makeStream();
+
+    unsigned long blockReads = 0;
+    double blockSeconds = runLoopback(stream, TCP_READ_BUFFER_SIZE, blockReads);
+    CHECK(blockReads <= stream.length() / 32); // Blocks, not bytes
+
+    unsigned long byteReads = 0;
+    double byteSeconds = runLoopback(stream, 1, byteReads);
+    CHECK(byteReads == stream.length());
+
+    printf("%u bytes, %d messages\n", stream.length(), NUM_MESSAGES);
+    printf("%u byte blocks: %lu reads, %.1f MB/s\n", TCP_READ_BUFFER_SIZE, blockReads, stream.length() / blockSeconds / 1e6);
+    printf("byte at a time: %lu reads, %.1f MB/s\n", byteReads, stream.length() / byteSeconds / 1e6);
+    return hostTestExit();
+}
@@ -0,0 +1,71 @@
+/*
+ DashTimeStamp against gmtime/strftime for years 1000 to 9999: random times, ascending and descending runs (which
+ go through the cached date and time digits), and leap day, century and 1970 edges.
+ Usage: test_time_stamp [count] (default 1000000 random times)
+*/
+
+#include "host_test.h"
+#include "Dashio.h"
+
+#include <random>
+
+static const time_t YEAR_1000 = -30610224000LL; // 1000-01-01T00:00:00Z
+static const time_t YEAR_10000 = 253402300800LL; // 10000-01-01T00:00:00Z
+
+static void checkStamp(DashTimeStamp& timeStamp, time_t time) {
+    struct tm tmTime;
+    char expected[32];
+    gmtime_r(&time, &tmTime);
+    strftime(expected, sizeof(expected), "%Y-%m-%dT%H:%M:%SZ", &tmTime);
+    CHECK_STR(timeStamp.encode(time), expected);
+}
+
+static void checkRun(time_t start, long step, int count) {
+    DashTimeStamp timeStamp;
+    for (int i = 0; i < count; i++) {
+        checkStamp(timeStamp, start + (time_t)i * step);
+    }
+}
+
+int main(int argc, char **argv) {
+    unsigned long count = (argc > 1) ? strtoul(argv[1], nullptr, 10) : 1000000;
+    std::mt19937_64 rng(2024);
+    std::uniform_int_distribution<long long> anyTime(YEAR_1000, YEAR_10000 - 1);
+
+    // Random times, each with a fresh encoder and then all through one encoder
+    DashTimeStamp shared;
+    for (unsigned long i = 0; i < count; i++) {
+        time_t time = anyTime(rng);
+        DashTimeStamp fresh;
+        checkStamp(fresh, time);
+        checkStamp(shared, time);
+    }
+
+    // Consecutive samples, as a time graph backfill sends them, forwards and backwards
+    for (int i = 0; i < 200; i++) {
+        time_t start = anyTime(rng);
+        checkRun(start, 1, 200);
+        checkRun(start, 59, 200);
+        checkRun(start, 3601, 200);
+        checkRun(start, -7, 200);
+        checkRun(start, 86399, 50);
+    }
+
+    // Around midnight on leap days, century years and the epoch
+    const time_t edges[] = {
+        0, -1, 86400, 951782400LL /* 2000-02-29 */, 4107542400LL /* 2100-03-01 */, -2203891200LL /* 1900-03-01 */,
+        -11670912000LL /* 1600-02-29 */, 1709164800LL /* 2024-02-29 */, 2147483647LL, 4102444800LL /* 2100-01-01 */
+    };
+    for (time_t edge : edges) {
+        checkRun(edge - 2, 1, 4);
+        checkRun(edge - 86400, 3600, 50);
+    }
+
+    // Both ends of the range
+    checkRun(YEAR_1000, 1, 4);
+    checkRun(YEAR_1000, 3600, 50);
+    checkRun(YEAR_10000 - 1, -1, 4);
+    checkRun(YEAR_10000 - 1, -3600, 50);
+
+    return hostTestExit();
+}